@@ -0,0 +1,329 @@
+// Benchmarks HistoryManager on synthetic histories of several sizes and
+// prints the timings as JSON or CSV, so runs can be compared.
+//
+//   clipboard_bench [--sizes=1000,10000,100000,1000000] [--dist=short|mixed|large]
+//                   [--dup=0.2] [--seed=1] [--ops=200] [--format=json|csv]
+//                   [--out=file] [--dir=path] [--keep]
+//
+// Each size gets a fresh data directory, filled with one writeHistory call,
+// then every operation is timed on it. Times are per operation.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "history_manager/HistoryManager.h"
+#include "history_manager/Timestamp.h"
+
+namespace fs = std::filesystem;
+
+struct Config {
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+    std::string dist = "mixed";
+    double duplicates = 0.2;     // share of items that repeat an earlier item
+    uint64_t seed = 1;
+    size_t ops = 200;            // iterations of each per-item operation
+    std::string format = "json";
+    std::string out;             // "" = stdout
+    std::string dir;             // "" = a temp directory
+    bool keep = false;
+};
+
+// Synthetic clipboard history: words from a fixed vocabulary, so searches
+// for them have a predictable number of hits, and kNeedle in about one item
+// in a thousand.
+//   short: 5-80 bytes, like identifiers, URLs and one-liners
+//   mixed: mostly short, a fifth up to 4 KiB and one in a hundred up to 64 KiB
+//   large: 1-64 KiB, like copied files and logs
+class HistoryGenerator {
+public:
+    HistoryGenerator(const Config &config) : m_config(config), m_rng(config.seed) {}
+
+    std::string text() {
+        std::string out;
+        const size_t size = pickSize();
+        while (out.size() < size) {
+            if (!out.empty()) out += m_rng() % 12 == 0 ? '\n' : ' ';
+            out += word();
+        }
+        out.resize(size);
+        return out;
+    }
+
+    // count items, oldest first, with times one second apart.
+    std::vector<HistoryItem> items(size_t count) {
+        std::vector<HistoryItem> out;
+        out.reserve(count);
+        const int64_t start = timestamp::nowMicros() - static_cast<int64_t>(count) * 1000000;
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        for (size_t i = 0; i < count; ++i) {
+            HistoryItem it;
+            if (i > 0 && unit(m_rng) < m_config.duplicates) it.content = out[m_rng() % i].content;
+            else it.content = text();
+            if (m_rng() % 1000 == 0) it.content += std::string(" ") + kNeedle;
+            it.time = start + static_cast<int64_t>(i) * 1000000;
+            it.source = i % 3 == 0 ? "cli" : "clipboard";
+            it.pinned = m_rng() % 500 == 0;
+            HistoryManager::summarize(it);
+            out.push_back(std::move(it));
+        }
+        std::reverse(out.begin(), out.end());   // writeHistory takes newest first
+        return out;
+    }
+
+    static constexpr const char *kNeedle = "needle_xq7";
+    // One of kWords; the first ones are the most frequent.
+    static const char *const kWords[];
+    static const size_t kWordCount;
+
+private:
+    const Config &m_config;
+    std::mt19937_64 m_rng;
+
+    std::string word() {
+        // Roughly Zipfian: squaring a uniform pick favours low indexes.
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        const double u = unit(m_rng);
+        std::string w = kWords[static_cast<size_t>(u * u * kWordCount) % kWordCount];
+        if (m_rng() % 4 == 0) w += std::to_string(m_rng() % 1000);
+        return w;
+    }
+
+    size_t pickSize() {
+        auto between = [&](size_t lo, size_t hi) { return lo + m_rng() % (hi - lo + 1); };
+        if (m_config.dist == "short") return between(5, 80);
+        if (m_config.dist == "large") return between(1024, 64 * 1024);
+        const uint64_t r = m_rng() % 100;
+        if (r == 0) return between(4096, 64 * 1024);
+        if (r < 20) return between(81, 4096);
+        return between(5, 80);
+    }
+};
+
+const char *const HistoryGenerator::kWords[] = {
+    "the", "error", "value", "return", "const", "string", "http", "function", "import", "class",
+    "warning", "config", "user", "data", "request", "response", "index", "buffer", "token", "server",
+    "client", "update", "delete", "select", "insert", "table", "column", "branch", "commit", "merge",
+    "docker", "kernel", "module", "package", "version", "release", "timeout", "socket", "thread", "mutex",
+    "Straße", "naïve", "café", "résumé", "Ωmega", "ДАННЫЕ", "東京", "emoji🙂", "zebra", "yak",
+};
+const size_t HistoryGenerator::kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+struct Result {
+    std::string name;
+    size_t items = 0;            // history size the operation ran against
+    size_t iterations = 0;
+    double totalMs = 0;
+    double meanUs = 0;
+    double p50Us = 0;
+    double p95Us = 0;
+    double maxUs = 0;
+    size_t hits = 0;             // results returned, for searches and reads
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Runs op `iterations` times and records each call's time.
+static Result measure(const std::string &name, size_t items, size_t iterations,
+                      const std::function<size_t(size_t)> &op) {
+    std::vector<double> us;
+    us.reserve(iterations);
+    Result r;
+    r.name = name;
+    r.items = items;
+    r.iterations = iterations;
+    for (size_t i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        r.hits = op(i);
+        us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    if (us.empty()) return r;
+    for (double u : us) r.totalMs += u / 1000.0;
+    r.meanUs = r.totalMs * 1000.0 / us.size();
+    std::sort(us.begin(), us.end());
+    r.p50Us = us[us.size() / 2];
+    r.p95Us = us[std::min(us.size() - 1, us.size() * 95 / 100)];
+    r.maxUs = us.back();
+    return r;
+}
+
+static std::vector<Result> runSize(const Config &config, const fs::path &dir, size_t count) {
+    std::vector<Result> results;
+    auto report = [&](Result r) {
+        std::cerr << "  " << r.name << ": " << r.meanUs << " us/op\n";
+        results.push_back(std::move(r));
+    };
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir);
+
+    HistoryGenerator gen(config);
+    auto items = gen.items(count);
+    {
+        HistoryManager history(dir.string());
+        report(measure("populate", count, 1, [&](size_t) { return history.writeHistory(items) ? count : 0; }));
+    }
+    items.clear();
+    items.shrink_to_fit();
+
+    // A new manager pays for parsing history.txt on its first read.
+    std::unique_ptr<HistoryManager> cold;
+    report(measure("load", count, 1, [&](size_t) {
+        cold.reset(new HistoryManager(dir.string()));
+        return cold->readHistory().size();
+    }));
+    cold.reset();
+
+    HistoryManager history(dir.string());
+    history.readHistory();
+    const size_t ops = config.ops;
+    const size_t reads = std::max<size_t>(1, std::min<size_t>(ops, 2000000 / (count + 1)));
+
+    report(measure("readHistory", count, reads, [&](size_t) { return history.readHistory().size(); }));
+    report(measure("visitHistory", count, reads, [&](size_t) {
+        size_t n = 0;
+        history.visitHistory([&](const ItemView &) { return ++n, true; });
+        return n;
+    }));
+
+    // The first search of a manager scans, the second builds the text index
+    // and the others use it.
+    report(measure("search.first", count, 1, [&](size_t) { return history.search(HistoryGenerator::kNeedle).size(); }));
+    report(measure("search.build", count, 1, [&](size_t) { return history.search(HistoryGenerator::kNeedle).size(); }));
+    report(measure("search.rare", count, ops, [&](size_t) { return history.search(HistoryGenerator::kNeedle).size(); }));
+    report(measure("search.common", count, reads, [&](size_t) { return history.search("error").size(); }));
+    report(measure("search.folded", count, ops, [&](size_t) { return history.search("CAFÉ").size(); }));
+    report(measure("search.miss", count, ops, [&](size_t) { return history.search("qqqzzzxxx").size(); }));
+    report(measure("fuzzySearch", count, std::max<size_t>(1, reads / 10),
+                   [&](size_t) { return history.fuzzySearch("ndlxq", 20).size(); }));
+
+    report(measure("addItem", count, ops, [&](size_t) { return history.addItem(gen.text(), "bench") ? 1 : 0; }));
+    const size_t n = count + ops;
+    const size_t rewrites = std::max<size_t>(1, std::min<size_t>(ops, 2000000 / (n + 1)));
+    report(measure("pin", n, rewrites, [&](size_t i) { return history.pinItem((i * 7919) % n) ? 1 : 0; }));
+    report(measure("unpin", n, rewrites, [&](size_t i) { return history.unpinItem((i * 7919) % n) ? 1 : 0; }));
+    report(measure("delete", n, rewrites, [&](size_t i) { return history.deleteItem((i * 7919) % (n - i)) ? 1 : 0; }));
+    // Undoes the deletes; the journal holds at most Journal::kMaxOps.
+    report(measure("undo", n, std::min(rewrites, Journal::kMaxOps), [&](size_t) { return history.undo() ? 1 : 0; }));
+
+    const std::string slotText = gen.text();
+    report(measure("setSlot", n, ops, [&](size_t i) { return history.setSlot(static_cast<int>(i % 10), slotText) ? 1 : 0; }));
+    report(measure("getSlot", n, ops, [&](size_t i) { return history.getSlot(static_cast<int>(i % 10)) ? 1 : 0; }));
+    return results;
+}
+
+static std::string jsonString(const std::string &text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+static void writeJson(std::ostream &out, const Config &config, const std::vector<Result> &results) {
+    out << "{\n  \"config\": {\"dist\": " << jsonString(config.dist) << ", \"duplicates\": " << config.duplicates
+        << ", \"seed\": " << config.seed << ", \"ops\": " << config.ops << "},\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        out << "    {\"name\": " << jsonString(r.name) << ", \"items\": " << r.items
+            << ", \"iterations\": " << r.iterations << ", \"total_ms\": " << r.totalMs
+            << ", \"mean_us\": " << r.meanUs << ", \"p50_us\": " << r.p50Us << ", \"p95_us\": " << r.p95Us
+            << ", \"max_us\": " << r.maxUs << ", \"hits\": " << r.hits << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+static void writeCsv(std::ostream &out, const std::vector<Result> &results) {
+    out << "name,items,iterations,total_ms,mean_us,p50_us,p95_us,max_us,hits\n";
+    for (const Result &r : results) {
+        out << r.name << "," << r.items << "," << r.iterations << "," << r.totalMs << "," << r.meanUs << ","
+            << r.p50Us << "," << r.p95Us << "," << r.maxUs << "," << r.hits << "\n";
+    }
+}
+
+static bool parseArgs(int argc, char *argv[], Config &config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&](const char *prefix) { return arg.substr(std::string(prefix).size()); };
+        if (arg.rfind("--sizes=", 0) == 0) {
+            config.sizes.clear();
+            std::istringstream list(value("--sizes="));
+            std::string size;
+            while (std::getline(list, size, ',')) {
+                if (!size.empty()) config.sizes.push_back(std::stoull(size));
+            }
+        } else if (arg.rfind("--dist=", 0) == 0) {
+            config.dist = value("--dist=");
+            if (config.dist != "short" && config.dist != "mixed" && config.dist != "large") return false;
+        } else if (arg.rfind("--dup=", 0) == 0) {
+            config.duplicates = std::stod(value("--dup="));
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            config.seed = std::stoull(value("--seed="));
+        } else if (arg.rfind("--ops=", 0) == 0) {
+            config.ops = std::max<size_t>(1, std::stoull(value("--ops=")));
+        } else if (arg.rfind("--format=", 0) == 0) {
+            config.format = value("--format=");
+            if (config.format != "json" && config.format != "csv") return false;
+        } else if (arg.rfind("--out=", 0) == 0) {
+            config.out = value("--out=");
+        } else if (arg.rfind("--dir=", 0) == 0) {
+            config.dir = value("--dir=");
+        } else if (arg == "--keep") {
+            config.keep = true;
+        } else {
+            return false;
+        }
+    }
+    return !config.sizes.empty();
+}
+
+int main(int argc, char *argv[]) {
+    Config config;
+    try {
+        if (!parseArgs(argc, argv, config)) {
+            std::cerr << "usage: clipboard_bench [--sizes=1000,10000,...] [--dist=short|mixed|large] [--dup=0.2]\n"
+                         "                       [--seed=1] [--ops=200] [--format=json|csv] [--out=file]\n"
+                         "                       [--dir=path] [--keep]\n";
+            return 2;
+        }
+    } catch (const std::exception &) {
+        std::cerr << "Invalid number in arguments\n";
+        return 2;
+    }
+
+    fs::path root = config.dir.empty() ? fs::temp_directory_path() / ("clipboard_bench_" + std::to_string(timestamp::nowMicros()))
+                                       : fs::path(config.dir);
+    std::vector<Result> results;
+    for (size_t count : config.sizes) {
+        std::cerr << count << " items\n";
+        auto sized = runSize(config, root / std::to_string(count), count);
+        results.insert(results.end(), sized.begin(), sized.end());
+    }
+    if (!config.keep) {
+        std::error_code ec;
+        fs::remove_all(root, ec);
+    }
+
+    std::ofstream file;
+    if (!config.out.empty()) {
+        file.open(config.out, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Cannot open " << config.out << "\n";
+            return 1;
+        }
+    }
+    std::ostream &out = config.out.empty() ? std::cout : file;
+    if (config.format == "csv") writeCsv(out, results);
+    else writeJson(out, config, results);
+    return out ? 0 : 1;
+}
@@ -5,7 +5,19 @@
     "cflags_cc!": [ "-fno-exceptions" ],
     "sources": [ 
       "../src/node_addon/clipboard_addon.cpp",
-      "../src/history_manager/HistoryManager.cpp"
+      "../src/history_manager/HistoryManager.cpp",
+      "../src/history_manager/FileLock.cpp",
+      "../src/history_manager/Timestamp.cpp",
+      "../src/history_manager/ItemBlock.cpp",
+      "../src/history_manager/BlobStore.cpp",
+      "../src/history_manager/Journal.cpp",
+      "../src/search/FuzzyMatcher.cpp",
+      "../src/search/SearchSession.cpp",
+      "../src/search/Regex.cpp",
+      "../src/search/TextFold.cpp",
+      "../src/search/BloomFilter.cpp",
+      "../src/search/SearchIndex.cpp",
+      "../src/stats/Stats.cpp"
     ],
     "include_dirs": [
       "<!@(node -p \"require('node-addon-api').include\")",
@@ -15,14 +27,18 @@
     "defines": [ "NAPI_DISABLE_CPP_EXCEPTIONS" ],
     'conditions': [
       ['OS=="win"', {
+        "sources": [ "../src/clipboard_monitor/ClipboardMonitorWin32.cpp" ],
         "defines": [
           "_HAS_EXCEPTIONS=1"
         ],
+        "libraries": [ "user32.lib" ],
         "msvs_settings": {
           "VCCLCompilerTool": {
             "ExceptionHandling": 1
           }
         }
+      }, {
+        "sources": [ "../src/clipboard_monitor/ClipboardMonitorNone.cpp" ]
       }]
     ]
   }]
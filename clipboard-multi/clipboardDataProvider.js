@@ -6,9 +6,11 @@ class ClipboardDataProvider {
     this._onDidChangeTreeData = new vscode.EventEmitter();
     this.onDidChangeTreeData = this._onDidChangeTreeData.event;
     this.allItems = backend.getAll();
+    this._searchTicket = 0;
   }
 
   refresh() {
+    this._searchTicket++;   // drop results of searches still in flight
     this.allItems = this.backend.getAll();
     this._onDidChangeTreeData.fire();
   }
@@ -23,10 +25,31 @@ class ClipboardDataProvider {
     }
   }
 
+  // Live variant for a search box: only the newest query's results are
+  // shown, however the asynchronous searches happen to finish.
+  searchIncremental(query) {
+    const ticket = ++this._searchTicket;
+    return this.backend.searchIncremental(query).then(results => {
+      if (results === null || ticket !== this._searchTicket) return;
+      this.allItems.history = Array.isArray(results) ? results : [];
+      this._onDidChangeTreeData.fire();
+    });
+  }
+
   getTreeItem(element) {
     return element;
   }
 
+  // Called by VS Code when an item is hovered: only then is the full content
+  // loaded for the tooltip.
+  resolveTreeItem(item, element) {
+    if (element.entry && element.tooltip === undefined) {
+      const text = this._getEntryText(element.entry);
+      element.tooltip = `${element.tooltipTitle}\n\n${text ?? element.entry.preview}`;
+    }
+    return element;
+  }
+
   getChildren() {
     const { slots = {}, pinned = [], history = [] } = this.allItems || {};
     const items = [];
@@ -55,24 +78,9 @@ class ClipboardDataProvider {
     // --- 📌 PINNED ITEMS ---
     items.push(this._createSectionHeader('📌  Pinned'));
     if (pinned.length) {
-      pinned.forEach((text, index) => {
-        const cleanText = text.replace(/^\d+\.\s*/, '').trim();
-        const lines = cleanText.split(/\r?\n/);
-        const firstLine = lines[0].trim();
-        const displayText = lines.length > 1 
-          ? `${firstLine}... (+${lines.length - 1} more lines)`
-          : firstLine;
-
-        const item = new vscode.TreeItem(displayText, vscode.TreeItemCollapsibleState.None);
-        item.iconPath = new vscode.ThemeIcon('pin');
-        item.tooltip = `📍 Pinned item\n\n${cleanText}`;
-        item.contextValue = 'pinnedItem';
+      pinned.forEach((entry, index) => {
+        const item = this._createEntryItem(entry, 'pin', 'pinnedItem', '📍 Pinned item');
         item.description = `#${index + 1}`;  // Show index as description
-        item.command = {
-          command: 'clipboard.copyAndSave',
-          title: 'Copy Pinned Item',
-          arguments: [cleanText],
-        };
         items.push(item);
       });
     } else {
@@ -81,34 +89,13 @@ class ClipboardDataProvider {
 
     // --- 🕘 HISTORY ITEMS ---
     items.push(this._createSectionHeader('⌛  History'));
-    // Filter out pinned items and handle multiline text
-    const seen = new Set();
-    const filteredHistory = history.filter(text => {
-      const cleanText = text.replace(/^\d+\.\s*/, '').trim();
-      if (seen.has(cleanText)) return false;
-      seen.add(cleanText);
-      return true;
-    });
-
-    if (filteredHistory.length) {
-      filteredHistory.forEach((text, index) => {
-        const cleanText = text.replace(/^\d+\.\s*/, '').trim();
-        const lines = cleanText.split(/\r?\n/);
-        const firstLine = lines[0].trim();
-        const displayText = lines.length > 1 
-          ? `${firstLine}... (+${lines.length - 1} more lines)`
-          : firstLine;
-
-        const item = new vscode.TreeItem(displayText, vscode.TreeItemCollapsibleState.None);
-        item.iconPath = new vscode.ThemeIcon('clock');
-        item.tooltip = `📄 Clipboard item\n\n${cleanText}`;
-        item.contextValue = 'historyItem';
+    // Every stored item gets a row. Items that only share a first line, line
+    // count and size may still differ, and telling exact copies apart would
+    // mean loading every full payload.
+    if (history.length) {
+      history.forEach((entry, index) => {
+        const item = this._createEntryItem(entry, 'clock', 'historyItem', '📄 Clipboard item');
         item.description = `#${index + 1}`;  // Show index as description
-        item.command = {
-          command: 'clipboard.copyAndSave',
-          title: 'Copy History Item',
-          arguments: [cleanText],
-        };
         items.push(item);
       });
     } else {
@@ -142,6 +129,35 @@ class ClipboardDataProvider {
     return text.replace(/^\d+\.\s*/, '').trim();
   }
 
+  // Tree item for a history entry, rendered from its stored preview and line
+  // count. `entry` carries either its history `index` (list views and
+  // fuzzy search results) or its `content`.
+  _createEntryItem(entry, icon, contextValue, tooltipTitle) {
+    const firstLine = entry.preview || '[Empty]';
+    const displayText = entry.lineCount > 1
+      ? `${firstLine}... (+${entry.lineCount - 1} more lines)`
+      : firstLine;
+
+    const item = new vscode.TreeItem(displayText, vscode.TreeItemCollapsibleState.None);
+    item.iconPath = new vscode.ThemeIcon(icon);
+    item.contextValue = contextValue;
+    item.entry = entry;
+    item.tooltipTitle = tooltipTitle;
+    item.command = {
+      command: 'clipboard.copyAndSave',
+      title: 'Copy Item',
+      arguments: [entry],
+    };
+    return item;
+  }
+
+  _getEntryText(entry) {
+    if (typeof entry.content === 'string') return this._getFullText(entry.content);
+    if (Buffer.isBuffer(entry.content)) return this._getFullText(entry.content.toString('utf8'));
+    const text = this.backend.getContent(entry.index);
+    return text === null ? null : this._getFullText(text);
+  }
+
   _createSectionHeader(label) {
     const item = new vscode.TreeItem(label, vscode.TreeItemCollapsibleState.None);
     item.iconPath = new vscode.ThemeIcon('symbol-namespace');
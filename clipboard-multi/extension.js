@@ -26,6 +26,9 @@ function activate(context) {
   dataProvider = new ClipboardDataProvider(historyBackend);
   vscode.window.registerTreeDataProvider('clipboardView', dataProvider);
 
+  // ✅ Refresh the view whenever the native monitor records a new clip
+  historyBackend.startMonitor(() => dataProvider.refresh());
+
   // --------------------------------------------------------------------------
   // 🧩 Commands
   // --------------------------------------------------------------------------
@@ -60,7 +63,10 @@ function activate(context) {
 
   // 💾 Copy and Save
   register(context, 'clipboard.copyAndSave', async (textArg) => {
-    let text = textArg;
+    // Tree items pass their entry; the full content is loaded only now
+    let text = typeof textArg === 'object' && textArg !== null
+      ? dataProvider._getEntryText(textArg)
+      : textArg;
     if (!text) {
       const editor = vscode.window.activeTextEditor;
       if (!editor) return;
@@ -76,44 +82,62 @@ function activate(context) {
 
   // 📌 Pin item
   register(context, 'clipboard.pin', (item) => {
-    const cleanText = getCleanLabel(item);
-    if (!cleanText) return;
+    const ref = getItemRef(item);
+    if (ref === '') return;
 
-    historyBackend.pinItem(cleanText);
-    vscode.window.showInformationMessage(`📌 Pinned item: "${cleanText}"`);
+    historyBackend.pinItem(ref);
+    vscode.window.showInformationMessage(`📌 Pinned item: "${getItemLabel(item)}"`);
     dataProvider.refresh();
   });
 
   // 📤 Unpin item
   register(context, 'clipboard.unpin', (item) => {
-    const cleanText = getCleanLabel(item);
-    if (!cleanText) return;
+    const ref = getItemRef(item);
+    if (ref === '') return;
 
-    historyBackend.unpinItem(cleanText);
-    vscode.window.showInformationMessage(`📤 Unpinned item: "${cleanText}"`);
+    historyBackend.unpinItem(ref);
+    vscode.window.showInformationMessage(`📤 Unpinned item: "${getItemLabel(item)}"`);
     dataProvider.refresh();
   });
 
   // ❌ Delete item
+  // The item is looked up again after the prompt: clips copied meanwhile
+  // move it to another index.
   register(context, 'clipboard.delete', async (item) => {
-    const cleanText = getCleanLabel(item);
-    if (!cleanText) return;
+    const ref = getItemRef(item);
+    if (ref === '') return;
+    const label = getItemLabel(item);
 
     const confirm = await vscode.window.showQuickPick(['Yes', 'No'], {
-      placeHolder: `🗑️ Delete "${cleanText}" from clipboard history?`,
+      placeHolder: `🗑️ Delete "${label}" from clipboard history?`,
     });
 
     if (confirm === 'Yes') {
-      historyBackend.deleteItem(cleanText);
-      vscode.window.showInformationMessage(`🗑️ Deleted: "${cleanText}"`);
+      if (historyBackend.deleteItem(ref)) {
+        vscode.window.showInformationMessage(`🗑️ Deleted: "${label}"`);
+      } else {
+        vscode.window.showWarningMessage(`⚠️ "${label}" is no longer in the history.`);
+      }
       dataProvider.refresh();
     }
   });
 
   // 🔍 Search
-  register(context, 'clipboard.search', async () => {
-    const query = await vscode.window.showInputBox({ prompt: '🔍 Search clipboard history...' });
-    if (query !== undefined) dataProvider.search(query);
+  // The view is filtered as you type; Escape restores the full history.
+  register(context, 'clipboard.search', () => {
+    const input = vscode.window.createInputBox();
+    input.prompt = '🔍 Search clipboard history...';
+    let accepted = false;
+    input.onDidChangeValue(value => dataProvider.searchIncremental(value));
+    input.onDidAccept(() => {
+      accepted = true;
+      input.hide();
+    });
+    input.onDidHide(() => {
+      if (!accepted) dataProvider.refresh();
+      input.dispose();
+    });
+    input.show();
   });
 
   console.log('✅ Clipboard Manager activated successfully.');
@@ -123,27 +147,26 @@ function activate(context) {
 // 🧠 Utility Functions
 // --------------------------------------------------------------------------
 
-function getCleanLabel(item) {
-  // If no item or label, return empty
-  if (!item?.label) return '';
-  
-  // Get the full text from tooltip which contains the complete content
-  const tooltipText = item.tooltip || '';
-  const match = tooltipText.match(/(?:📍 Pinned item|📋 History item)\n\n([\s\S]+)/);
-  
-  // If we found the full text in tooltip, use that
-  if (match) {
-    return match[1];
-  }
-  
-  // Fallback to label if tooltip parsing fails
-  return item.label.replace(/^\d+\.\s*/, '');
+// Reference to a tree item's history entry: its index with the stored time
+// and size, which the backend checks when the command runs, or its full text
+// for entries that carry their content but no index.
+function getItemRef(item) {
+  const entry = item?.entry;
+  if (!entry) return '';
+  if (typeof entry.index === 'number') return { index: entry.index, time: entry.time, size: entry.size };
+  return dataProvider._getEntryText(entry) || '';
+}
+
+function getItemLabel(item) {
+  return item?.entry?.preview || (typeof item?.label === 'string' ? item.label : '');
 }
 
 function register(context, command, callback) {
   context.subscriptions.push(vscode.commands.registerCommand(command, callback));
 }
 
-function deactivate() {}
+function deactivate() {
+  historyBackend.stopMonitor();
+}
 
 module.exports = { activate, deactivate };
\ No newline at end of file
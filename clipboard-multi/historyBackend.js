@@ -4,6 +4,9 @@ const clipboardAddon = require('bindings')('clipboard_addon');
 
 let HISTORY_FILE = '';
 
+// Matches HistoryManager::kPreviewMaxBytes on the native side.
+const PREVIEW_MAX_BYTES = 120;
+
 function init(filePath) {
   HISTORY_FILE = path.dirname(filePath);
   try {
@@ -40,10 +43,11 @@ function addToHistory(text) {
     // Clean any existing number prefixes or display artifacts
     const cleanText = cleanDisplayText(text);
     
-    // Check if this content already exists by first line
-    const history = clipboardAddon.getHistory();
-    const firstLineNew = getFirstLine(cleanText);
-    const exists = history.some(item => getFirstLine(item.content) === firstLineNew);
+    // Check if this content already exists by first line, using the previews
+    // stored with each item instead of splitting every full payload
+    const history = clipboardAddon.getHistory({ previewOnly: true });
+    const previewNew = makePreview(cleanText);
+    const exists = history.some(item => item.preview === previewNew);
     
     if (!exists) {
       clipboardAddon.addToHistory(cleanText);
@@ -68,6 +72,32 @@ function getFirstLine(text) {
   return text.split(/\r?\n/)[0].trim();
 }
 
+// Same preview HistoryManager computes at insert time: first line, cut to
+// PREVIEW_MAX_BYTES of UTF-8 without splitting a character.
+function makePreview(text) {
+  const line = getFirstLine(text.trim());
+  const bytes = Buffer.from(line, 'utf8');
+  if (bytes.length <= PREVIEW_MAX_BYTES) return line;
+  let end = PREVIEW_MAX_BYTES;
+  while (end > 0 && (bytes[end] & 0xC0) === 0x80) end--;
+  return bytes.subarray(0, end).toString('utf8');
+}
+
+// Items may be addressed by a reference from a listing ({ index, time, size })
+// or, for search results and older callers, by their full text. Clips copied
+// since the listing shift the indexes, so a reference is resolved only when it
+// is acted on: its index if that still holds the same item, else wherever the
+// item moved to, or -1 once it is gone.
+function resolveIndex(ref) {
+  if (ref && typeof ref === 'object') {
+    const history = clipboardAddon.getHistory({ previewOnly: true });
+    const same = item => item.time === ref.time && item.size === ref.size;
+    if (history[ref.index] && same(history[ref.index])) return ref.index;
+    return history.findIndex(same);
+  }
+  return findItemIndex(clipboardAddon.getHistory(), ref);
+}
+
 function findItemIndex(history, text) {
   // Clean the target text of any display artifacts and normalize
   const cleanText = cleanDisplayText(text);
@@ -79,10 +109,9 @@ function findItemIndex(history, text) {
   });
 }
 
-function pinItem(text) {
+function pinItem(ref) {
   try {
-    const history = clipboardAddon.getHistory();
-    const index = findItemIndex(history, text);
+    const index = resolveIndex(ref);
     if (index !== -1) {
       clipboardAddon.pinItem(index);
       return true;
@@ -94,10 +123,9 @@ function pinItem(text) {
   }
 }
 
-function unpinItem(text) {
+function unpinItem(ref) {
   try {
-    const history = clipboardAddon.getHistory();
-    const index = findItemIndex(history, text);
+    const index = resolveIndex(ref);
     if (index !== -1) {
       clipboardAddon.unpinItem(index);
       return true;
@@ -109,10 +137,9 @@ function unpinItem(text) {
   }
 }
 
-function deleteItem(text) {
+function deleteItem(ref) {
   try {
-    const history = clipboardAddon.getHistory();
-    const index = findItemIndex(history, text);
+    const index = resolveIndex(ref);
     if (index !== -1) {
       clipboardAddon.deleteItem(index);
       console.log(`[Clipboard Manager] Deleted item at index ${index}`);
@@ -125,21 +152,109 @@ function deleteItem(text) {
   }
 }
 
+// Best SEARCH_LIMIT fuzzy matches, best first. Like getAll() the results
+// carry previews and their history `index`; content comes from getContent().
+const SEARCH_LIMIT = 50;
+
+// `/pattern/` in a search box selects regex mode.
+function regexOf(query) {
+  const m = /^\/(.+)\/$/.exec(query || '');
+  return m ? m[1] : null;
+}
+
 function search(query) {
   try {
+    const pattern = regexOf(query);
+    if (pattern !== null) {
+      return clipboardAddon.regexSearch(pattern, { limit: SEARCH_LIMIT, previewOnly: true });
+    }
     if (!query) {
-      return clipboardAddon.getHistory();
+      return clipboardAddon.getHistory({ previewOnly: true })
+        .map((item, index) => ({ ...item, index }));
     }
-    return clipboardAddon.searchHistory(query);
+    return clipboardAddon.fuzzySearch(query, { limit: SEARCH_LIMIT, previewOnly: true });
   } catch (err) {
     console.error('[Clipboard Manager] Failed to search history:', err);
     return [];
   }
 }
 
+// search() for every keystroke of a search box. Resolves to the results, or
+// to null when a later call superseded this one; the native session reuses
+// the matches of the earlier, shorter query, so typing on gets cheaper.
+function searchIncremental(query) {
+  if (!query) return Promise.resolve(search(query));
+  const pattern = regexOf(query);
+  if (pattern !== null) {
+    try {
+      return Promise.resolve(clipboardAddon.regexSearch(pattern, { limit: SEARCH_LIMIT, previewOnly: true }));
+    } catch (err) {
+      return Promise.resolve(null);   // still typing the pattern: keep the last results
+    }
+  }
+  try {
+    return clipboardAddon.searchIncremental(query, { limit: SEARCH_LIMIT, previewOnly: true })
+      .catch(err => {
+        console.error('[Clipboard Manager] Failed to search history:', err);
+        return [];
+      });
+  } catch (err) {
+    console.error('[Clipboard Manager] Failed to search history:', err);
+    return Promise.resolve([]);
+  }
+}
+
+// Items matching structured filters, newest first, e.g. { pinned: true } or
+// { since: Date.now() - 3600e3 }. See the addon's query() for all fields.
+function query(filter = {}) {
+  try {
+    return clipboardAddon.query({ previewOnly: true, ...filter });
+  } catch (err) {
+    console.error('[Clipboard Manager] Query failed:', err);
+    return [];
+  }
+}
+
+// Native clipboard monitor: onChange(count) is called on the JS thread after
+// newly copied clips have been saved. Bursts arrive as a single call.
+function startMonitor(onChange) {
+  try {
+    return clipboardAddon.startMonitor(onChange);
+  } catch (err) {
+    console.error('[Clipboard Manager] Failed to start clipboard monitor:', err);
+    return false;
+  }
+}
+
+function stopMonitor() {
+  try {
+    clipboardAddon.stopMonitor();
+  } catch (err) {
+    console.error('[Clipboard Manager] Failed to stop clipboard monitor:', err);
+  }
+}
+
+// Full content of the history item at `index`, so list views can fetch
+// previews only and pay for the big payload just when it is actually used.
+// With `external` the addon may hand a large payload over as a Buffer that
+// wraps the history's own memory: it is read-only. Only decode it here, and
+// never pass it to anything that writes to its input.
+function getContent(index) {
+  try {
+    const buffer = clipboardAddon.getItemContent(index, { external: true });
+    return buffer ? buffer.toString('utf8') : null;
+  } catch (err) {
+    console.error('[Clipboard Manager] Failed to get item content:', err);
+    return null;
+  }
+}
+
 function getAll() {
   try {
-    const history = clipboardAddon.getHistory();
+    // List views only need the stored previews; full content is fetched
+    // per item with getContent(index) when it is actually used.
+    const history = clipboardAddon.getHistory({ previewOnly: true })
+      .map((item, index) => ({ ...item, index }));
     const slots = {};
     for (let i = 0; i < 10; i++) {
       const slot = clipboardAddon.getFromSlot(i);
@@ -147,8 +262,8 @@ function getAll() {
     }
     return {
       slots,
-      history: history.map(item => item.content),
-      pinned: history.filter(item => item.pinned).map(item => item.content)
+      history,
+      pinned: history.filter(item => item.pinned)
     };
   } catch (err) {
     console.error('[Clipboard Manager] Failed to get all items:', err);
@@ -165,5 +280,10 @@ module.exports = {
   unpinItem,
   deleteItem,
   search,
-  getAll
+  searchIncremental,
+  query,
+  getAll,
+  getContent,
+  startMonitor,
+  stopMonitor
 };
\ No newline at end of file
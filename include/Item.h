@@ -1,14 +1,52 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
-enum class ItemType { Text = 0 };
+// What an item's payload is. The exact format is the item's MIME type;
+// the type only decides how the payload is treated: textual payloads are
+// searched and previewed, the others are opaque bytes.
+enum class ItemType : uint8_t { Text = 0, Html, RichText, FileList, Image, Binary };
 
-struct ClipboardItem {
-    int id;
-    ItemType type;
-    bool pinned;
-    std::string content;
+// MIME type of items that carry none, i.e. everything stored before items
+// had a format.
+inline constexpr std::string_view kTextMime = "text/plain";
 
-    ClipboardItem(int _id = 0, ItemType _type = ItemType::Text, bool _pinned = false, const std::string& _content = "")
-        : id(_id), type(_type), pinned(_pinned), content(_content) {}
+inline ItemType itemTypeOf(std::string_view mime) {
+    mime = mime.substr(0, mime.find(';'));   // drop parameters such as charset
+    if (mime.empty() || mime == kTextMime) return ItemType::Text;
+    if (mime == "text/html") return ItemType::Html;
+    if (mime == "text/rtf" || mime == "application/rtf") return ItemType::RichText;
+    if (mime == "text/uri-list") return ItemType::FileList;
+    if (mime.compare(0, 5, "text/") == 0) return ItemType::Text;
+    if (mime.compare(0, 6, "image/") == 0) return ItemType::Image;
+    return ItemType::Binary;
+}
+
+// Whether payloads of this type are text that search and previews can use.
+inline bool isTextual(ItemType type) {
+    return type == ItemType::Text || type == ItemType::Html || type == ItemType::RichText ||
+           type == ItemType::FileList;
+}
+
+// A clipboard item: its payload, inline or in the blob store, and what is
+// known about it. The MIME type is the one format tag; the ItemType follows
+// from it.
+struct HistoryItem {
+    int64_t time = 0;       // microseconds since the epoch (see Timestamp.h)
+    std::string content;    // the payload, bytes as they were copied; empty if it is in a blob
+    bool pinned = false;
+    std::string source;     // where it came from: "clipboard", "cli", "import", ...; empty if unknown
+    std::string mime;       // payload format, e.g. "image/png"; empty for plain text
+    std::string blob;       // BlobStore name when the payload is stored there
+
+    // Kept with the item, so list views never have to scan the full content:
+    // the line count is stored in history.txt, the preview is taken from the
+    // first bytes of the content. Only textual items have them.
+    std::string preview;    // first non-blank line, at most HistoryManager::kPreviewMaxBytes
+    size_t lineCount = 0;
+    size_t size = 0;        // payload length in bytes
+
+    ItemType type() const { return itemTypeOf(mime); }
 };
@@ -1,35 +1,30 @@
 #include "AdvancedFeatures.h"
 #include <cstdio>
 
-void AdvancedFeatures::addForUndo(const ClipboardItem& item) {
-    undoStack.push(item);
-}
-
-ClipboardItem AdvancedFeatures::undo() {
-    if (undoStack.empty()) {
-        printf("Undo stack is empty!\n");
-        return ClipboardItem();
-    }
-    ClipboardItem last = undoStack.top();
-    undoStack.pop();
-    printf("Undo: Removed item -> %s\n", last.content.c_str());
-    return last;
-}
-
-void AdvancedFeatures::buildSearchIndex(const std::vector<ClipboardItem>& items) {
-    searchMap.clear();
-    for (const auto& item : items) {
-        searchMap[item.content] = item;
+void AdvancedFeatures::buildSearchIndex(const std::vector<HistoryItem>& items) {
+    this->items = items;
+    searchIndex = SearchIndex();
+    for (const auto& item : this->items) {
+        searchIndex.add(item.content);
     }
+    searchIndex.seal();
 }
 
 void AdvancedFeatures::search(const std::string& keyword) const {
     bool found = false;
-    for (const auto& [content, item] : searchMap) {
-        if (content.find(keyword) != std::string::npos) {
-            printf("Found: [%d] %s\n", item.id, item.content.c_str());
+    auto report = [&](size_t i) {
+        const HistoryItem& item = items[i];
+        if (item.content.find(keyword) != std::string::npos) {
+            printf("Found: [%zu] %s\n", i, item.content.c_str());
             found = true;
         }
+    };
+    if (SearchIndex::indexable(keyword)) {
+        std::vector<uint32_t> candidates;
+        searchIndex.candidates(keyword, candidates);
+        for (uint32_t i : candidates) report(i);
+    } else {
+        for (size_t i = 0; i < items.size(); ++i) report(i);
     }
     if (!found)
         printf("No match found for: %s\n", keyword.c_str());
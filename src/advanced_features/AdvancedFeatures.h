@@ -1,18 +1,17 @@
 #pragma once
 #include "../../include/Item.h"
-#include <stack>
+#include "../search/SearchIndex.h"
 #include <vector>
-#include <unordered_map>
 #include <iostream>
 
 class AdvancedFeatures {
 public:
-    void addForUndo(const ClipboardItem& item);
-    ClipboardItem undo();
-    void buildSearchIndex(const std::vector<ClipboardItem>& items);
+    void buildSearchIndex(const std::vector<HistoryItem>& items);
     void search(const std::string& keyword) const;
 
 private:
-    std::stack<ClipboardItem> undoStack;
-    std::unordered_map<std::string, ClipboardItem> searchMap;
+    // The indexed items once, and a trigram index of their contents whose
+    // document ids are positions in items.
+    std::vector<HistoryItem> items;
+    SearchIndex searchIndex;
 };
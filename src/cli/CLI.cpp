@@ -1,22 +1,39 @@
 #include <cstdio>
 #include <iostream>
 #include <string>
-#include <filesystem>
 #include "CLI.h"
+#include "../history_manager/Timestamp.h"
+#include "../stats/Stats.h"
 #include <cstring> 
+#include <cstdlib>
+#include <sstream>
+#include <ctime>
 
 using namespace std;
 
-CLI::CLI(const string &dataDir)
-    : m_dataDir(dataDir), history(dataDir) {
-    filesystem::create_directories(m_dataDir);
+CLI::CLI(HistoryManager &history)
+    : history(history) {}
+
+// What is printed for an item: its text, or a description of a binary
+// payload such as "[image/png, 48213 bytes]".
+static string_view shown(ItemType type, string_view content, string_view mime, size_t size, string &scratch) {
+    if (isTextual(type)) return content;
+    scratch = "[" + string(mime) + ", " + to_string(size) + " bytes]";
+    return scratch;
+}
+
+static string_view shown(const ItemView &it, string &scratch) {
+    return shown(it.type, it.content, it.mime, it.size, scratch);
+}
+
+static string_view shown(const HistoryItem &it, string &scratch) {
+    return shown(it.type(), it.content, it.mime, it.size, scratch);
 }
 
 int CLI::runCommandLine(int argc, char** argv) {
     if (argc > 1) {
-        string command = argv[1];
-        handleCommand(command);
-        return 0;
+        vector<string> args(argv + 1, argv + argc);
+        return handleCommand(args, cout);
     }
     runMenu();
     return 0;
@@ -39,9 +56,10 @@ void CLI::runMenu() {
             case 2: deleteItem(); break;
             case 3: pinItem(); break;
             case 4: unpinItem(); break;
-            case 5: undoDelete(); break;
+            case 5: undo(); break;
             case 6: showHistory(); break;
             case 7: searchItems(); break;
+            case 8: redo(); break;
             case 0: return;
             default: printf("Invalid option!\n");
         }
@@ -54,9 +72,10 @@ void CLI::showMenu() {
     printf("2. Delete Item\n");
     printf("3. Pin Item\n");
     printf("4. Unpin Item\n");
-    printf("5. Undo Delete\n");
+    printf("5. Undo\n");
     printf("6. Show History\n");
     printf("7. Search Items\n");
+    printf("8. Redo\n");
     printf("0. Exit\n");
 }
 
@@ -67,7 +86,7 @@ void CLI::addItem() {
     fgets(buffer, sizeof(buffer), stdin);
     buffer[strcspn(buffer, "\n")] = 0; // remove newline
 
-    history.addItem(string(buffer));
+    history.addItem(string(buffer), "cli");
     printf("Added successfully!\n");
 }
 
@@ -113,20 +132,27 @@ void CLI::unpinItem() {
     else printf("ID not found.\n");
 }
 
-void CLI::undoDelete() {
-    if (history.undoDelete()) printf("Undo successful!\n");
+void CLI::undo() {
+    if (history.undo()) printf("Undo successful!\n");
     else printf("Nothing to undo.\n");
 }
 
+void CLI::redo() {
+    if (history.redo()) printf("Redo successful!\n");
+    else printf("Nothing to redo.\n");
+}
+
 void CLI::showHistory() {
-    auto items = history.readHistory();
     printf("\n--- Clipboard History ---\n");
-    int idx = 0;
-    for (const auto& item : items) {
-        printf("[%d] %s", idx++, item.content.c_str());
+    string scratch;
+    history.visitHistory([&](const ItemView &item) {
+        printf("[%zu] ", item.index);
+        string_view text = shown(item, scratch);
+        fwrite(text.data(), 1, text.size(), stdout);
         if (item.pinned) printf(" (Pinned)");
         printf("\n");
-    }
+        return true;
+    });
 }
 
 void CLI::searchItems() {
@@ -136,17 +162,290 @@ void CLI::searchItems() {
     fgets(keyword, sizeof(keyword), stdin);
     keyword[strcspn(keyword, "\n")] = 0;
 
-    auto results = history.search(string(keyword));
-    for (const auto& item : results)
-        printf("%s - %s\n", item.timestamp.c_str(), item.content.c_str());
+    string when, scratch;
+    history.visitSearch(string(keyword), [&](const ItemView &item) {
+        when.clear();
+        timestamp::appendFormatted(item.time, when);
+        printf("%s - ", when.c_str());
+        string_view text = shown(item, scratch);
+        fwrite(text.data(), 1, text.size(), stdout);
+        printf("\n");
+        return true;
+    });
+}
+
+bool CLI::isCommand(const string &cmd) {
+    return cmd == "history" || cmd == "search" || cmd == "pin" || cmd == "unpin" ||
+           cmd == "delete" || cmd == "undo" || cmd == "redo" || cmd == "batch" || cmd == "archive" ||
+           cmd == "query" || cmd == "stats";
+}
+
+bool CLI::parseIndex(const string &text, size_t &index) {
+    char *end = nullptr;
+    long value = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || value < 0) return false;
+    index = static_cast<size_t>(value);
+    return true;
+}
+
+// A --since/--until value: an age such as 90s, 15m, 2h, 7d or 4w, or a local
+// date "YYYY-MM-DD" with an optional " HH:MM[:SS]". Microseconds since the epoch.
+static bool parseTime(const string &text, int64_t &out) {
+    char *end = nullptr;
+    long long amount = strtoll(text.c_str(), &end, 10);
+    if (!text.empty() && end != text.c_str() && end[0] != '\0' && end[1] == '\0' && amount >= 0) {
+        static const struct { char unit; int64_t seconds; } units[] = {
+            {'s', 1}, {'m', 60}, {'h', 3600}, {'d', 86400}, {'w', 7 * 86400}};
+        for (const auto &u : units) {
+            if (*end == u.unit) {
+                out = timestamp::nowMicros() - amount * u.seconds * 1000000;
+                return true;
+            }
+        }
+        return false;
+    }
+    tm t{};
+    int fields = sscanf(text.c_str(), "%d-%d-%d %d:%d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday,
+                        &t.tm_hour, &t.tm_min, &t.tm_sec);
+    if (fields != 3 && fields < 5) return false;
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    t.tm_isdst = -1;
+    time_t when = mktime(&t);
+    if (when == static_cast<time_t>(-1)) return false;
+    out = static_cast<int64_t>(when) * 1000000;
+    return true;
+}
+
+// A latency in the unit that keeps it readable: "850ns", "12.3us", "4.56ms".
+static string duration(uint64_t nanos) {
+    char text[32];
+    if (nanos < 1000) snprintf(text, sizeof(text), "%lluns", static_cast<unsigned long long>(nanos));
+    else if (nanos < 1000000) snprintf(text, sizeof(text), "%.1fus", nanos / 1e3);
+    else if (nanos < 1000000000) snprintf(text, sizeof(text), "%.2fms", nanos / 1e6);
+    else snprintf(text, sizeof(text), "%.2fs", nanos / 1e9);
+    return text;
 }
 
-void CLI::handleCommand(const string &cmd) {
+static void printStats(ostream &out) {
+    const stats::Report r = stats::report();
+    if (!r.enabled) {
+        out << "Stats are off. Set CLIPBOARD_STATS=1 before starting the daemon, or run "
+               "\"clipboard_manager stats on\" while it runs.\n";
+    } else if (r.latencies.empty() && r.counters.empty() && r.gauges.empty()) {
+        out << "Nothing recorded yet.\n";
+    }
+    char line[160];
+    if (!r.latencies.empty()) {
+        snprintf(line, sizeof(line), "%-32s %9s %9s %9s %9s %9s %9s %9s\n", "latency", "count", "mean", "p50",
+                 "p90", "p99", "p99.9", "max");
+        out << line;
+        for (const auto &l : r.latencies) {
+            const auto &s = l.summary;
+            snprintf(line, sizeof(line), "%-32s %9llu %9s %9s %9s %9s %9s %9s\n", l.name.c_str(),
+                     static_cast<unsigned long long>(s.count), duration(s.sumNanos / s.count).c_str(),
+                     duration(s.p50).c_str(), duration(s.p90).c_str(), duration(s.p99).c_str(),
+                     duration(s.p999).c_str(), duration(s.maxNanos).c_str());
+            out << line;
+        }
+    }
+    if (!r.counters.empty()) {
+        snprintf(line, sizeof(line), "%-32s %9s\n", "counter", "value");
+        out << line;
+        for (const auto &c : r.counters) {
+            snprintf(line, sizeof(line), "%-32s %9llu\n", c.name.c_str(), static_cast<unsigned long long>(c.value));
+            out << line;
+        }
+    }
+    if (!r.gauges.empty()) {
+        snprintf(line, sizeof(line), "%-32s %9s %9s\n", "queue", "now", "max");
+        out << line;
+        for (const auto &g : r.gauges) {
+            snprintf(line, sizeof(line), "%-32s %9lld %9lld\n", g.name.c_str(), static_cast<long long>(g.value),
+                     static_cast<long long>(g.max));
+            out << line;
+        }
+    }
+}
+
+int CLI::handleCommand(const vector<string> &args, ostream &out) {
+    if (args.empty()) return 1;
+    const string &cmd = args[0];
+    size_t index = 0;
+
+    string when;      // reused for every printed time
+    string scratch;   // description of a binary item
+    auto stamp = [&](int64_t time) -> const string& {
+        when.clear();
+        timestamp::appendFormatted(time, when);
+        return when;
+    };
+
     if (cmd == "history") {
-        showHistory();
+        history.visitHistory([&](const ItemView &it) {
+            out << it.index << ": [" << stamp(it.time) << "] "
+                << (it.pinned ? "[PINNED] " : "")
+                << shown(it, scratch) << "\n";
+            return true;
+        });
+    } else if (cmd == "search" && args.size() >= 2) {
+        // search [--fuzzy | --regex | --archived] [--limit=N] <query>
+        bool fuzzy = false, regex = false, archived = false;
+        size_t limit = 50;
+        size_t q = 1;
+        for (; q + 1 < args.size(); ++q) {
+            if (args[q] == "--fuzzy") fuzzy = true;
+            else if (args[q] == "--regex") regex = true;
+            else if (args[q] == "--archived") archived = true;
+            else if (args[q].rfind("--limit=", 0) == 0 && parseIndex(args[q].substr(8), limit)) continue;
+            else break;
+        }
+        if (archived) {
+            size_t read = 0, total = 0;
+            for (const auto& it : history.searchArchive(args[q], &read, &total))
+                out << "[" << stamp(it.time) << "] " << shown(it, scratch) << "\n";
+            out << "Read " << read << " of " << total << " archived segment(s).\n";
+        } else if (fuzzy || regex) {
+            vector<SearchHit> hits;
+            if (fuzzy) {
+                hits = history.fuzzySearch(args[q], limit);
+            } else {
+                string error;
+                if (!history.regexSearch(args[q], limit, hits, error)) {
+                    out << "Invalid pattern: " << error << "\n";
+                    return 1;
+                }
+            }
+            for (const auto& hit : hits)
+                out << hit.index << ": [" << stamp(hit.item.time) << "] "
+                    << (hit.item.pinned ? "[PINNED] " : "")
+                    << shown(hit.item, scratch) << "\n";
+        } else {
+            history.visitSearch(args[q], [&](const ItemView &it) {
+                out << "[" << stamp(it.time) << "] " << shown(it, scratch) << "\n";
+                return true;
+            });
+        }
+    } else if (cmd == "query") {
+        // query [--since=T] [--until=T] [--pinned | --unpinned] [--min-size=N]
+        //       [--max-size=N] [--source=S] [--limit=N]
+        HistoryQuery q;
+        for (size_t i = 1; i < args.size(); ++i) {
+            const string &a = args[i];
+            size_t value = 0;
+            int64_t when = 0;
+            if (a == "--pinned") q.pinned = true;
+            else if (a == "--unpinned") q.pinned = false;
+            else if (a.rfind("--since=", 0) == 0 && parseTime(a.substr(8), when)) q.since = when;
+            else if (a.rfind("--until=", 0) == 0 && parseTime(a.substr(8), when)) q.until = when;
+            else if (a.rfind("--min-size=", 0) == 0 && parseIndex(a.substr(11), value)) q.minSize = value;
+            else if (a.rfind("--max-size=", 0) == 0 && parseIndex(a.substr(11), value)) q.maxSize = value;
+            else if (a.rfind("--source=", 0) == 0) q.source = a.substr(9);
+            else if (a.rfind("--limit=", 0) == 0 && parseIndex(a.substr(8), value)) q.limit = value;
+            else {
+                out << "Invalid filter: " << a << "\n";
+                return 1;
+            }
+        }
+        for (const auto& hit : history.query(q))
+            out << hit.index << ": [" << stamp(hit.item.time) << "] "
+                << (hit.item.pinned ? "[PINNED] " : "")
+                << shown(hit.item, scratch) << "\n";
+    } else if (cmd == "archive" && args.size() >= 2 && parseIndex(args[1], index)) {
+        // archive <keep>: keeps the newest <keep> items (and all pinned ones) live
+        if (!history.archive(index)) {
+            out << "Archiving failed.\n";
+            return 1;
+        }
+    } else if (cmd == "pin" && args.size() >= 2 && parseIndex(args[1], index)) {
+        history.pinItem(index);
+    } else if (cmd == "unpin" && args.size() >= 2 && parseIndex(args[1], index)) {
+        history.unpinItem(index);
+    } else if (cmd == "delete" && args.size() >= 2 && parseIndex(args[1], index)) {
+        history.deleteItem(index);
     } else if (cmd == "undo") {
-        undoDelete();
+        history.undo();
+    } else if (cmd == "redo") {
+        history.redo();
+    } else if (cmd == "stats") {
+        // stats [on | off | reset]: this process's stats, the daemon's when
+        // one is running
+        const string action = args.size() >= 2 ? args[1] : "";
+        if (action == "on") stats::setEnabled(true);
+        else if (action == "off") stats::setEnabled(false);
+        else if (action == "reset") stats::reset();
+        else if (!action.empty()) {
+            out << "Unknown stats action: " << action << "\n";
+            return 1;
+        }
+        if (action.empty()) printStats(out);
+    } else if (cmd == "batch" && args.size() >= 2) {
+        // args[1] is the script itself, read by main() from a file or stdin
+        istringstream script(args[1]);
+        return runBatch(script, out);
     } else {
-        printf("Unknown command: %s\n", cmd.c_str());
+        out << "Unknown command: " << cmd << "\n";
+        return 1;
     }
+    return 0;
+}
+
+static string unescape(const string &text) {
+    string result;
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\\' && i + 1 < text.size()) {
+            char next = text[++i];
+            if (next == 'n') result += '\n';
+            else if (next == 't') result += '\t';
+            else result += next;
+        } else {
+            result += text[i];
+        }
+    }
+    return result;
+}
+
+int CLI::runBatch(istream &in, ostream &out) {
+    string error;
+    size_t applied = 0;
+    bool ok = history.batch([&](HistoryManager::Batch &b) {
+        string line;
+        size_t lineNo = 0;
+        while (getline(in, line)) {
+            ++lineNo;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+
+            size_t space = line.find(' ');
+            string cmd = line.substr(0, space);
+            string rest = space == string::npos ? "" : line.substr(space + 1);
+            size_t index = 0;
+            bool done;
+            if (cmd == "add" && !rest.empty()) done = b.addItem(unescape(rest), "cli");
+            else if (cmd == "pin" && parseIndex(rest, index)) done = b.pinItem(index);
+            else if (cmd == "unpin" && parseIndex(rest, index)) done = b.unpinItem(index);
+            else if (cmd == "delete" && parseIndex(rest, index)) done = b.deleteItem(index);
+            else if (cmd == "undo" && rest.empty()) done = b.undo();
+            else if (cmd == "redo" && rest.empty()) done = b.redo();
+            else {
+                error = "line " + to_string(lineNo) + ": invalid command: " + line;
+                return false;
+            }
+            if (!done) {
+                error = "line " + to_string(lineNo) + ": failed: " + line;
+                return false;
+            }
+            ++applied;
+        }
+        return true;
+    });
+
+    if (!ok) {
+        out << (error.empty() ? string("Batch could not be written") : error) << "\n";
+        out << "Nothing was applied.\n";
+        return 1;
+    }
+    out << "Applied " << applied << " command(s).\n";
+    return 0;
 }
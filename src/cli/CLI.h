@@ -2,17 +2,34 @@
 #define CLI_H
 
 #include <string>
+#include <vector>
+#include <ostream>
+#include <istream>
 #include "../history_manager/HistoryManager.h"
 
 class CLI {
 public:
-    explicit CLI(const std::string &dataDir);
+    explicit CLI(HistoryManager &history);   // shares the caller's manager
     int runCommandLine(int argc, char** argv);
     void runMenu(); // starts interactive mode
 
+    // Scriptable subcommands (history, search, pin, ...). args[0] is the
+    // command name; output goes to out and the exit status is returned.
+    // Used directly by main() and on behalf of clients by the daemon.
+    int handleCommand(const std::vector<std::string> &args, std::ostream &out);
+    static bool isCommand(const std::string &cmd);
+    // A non-negative decimal index; false for anything else.
+    static bool parseIndex(const std::string &text, size_t &index);
+
+    // Applies newline-delimited commands as one HistoryManager batch: either
+    // all of them are committed with a single write, or none is.
+    //   add <text>       (\n, \t and \\ escapes are decoded)
+    //   pin <i> | unpin <i> | delete <i> | undo | redo
+    // Blank lines and lines starting with '#' are skipped.
+    int runBatch(std::istream &in, std::ostream &out);
+
 private:
-    std::string m_dataDir;
-    HistoryManager history;
+    HistoryManager &history;
 
     // Menu helpers
     void showMenu();
@@ -20,12 +37,10 @@ private:
     void deleteItem();
     void pinItem();
     void unpinItem();
-    void undoDelete();
+    void undo();
+    void redo();
     void showHistory();
     void searchItems();
-
-    // Command-line mode helpers
-    void handleCommand(const std::string &cmd);
 };
 
 #endif // CLI_H
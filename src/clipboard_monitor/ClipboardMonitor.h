@@ -6,9 +6,20 @@
 #include <atomic>
 #include <thread>
 
+// Watches the system clipboard on a background thread and invokes the
+// callback (on that thread) whenever new text is copied. The thread sleeps
+// in the OS message loop, so an idle monitor costs no CPU.
+//
+// The text is converted from the OS buffer once and handed over as an
+// rvalue: move it on (into HistoryManager::addItem, a queue, ...) and the
+// clip is never copied again.
+//
+// Each OS backend is its own source file and build target:
+// ClipboardMonitorWin32.cpp, and ClipboardMonitorNone.cpp for systems
+// without one, where start() never reports a clip and readText() fails.
 class ClipboardMonitor {
 public:
-    using Callback = std::function<void(const std::string&)>;
+    using Callback = std::function<void(std::string&&)>;
 
     ClipboardMonitor();
     ~ClipboardMonitor();
@@ -17,13 +28,21 @@ public:
     void stop();
     bool isRunning() const;
 
+    // The text on the clipboard now, as UTF-8. False if there is none or
+    // the clipboard can't be opened.
+    static bool readText(std::string &out);
+
 private:
     std::atomic<bool> m_running{false};
+    std::atomic<void*> m_window{nullptr};   // HWND of the listener window
     std::thread m_thread;
     Callback m_callback;
+    // Identifies the last clip reported without keeping a copy of it.
+    size_t m_lastHash = 0;
+    size_t m_lastSize = 0;
 
     void monitorLoop();
-    std::string readClipboardWindows();
+    void onClipboardUpdate();
 };
 
 #endif // CLIPBOARD_MONITOR_H
@@ -0,0 +1,19 @@
+#include "ClipboardMonitor.h"
+
+// Backend for systems without clipboard access (or without a backend yet):
+// the history, search and CLI work as usual, there are just no new clips.
+ClipboardMonitor::ClipboardMonitor() {}
+ClipboardMonitor::~ClipboardMonitor() { stop(); }
+
+void ClipboardMonitor::start(Callback onChange) {
+    m_callback = std::move(onChange);
+}
+
+void ClipboardMonitor::stop() {}
+
+bool ClipboardMonitor::isRunning() const { return false; }
+
+bool ClipboardMonitor::readText(std::string &out) {
+    out.clear();
+    return false;
+}
@@ -0,0 +1,121 @@
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <string>
+#include <string_view>
+#include <iostream>
+#include <thread>
+#include "ClipboardMonitor.h"
+#include "../stats/Stats.h"
+
+// Posted to the listener window by stop() to leave the message loop.
+static const UINT WM_MONITOR_STOP = WM_APP + 1;
+
+// See stats::report().
+static stats::Histogram &readTime = stats::histogram("monitor.read");
+static stats::Histogram &callbackTime = stats::histogram("monitor.callback");   // the monitor thread is busy
+static stats::Counter &clipsSeen = stats::counter("monitor.clips");
+static stats::Counter &repeatsSkipped = stats::counter("monitor.repeats_skipped");
+static stats::Counter &bytesRead = stats::counter("monitor.bytes_read");
+
+ClipboardMonitor::ClipboardMonitor() {}
+ClipboardMonitor::~ClipboardMonitor() { stop(); }
+
+void ClipboardMonitor::start(Callback onChange) {
+    if (m_running) return;
+    if (m_thread.joinable()) m_thread.join();   // loop that failed to set up
+    m_running = true;
+    m_callback = std::move(onChange);
+    m_thread = std::thread([this]() { monitorLoop(); });
+}
+
+void ClipboardMonitor::stop() {
+    m_running = false;
+    // If the window does not exist yet, monitorLoop sees m_running == false
+    // right after creating it and exits on its own.
+    HWND hwnd = static_cast<HWND>(m_window.load());
+    if (hwnd) PostMessageW(hwnd, WM_MONITOR_STOP, 0, 0);
+    if (m_thread.joinable()) m_thread.join();
+}
+
+bool ClipboardMonitor::isRunning() const { return m_running; }
+
+bool ClipboardMonitor::readText(std::string &out) {
+    stats::Timer timer(readTime);
+    out.clear();
+    if (!IsClipboardFormatAvailable(CF_UNICODETEXT)) return false;
+    if (!OpenClipboard(nullptr)) return false;
+
+    HGLOBAL hData = GetClipboardData(CF_UNICODETEXT);
+    if (hData) {
+        LPCWSTR pszText = static_cast<LPCWSTR>(GlobalLock(hData));
+        if (pszText) {
+            int size_needed = WideCharToMultiByte(CP_UTF8, 0, pszText, -1, NULL, 0, NULL, NULL);
+            if (size_needed > 0) {
+                // Converted straight into the string that travels on to the store.
+                out.resize(size_needed);
+                WideCharToMultiByte(CP_UTF8, 0, pszText, -1, &out[0], size_needed, NULL, NULL);
+                if (out.back() == '\0') out.pop_back();
+            }
+            GlobalUnlock(hData);
+        }
+    }
+    CloseClipboard();
+    bytesRead.add(out.size());
+    return true;
+}
+
+void ClipboardMonitor::onClipboardUpdate() {
+    std::string cur;
+    if (!readText(cur) || cur.empty()) return;
+    clipsSeen.add();
+    size_t hash = std::hash<std::string_view>()(cur);
+    if (hash == m_lastHash && cur.size() == m_lastSize) {   // same clip again
+        repeatsSkipped.add();
+        return;
+    }
+    m_lastHash = hash;
+    m_lastSize = cur.size();
+    stats::Timer timer(callbackTime);
+    if (m_callback) m_callback(std::move(cur));
+}
+
+void ClipboardMonitor::monitorLoop() {
+    // Message-only window registered as a clipboard format listener: the OS
+    // posts WM_CLIPBOARDUPDATE on every change, so there is nothing to poll.
+    HWND hwnd = CreateWindowExW(0, L"STATIC", L"ClipboardMonitor", 0, 0, 0, 0, 0,
+                                HWND_MESSAGE, nullptr, GetModuleHandleW(nullptr), nullptr);
+    if (!hwnd) {
+        std::cerr << "ClipboardMonitor: failed to create listener window\n";
+        m_running = false;
+        return;
+    }
+    if (!AddClipboardFormatListener(hwnd)) {
+        std::cerr << "ClipboardMonitor: AddClipboardFormatListener failed\n";
+        DestroyWindow(hwnd);
+        m_running = false;
+        return;
+    }
+    m_window = hwnd;
+
+    // Only report changes made after start(), not what was already copied.
+    std::string initial;
+    readText(initial);
+    m_lastHash = std::hash<std::string_view>()(initial);
+    m_lastSize = initial.size();
+
+    MSG msg;
+    while (m_running && GetMessageW(&msg, nullptr, 0, 0) > 0) {
+        if (msg.message == WM_MONITOR_STOP) break;
+        if (msg.message == WM_CLIPBOARDUPDATE) {
+            onClipboardUpdate();
+            continue;
+        }
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+
+    m_window = nullptr;
+    RemoveClipboardFormatListener(hwnd);
+    DestroyWindow(hwnd);
+}
@@ -0,0 +1,277 @@
+#include "Daemon.h"
+#include "../cli/CLI.h"
+#include "../stats/Stats.h"
+#include <filesystem>
+#include <sstream>
+#include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <afunix.h>
+using socket_t = SOCKET;
+static void closeSocket(socket_t s) { closesocket(s); }
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+using socket_t = int;
+static void closeSocket(socket_t s) { close(s); }
+#endif
+
+namespace fs = std::filesystem;
+
+static const intptr_t kNoSocket = -1;
+
+// See stats::report(): a request from its arrival to its response being sent.
+static stats::Histogram &requestTime = stats::histogram("daemon.request");
+
+#ifdef MSG_NOSIGNAL
+static const int kSendFlags = MSG_NOSIGNAL;   // a vanished peer must not kill the daemon
+#else
+static const int kSendFlags = 0;
+#endif
+
+// Connections are served one at a time, so a client that goes quiet halfway
+// through a frame (or never sends one) would hold up everyone else. A
+// receive or send that makes no progress for this long drops it.
+static const int kIoTimeoutSeconds = 5;
+
+static void setTimeouts(socket_t s) {
+#ifdef _WIN32
+    DWORD ms = kIoTimeoutSeconds * 1000;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+#else
+    timeval tv{};
+    tv.tv_sec = kIoTimeoutSeconds;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#endif
+}
+
+static bool initSockets() {
+#ifdef _WIN32
+    static bool ok = [] {
+        WSADATA wsa;
+        return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+    }();
+    return ok;
+#else
+    return true;
+#endif
+}
+
+static bool makeAddress(const std::string &path, sockaddr_un &addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+static bool sendAll(socket_t s, const char *data, size_t len) {
+    while (len > 0) {
+        int n = send(s, data, static_cast<int>(len), kSendFlags);
+        if (n <= 0) {
+#ifndef _WIN32
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool recvAll(socket_t s, char *data, size_t len) {
+    while (len > 0) {
+        int n = recv(s, data, static_cast<int>(len), 0);
+        if (n <= 0) {
+#ifndef _WIN32
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool sendFrame(socket_t s, const std::string &payload) {
+    uint32_t len = static_cast<uint32_t>(payload.size());
+    unsigned char header[4] = {
+        static_cast<unsigned char>(len), static_cast<unsigned char>(len >> 8),
+        static_cast<unsigned char>(len >> 16), static_cast<unsigned char>(len >> 24)
+    };
+    return sendAll(s, reinterpret_cast<const char*>(header), 4) &&
+           sendAll(s, payload.data(), payload.size());
+}
+
+static bool recvFrame(socket_t s, std::string &payload) {
+    unsigned char header[4];
+    if (!recvAll(s, reinterpret_cast<char*>(header), 4)) return false;
+    uint32_t len = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<uint32_t>(header[3]) << 24);
+    if (len > daemon_protocol::kMaxFrame) return false;
+    payload.resize(len);
+    return len == 0 || recvAll(s, &payload[0], len);
+}
+
+std::string daemon_protocol::encodeRequest(const std::vector<std::string> &args) {
+    std::string payload;
+    for (const auto &arg : args) {
+        payload += arg;
+        payload += '\0';
+    }
+    return payload;
+}
+
+std::vector<std::string> daemon_protocol::decodeRequest(const std::string &payload) {
+    std::vector<std::string> args;
+    size_t start = 0;
+    while (start < payload.size()) {
+        size_t end = payload.find('\0', start);
+        if (end == std::string::npos) end = payload.size();
+        args.push_back(payload.substr(start, end - start));
+        start = end + 1;
+    }
+    return args;
+}
+
+// ---------- Server ----------
+
+DaemonServer::DaemonServer(const std::string &socketPath, CLI &cli)
+    : m_socketPath(socketPath), m_cli(cli), m_listenSocket(kNoSocket) {}
+
+DaemonServer::~DaemonServer() {
+    stop();
+}
+
+bool DaemonServer::run() {
+    if (!initSockets()) return false;
+
+    // Refuse to start twice; otherwise the socket file is a leftover.
+    DaemonClient probe(m_socketPath);
+    if (probe.connect()) {
+        std::cerr << "A daemon is already listening on " << m_socketPath << "\n";
+        return false;
+    }
+    std::error_code ec;
+    fs::remove(m_socketPath, ec);
+
+    sockaddr_un addr;
+    if (!makeAddress(m_socketPath, addr)) {
+        std::cerr << "Socket path too long: " << m_socketPath << "\n";
+        return false;
+    }
+    socket_t s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == static_cast<socket_t>(kNoSocket)) return false;
+    if (bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(s, 16) != 0) {
+        std::cerr << "Cannot listen on " << m_socketPath << "\n";
+        closeSocket(s);
+        return false;
+    }
+#ifndef _WIN32
+    chmod(m_socketPath.c_str(), 0600);   // the history is private to this user
+#endif
+    m_listenSocket = static_cast<intptr_t>(s);
+    m_running = true;
+    std::cout << "Clipboard daemon listening on " << m_socketPath << "\n";
+
+    while (m_running) {
+        socket_t client = accept(s, nullptr, nullptr);
+        if (client == static_cast<socket_t>(kNoSocket)) {
+#ifndef _WIN32
+            if (errno == EINTR) continue;
+#endif
+            break;
+        }
+        // Requests are served one at a time; each is a cheap in-memory
+        // operation on the resident history.
+        setTimeouts(client);
+        serveConnection(static_cast<intptr_t>(client));
+        closeSocket(client);
+    }
+    stop();
+    return true;
+}
+
+void DaemonServer::stop() {
+    m_running = false;
+    if (m_listenSocket != kNoSocket) {
+#ifdef _WIN32
+        shutdown(static_cast<socket_t>(m_listenSocket), SD_BOTH);
+#else
+        shutdown(static_cast<socket_t>(m_listenSocket), SHUT_RDWR);   // wakes a blocked accept()
+#endif
+        closeSocket(static_cast<socket_t>(m_listenSocket));
+        m_listenSocket = kNoSocket;
+        std::error_code ec;
+        fs::remove(m_socketPath, ec);
+    }
+}
+
+void DaemonServer::serveConnection(intptr_t client) {
+    socket_t s = static_cast<socket_t>(client);
+    std::string payload;
+    while (recvFrame(s, payload)) {
+        stats::Timer timer(requestTime);
+        auto args = daemon_protocol::decodeRequest(payload);
+        std::ostringstream out;
+        int status;
+        if (!args.empty() && args[0] == "shutdown") {
+            m_running = false;
+            status = 0;
+        } else {
+            status = m_cli.handleCommand(args, out);
+        }
+        std::string response(1, static_cast<char>(status & 0xFF));
+        response += out.str();
+        if (!sendFrame(s, response) || !m_running) return;
+    }
+}
+
+// ---------- Client ----------
+
+DaemonClient::DaemonClient(const std::string &socketPath)
+    : m_socketPath(socketPath), m_socket(kNoSocket) {}
+
+DaemonClient::~DaemonClient() {
+    if (m_socket != kNoSocket) closeSocket(static_cast<socket_t>(m_socket));
+}
+
+bool DaemonClient::connect() {
+    if (m_socket != kNoSocket) return true;
+    if (!fs::exists(m_socketPath) || !initSockets()) return false;
+    sockaddr_un addr;
+    if (!makeAddress(m_socketPath, addr)) return false;
+    socket_t s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == static_cast<socket_t>(kNoSocket)) return false;
+    if (::connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        closeSocket(s);
+        return false;
+    }
+    m_socket = static_cast<intptr_t>(s);
+    return true;
+}
+
+bool DaemonClient::request(const std::vector<std::string> &args, std::string &output, int &status) {
+    if (!connect()) return false;
+    socket_t s = static_cast<socket_t>(m_socket);
+    std::string response;
+    if (!sendFrame(s, daemon_protocol::encodeRequest(args)) || !recvFrame(s, response) || response.empty()) {
+        closeSocket(s);
+        m_socket = kNoSocket;
+        return false;
+    }
+    status = static_cast<unsigned char>(response[0]);
+    output.assign(response, 1, std::string::npos);
+    return true;
+}
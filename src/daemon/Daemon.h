@@ -0,0 +1,61 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+class CLI;
+
+// `clipboard_manager daemon` keeps one HistoryManager resident and answers
+// the scriptable subcommands over a Unix-domain socket in the data directory
+// (AF_UNIX is also available on Windows 10 1803+). Other invocations first
+// try the daemon and only load the history themselves when none is running.
+//
+// Wire format: every message is a frame of a 4-byte little-endian length
+// followed by the payload.
+//   request:  argv strings, each terminated by '\0'   ("search\0foo\0")
+//   response: one status byte (the exit code), then the command's output
+// A connection may carry any number of request/response pairs; the server
+// drops it after a few seconds without progress on a frame or between them.
+namespace daemon_protocol {
+    const uint32_t kMaxFrame = 64u * 1024 * 1024;
+    std::string encodeRequest(const std::vector<std::string> &args);
+    std::vector<std::string> decodeRequest(const std::string &payload);
+}
+
+class DaemonServer {
+public:
+    DaemonServer(const std::string &socketPath, CLI &cli);
+    ~DaemonServer();
+
+    bool run();     // serve until a "shutdown" request or stop()
+    void stop();
+
+private:
+    std::string m_socketPath;
+    CLI &m_cli;
+    std::atomic<bool> m_running{false};
+    intptr_t m_listenSocket;
+
+    void serveConnection(intptr_t client);
+};
+
+class DaemonClient {
+public:
+    explicit DaemonClient(const std::string &socketPath);
+    ~DaemonClient();
+
+    bool connect();   // false when no daemon is listening
+    // Connects if need be and runs args on the daemon. False if it could not
+    // be reached, or if the connection broke after the request was sent, in
+    // which case the daemon may already have applied it.
+    bool request(const std::vector<std::string> &args, std::string &output, int &status);
+
+private:
+    std::string m_socketPath;
+    intptr_t m_socket;
+};
+
+#endif // DAEMON_H
@@ -0,0 +1,148 @@
+#include "BlobStore.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
+#include "Timestamp.h"
+
+namespace fs = std::filesystem;
+
+static const size_t kCopyChunk = 1024 * 1024;
+// Names tried after the hash's own before a payload is given up on.
+static const uint64_t kMaxProbes = 16;
+
+// FNV-1a over the payload, 64-bit.
+static const uint64_t kHashSeed = 14695981039346656037ull;
+
+static uint64_t hashBytes(uint64_t hash, const char *data, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+BlobStore::BlobStore(const std::string &dir) : m_dir(dir) {}
+
+std::string BlobStore::path(const std::string &name) const {
+    return (fs::path(m_dir) / name).string();
+}
+
+// Unique per process, thread and call: several writers may stream the
+// same payload at once.
+std::string BlobStore::tempPath() const {
+    static std::atomic<uint64_t> counter{0};
+    char name[80];
+    std::snprintf(name, sizeof(name), ".incoming_%llx_%zx_%llu",
+                  static_cast<unsigned long long>(timestamp::nowMicros()),
+                  std::hash<std::thread::id>()(std::this_thread::get_id()),
+                  static_cast<unsigned long long>(counter++));
+    return (fs::path(m_dir) / name).string();
+}
+
+std::string BlobStore::format(uint64_t hash) {
+    char hex[kNameLength + 1];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return hex;
+}
+
+std::string BlobStore::nameOf(const char *data, size_t size) {
+    return format(hashBytes(kHashSeed, data, size));
+}
+
+// Whether the file at path holds exactly size bytes, those of the file at
+// tmpPath.
+static bool sameBytes(const std::string &tmpPath, const std::string &path, uint64_t size) {
+    std::error_code ec;
+    if (fs::file_size(path, ec) != size || ec) return false;
+    std::ifstream a(tmpPath, std::ios::binary), b(path, std::ios::binary);
+    if (!a.is_open() || !b.is_open()) return false;
+    std::unique_ptr<char[]> bufA(new char[kCopyChunk]), bufB(new char[kCopyChunk]);
+    while (a && b) {
+        a.read(bufA.get(), kCopyChunk);
+        b.read(bufB.get(), kCopyChunk);
+        if (a.gcount() != b.gcount() ||
+            std::memcmp(bufA.get(), bufB.get(), static_cast<size_t>(a.gcount())) != 0) return false;
+    }
+    return !a.bad() && !b.bad() && a.eof() && b.eof();
+}
+
+// Moves the temp file to the hash's name, or drops it if that name already
+// holds the same payload. A different payload there is a hash collision;
+// the following names are tried in turn.
+bool BlobStore::commit(const std::string &tmpPath, uint64_t size, uint64_t hash, std::string &name) {
+    std::error_code ec;
+    for (uint64_t probe = 0; probe <= kMaxProbes; ++probe) {
+        name = format(hash + probe);
+        if (fs::exists(path(name), ec)) {
+            if (!sameBytes(tmpPath, path(name), size)) continue;
+            fs::remove(tmpPath, ec);   // the same payload is already stored
+            return true;
+        }
+        fs::rename(tmpPath, path(name), ec);
+        if (ec) break;
+        return fs::exists(path(name), ec);
+    }
+    fs::remove(tmpPath, ec);
+    return false;
+}
+
+bool BlobStore::put(std::istream &in, std::string &name, uint64_t &size) {
+    std::error_code ec;
+    fs::create_directories(m_dir, ec);
+    auto tmpPath = tempPath();
+    uint64_t hash = kHashSeed;
+    size = 0;
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        std::unique_ptr<char[]> buf(new char[kCopyChunk]);
+        while (in) {
+            in.read(buf.get(), kCopyChunk);
+            auto got = static_cast<size_t>(in.gcount());
+            hash = hashBytes(hash, buf.get(), got);
+            out.write(buf.get(), static_cast<std::streamsize>(got));
+            size += got;
+        }
+        out.flush();
+        if (!out || in.bad()) {
+            out.close();
+            fs::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    return commit(tmpPath, size, hash, name);
+}
+
+bool BlobStore::put(const char *data, size_t size, std::string &name) {
+    std::error_code ec;
+    fs::create_directories(m_dir, ec);
+    auto tmpPath = tempPath();
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(data, static_cast<std::streamsize>(size));
+        out.flush();
+        if (!out) {
+            out.close();
+            fs::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    return commit(tmpPath, size, hashBytes(kHashSeed, data, size), name);
+}
+
+bool BlobStore::get(const std::string &name, std::ostream &out) const {
+    std::ifstream in(path(name), std::ios::binary);
+    if (!in.is_open()) return false;
+    std::unique_ptr<char[]> buf(new char[kCopyChunk]);
+    while (in) {
+        in.read(buf.get(), kCopyChunk);
+        out.write(buf.get(), in.gcount());
+    }
+    return !in.bad() && static_cast<bool>(out);
+}
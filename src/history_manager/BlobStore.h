@@ -0,0 +1,43 @@
+#ifndef BLOB_STORE_H
+#define BLOB_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+// Payloads too large to keep inline in history.txt (images, mostly), one
+// file each under data/blobs/. A blob is named after a hash of its bytes, so
+// storing the same image twice keeps one file. A stored blob is reused only
+// if it holds the same bytes; a different payload with the same hash takes
+// the next free name. Writes go to a temp file that is renamed into place,
+// so a listed blob is always complete.
+class BlobStore {
+public:
+    static constexpr size_t kNameLength = 16;   // hex digits of the hash
+
+    explicit BlobStore(const std::string &dir);
+
+    // Streams in to a new blob in fixed-size chunks, hashing as it goes; the
+    // payload is never held in memory as a whole. Sets its name and size.
+    bool put(std::istream &in, std::string &name, uint64_t &size);
+    bool put(const char *data, size_t size, std::string &name);
+
+    // Streams the blob to out. False if it is missing or unreadable.
+    bool get(const std::string &name, std::ostream &out) const;
+    std::string path(const std::string &name) const;
+
+    // The name a payload of these bytes has, whether or not it is stored,
+    // unless another payload with the same hash was stored under it first.
+    static std::string nameOf(const char *data, size_t size);
+
+private:
+    std::string m_dir;
+
+    std::string tempPath() const;
+    static std::string format(uint64_t hash);
+    bool commit(const std::string &tmpPath, uint64_t size, uint64_t hash, std::string &name);
+};
+
+#endif // BLOB_STORE_H
@@ -0,0 +1,68 @@
+#include "FileLock.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+FileLock::FileLock(const std::string &path) : m_path(path) {}
+
+#ifdef _WIN32
+
+FileLock::~FileLock() {
+    if (m_handle) CloseHandle(static_cast<HANDLE>(m_handle));
+}
+
+bool FileLock::open() {
+    if (m_handle) return true;
+    HANDLE h = CreateFileA(m_path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_HIDDEN, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    m_handle = h;
+    return true;
+}
+
+bool FileLock::lock() {
+    if (!open()) return false;
+    OVERLAPPED ov = {};
+    return LockFileEx(static_cast<HANDLE>(m_handle), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov) != 0;
+}
+
+void FileLock::unlock() {
+    if (!m_handle) return;
+    OVERLAPPED ov = {};
+    UnlockFileEx(static_cast<HANDLE>(m_handle), 0, 1, 0, &ov);
+}
+
+#else
+
+FileLock::~FileLock() {
+    if (m_fd >= 0) close(m_fd);
+}
+
+bool FileLock::open() {
+    if (m_fd >= 0) return true;
+    m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    return m_fd >= 0;
+}
+
+bool FileLock::lock() {
+    if (!open()) return false;
+    while (flock(m_fd, LOCK_EX) != 0) {
+        if (errno != EINTR) return false;
+    }
+    return true;
+}
+
+void FileLock::unlock() {
+    if (m_fd >= 0) flock(m_fd, LOCK_UN);
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef FILE_LOCK_H
+#define FILE_LOCK_H
+
+#include <string>
+
+// Advisory, exclusive lock on a file in the data directory. Every process
+// that opens the same directory (CLI, interactive monitor, VS Code addon)
+// takes it around reads and writes of the shared history files.
+// Not reentrant; callers in one process serialize on their own mutex first.
+class FileLock {
+public:
+    explicit FileLock(const std::string &path);
+    ~FileLock();
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    bool lock();      // blocks until the lock is held
+    void unlock();
+
+    // Holds the lock for the lifetime of a scope.
+    class Guard {
+    public:
+        explicit Guard(FileLock &lock) : m_lock(lock), m_held(lock.lock()) {}
+        ~Guard() { if (m_held) m_lock.unlock(); }
+        bool held() const { return m_held; }
+    private:
+        FileLock &m_lock;
+        bool m_held;
+    };
+
+private:
+    std::string m_path;
+#ifdef _WIN32
+    void *m_handle = nullptr;
+#else
+    int m_fd = -1;
+#endif
+    bool open();
+};
+
+#endif // FILE_LOCK_H
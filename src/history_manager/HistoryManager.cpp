@@ -1,57 +1,980 @@
 #include "HistoryManager.h"
+#include "Timestamp.h"
+#include "../search/FuzzyMatcher.h"
+#include "../search/Regex.h"
+#include "../search/TextFold.h"
+#include "../search/BloomFilter.h"
+#include "../search/SearchIndex.h"
+#include "../stats/Stats.h"
 #include <filesystem>
 #include <fstream>
 #include <sstream>
-#include <chrono>
-#include <iomanip>
 #include <iostream>
 #include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string_view>
+#include <unordered_set>
 
 namespace fs = std::filesystem;
 
+// First line of history.txt once it is stored oldest first. Files without it
+// were written newest first by older versions and are converted on the next
+// rewrite.
+static const char *kOrderHeader = "=== HISTORY OLDEST FIRST ===";
+
+// See stats::report(). Latencies include the wait for the locks.
+static stats::Histogram &loadTime = stats::histogram("history.load");       // whole file parsed
+static stats::Histogram &reloadTime = stats::histogram("history.reload");   // tail another process appended
+static stats::Histogram &batchTime = stats::histogram("history.batch");
+static stats::Histogram &appendTime = stats::histogram("history.append");
+static stats::Histogram &rewriteTime = stats::histogram("history.rewrite");
+static stats::Histogram &searchTime = stats::histogram("history.search");
+static stats::Histogram &fuzzyTime = stats::histogram("history.fuzzy_search");
+static stats::Histogram &regexTime = stats::histogram("history.regex_search");
+static stats::Histogram &queryTime = stats::histogram("history.query");
+static stats::Histogram &queryIndexTime = stats::histogram("history.query_index_build");
+static stats::Histogram &textIndexTime = stats::histogram("history.text_index_build");
+static stats::Histogram &slotWriteTime = stats::histogram("history.slot_write");
+static stats::Histogram &slotReadTime = stats::histogram("history.slot_read");
+static stats::Histogram &archiveTime = stats::histogram("history.archive");
+static stats::Histogram &archiveSearchTime = stats::histogram("history.archive_search");
+static stats::Counter &bytesRead = stats::counter("history.bytes_read");
+static stats::Counter &bytesWritten = stats::counter("history.bytes_written");
+static stats::Counter &itemsParsed = stats::counter("history.items_parsed");
+static stats::Counter &snapshotHits = stats::counter("history.snapshot_hits");        // no reload needed
+static stats::Counter &queryIndexHits = stats::counter("history.query_index_hits");   // reused as is
+static stats::Counter &textIndexHits = stats::counter("history.text_index_hits");
+static stats::Gauge &writeQueue = stats::gauge("history.write_queue");   // writers waiting for the locks
+
 HistoryManager::HistoryManager(const std::string &data_dir)
-    : m_dataDir(data_dir) {
+    : m_dataDir(data_dir),
+      m_fileLock((fs::path(data_dir) / ".lock").string()),
+      m_blobs((fs::path(data_dir) / "blobs").string()) {
     if (!fs::exists(m_dataDir)) fs::create_directories(m_dataDir);
     m_historyPath = (fs::path(m_dataDir) / "history.txt").string();
     m_lastDeletedPath = (fs::path(m_dataDir) / ".clipboard_last_deleted.txt").string();
+    m_statePath = (fs::path(m_dataDir) / ".generation").string();
+    m_archiveDir = (fs::path(m_dataDir) / "archive").string();
+    m_journalDir = (fs::path(m_dataDir) / "journal").string();
     // Ensure slot directory
     if (!fs::exists(fs::path(m_dataDir) / "slots")) {
         fs::create_directories(fs::path(m_dataDir) / "slots");
     }
 }
 
-static std::string now_iso8601() {
-    auto t = std::chrono::system_clock::now();
-    auto tt = std::chrono::system_clock::to_time_t(t);
-    std::tm* tm = std::localtime(&tt);
-    std::ostringstream ss;
-    ss << std::put_time(tm, "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+// Current snapshot. Costs one read of the small .generation file; the
+// history is reparsed only when another process has committed since. The
+// first call loads it, so one-shot commands that stream the file never do.
+std::shared_ptr<const HistoryManager::Snapshot> HistoryManager::snapshot() {
+    auto cur = std::atomic_load(&m_snapshot);
+    StoreState st;
+    if (cur && readStoreState(st) && st.generation == cur->generation && st.rewrites == cur->rewrites) {
+        snapshotHits.add();
+        return cur;
+    }
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    FileLock::Guard guard(m_fileLock);
+    return reloadLocked();
+}
+
+// Brings the snapshot up to date with the files on disk. Caller holds
+// m_writeMutex and, when possible, the file lock.
+std::shared_ptr<const HistoryManager::Snapshot> HistoryManager::reloadLocked() {
+    auto cur = std::atomic_load(&m_snapshot);
+    StoreState st;
+    bool known = readStoreState(st);
+    if (cur && known && st.generation == cur->generation && st.rewrites == cur->rewrites) {
+        return cur;
+    }
+
+    auto next = std::make_shared<Snapshot>();
+    next->generation = st.generation;
+    next->rewrites = st.rewrites;
+    if (cur && known && cur->chronological && st.rewrites == cur->rewrites) {
+        // Other processes only appended: parse just the new tail.
+        stats::Timer timer(reloadTime);
+        ItemList added;
+        next->blocks = cur->blocks;
+        next->crlf = cur->crlf;
+        loadBlock(m_historyPath, cur->fileSize, next->blocks, added, &next->fileSize, &next->crlf);
+        next->items.reserve(cur->items.size() + added.size());
+        next->items.assign(added.rbegin(), added.rend());
+        next->items.insert(next->items.end(), cur->items.begin(), cur->items.end());
+        next->chronological = true;
+    } else {
+        stats::Timer timer(loadTime);
+        next->chronological = loadBlock(m_historyPath, 0, next->blocks, next->items, &next->fileSize, &next->crlf);
+        if (next->chronological) std::reverse(next->items.begin(), next->items.end());
+    }
+    publish(next);
+    return next;
+}
+
+// Blocks with fewer records and bytes than this are left behind by single
+// batches; once there are more than kMaxSmallBlocks of them they are merged.
+static const size_t kSmallBlockItems = 64;
+static const size_t kSmallBlockBytes = 1024 * 1024;
+static const size_t kMaxSmallBlocks = 32;
+
+// Called after a rewrite, when items may have been deleted or archived:
+// drops the blocks no item refers to any more, and copies the records of
+// small blocks into one so a long-running process doesn't collect a block
+// per clip it ever saw.
+void HistoryManager::compactBlocks(Snapshot &snap) {
+    std::unordered_set<const ItemBlock*> used;
+    const ItemBlock *last = nullptr;   // items of one block come in runs
+    for (const auto &ref : snap.items) {
+        if (ref.block != last) used.insert(last = ref.block);
+    }
+
+    BlockList kept;
+    std::unordered_set<const ItemBlock*> small;
+    for (auto &block : snap.blocks) {
+        if (!used.count(block.get())) continue;
+        if (block->size() < kSmallBlockItems && block->bytes() < kSmallBlockBytes) small.insert(block.get());
+        kept.push_back(std::move(block));
+    }
+    if (small.size() > kMaxSmallBlocks) {
+        auto merged = std::make_shared<ItemBlock>();
+        for (auto &ref : snap.items) {
+            if (!small.count(ref.block)) continue;
+            ref.index = static_cast<uint32_t>(merged->add(*ref.block, ref.index));
+            ref.block = merged.get();
+        }
+        kept.erase(std::remove_if(kept.begin(), kept.end(),
+                                  [&](const std::shared_ptr<const ItemBlock> &b) { return small.count(b.get()) > 0; }),
+                   kept.end());
+        kept.push_back(std::move(merged));
+    }
+    snap.blocks.swap(kept);
+}
+
+void HistoryManager::publish(std::shared_ptr<Snapshot> next) {
+    std::atomic_store(&m_snapshot, std::shared_ptr<const Snapshot>(std::move(next)));
+}
+
+// Runs fn on a copy of the current item list under both locks. Item records
+// are shared between snapshots, only references to them are copied. The
+// result is written to disk and published to readers.
+bool HistoryManager::batch(const std::function<bool(Batch&)> &fn) {
+    stats::Timer timer(batchTime);
+    stats::Depth queued(writeQueue);
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    FileLock::Guard guard(m_fileLock);
+    queued.leave();
+    if (!guard.held()) return false;
+    // Start from what other processes committed, so their updates aren't lost.
+    auto cur = reloadLocked();
+    auto next = std::make_shared<Snapshot>(*cur);
+    Batch b(*this, next->items);
+    if (!fn(b)) return false;
+    if (b.m_block) next->blocks.push_back(b.m_block);
+
+    bool added = !b.m_added.empty();
+    if (added) {
+        ItemList merged;
+        merged.reserve(b.m_added.size() + next->items.size());
+        merged.assign(b.m_added.rbegin(), b.m_added.rend());
+        merged.insert(merged.end(), next->items.begin(), next->items.end());
+        next->items.swap(merged);
+    }
+
+    // Adds to a file that must be converted first rewrite it.
+    const bool rewrite = b.m_rewrite || (added && (!cur->chronological || cur->crlf));
+    if (rewrite) {
+        if (!writeItems(next->items)) return false;
+        next->rewrites = cur->rewrites + 1;
+        next->chronological = true;
+        next->crlf = false;
+        compactBlocks(*next);
+    } else if (added) {
+        // With an oldest-first file, new items are simply appended.
+        if (!appendItems(b.m_added)) return false;
+    } else if (!b.m_journalChanged && b.m_slotWrites.empty()) {
+        return true;   // nothing changed
+    }
+
+    for (const auto &write : b.m_slotWrites) writeSlot(write.first, write.second ? &*write.second : nullptr);
+    if (b.m_journalChanged && b.m_journal->save()) {
+        std::error_code ec;
+        fs::remove(m_lastDeletedPath, ec);   // taken over by the journal
+    }
+    next->generation = cur->generation + 1;
+    next->fileSize = historyFileSize();   // under the file lock: no one else has appended
+    if (rewrite) bytesWritten.add(next->fileSize);
+    else if (added && next->fileSize > cur->fileSize) bytesWritten.add(next->fileSize - cur->fileSize);
+    bool ok = writeStoreState(*next);
+    publish(next);
+    return ok;
+}
+
+bool HistoryManager::Batch::addItem(std::string text, const std::string &source) {
+    HistoryItem it;
+    it.content = std::move(text);
+    it.source = source;
+    return addItem(std::move(it));
+}
+
+bool HistoryManager::Batch::addItem(HistoryItem &&item) {
+    if (!m_owner.prepare(item, m_now)) return false;
+    m_added.push_back(store(std::move(item))); // newest at front of the combined list
+    return true;
+}
+
+// Readies a new item for storing: a large binary payload moves to the blob
+// store, and an item without a time gets now, taken once per commit since
+// everything in it is committed at once.
+bool HistoryManager::prepare(HistoryItem &item, int64_t &now) {
+    if (item.content.empty() && item.blob.empty()) return false;
+    if (item.blob.empty() && item.content.size() >= kBlobMinBytes && !isTextual(item.type())) {
+        // Too large to keep inline: the bytes go to the blob store instead.
+        if (!m_blobs.put(item.content.data(), item.content.size(), item.blob)) return false;
+        item.size = item.content.size();
+        item.content = std::string();
+    }
+    if (item.time == 0) {
+        if (now == 0) now = timestamp::nowMicros();
+        item.time = now;
+    }
+    return true;
+}
+
+HistoryManager::ItemRef HistoryManager::Batch::store(HistoryItem &&item) {
+    if (!m_block) m_block = std::make_shared<ItemBlock>();
+    const bool pinned = item.pinned;
+    size_t index = m_block->add(std::move(item));
+    return ItemRef{m_block.get(), static_cast<uint32_t>(index), pinned};
+}
+
+HistoryManager::ItemRef &HistoryManager::Batch::slot(size_t index) {
+    if (index < m_added.size()) return m_added[m_added.size() - 1 - index];
+    return m_items[index - m_added.size()];
+}
+
+const HistoryManager::ItemRef &HistoryManager::Batch::slot(size_t index) const {
+    if (index < m_added.size()) return m_added[m_added.size() - 1 - index];
+    return m_items[index - m_added.size()];
+}
+
+// Journal op for deleting item. An inline payload is kept in the journal;
+// a blob stays where it is.
+static bool deleteOp(Journal &journal, const ItemView &item, JournalOp &op) {
+    op.kind = JournalOp::Delete;
+    op.time = item.time;
+    op.pinned = item.pinned;
+    op.size = item.size;
+    op.mime = item.mime;
+    op.source = item.source;
+    if (!item.blob.empty()) {
+        op.inBlobs = true;
+        op.payload = item.blob;
+        return true;
+    }
+    return journal.keep(item.content.data(), item.content.size(), op.payload);
+}
+
+bool HistoryManager::Batch::deleteItem(size_t index) {
+    if (index >= size()) return false;
+    JournalOp op;
+    if (!deleteOp(journal(), slot(index).view(index), op)) return false;
+    journal().record(std::move(op));
+    m_journalChanged = true;
+    remove(index);
+    return true;
+}
+
+void HistoryManager::Batch::remove(size_t index) {
+    if (index < m_added.size()) {
+        m_added.erase(m_added.begin() + (m_added.size() - 1 - index));
+    } else {
+        m_items.erase(m_items.begin() + (index - m_added.size()));
+        m_rewrite = true;
+    }
+}
+
+bool HistoryManager::Batch::setPinned(size_t index, bool pinned) {
+    if (index >= size()) return false;
+    if (slot(index).pinned == pinned) return true;
+    JournalOp op;
+    op.kind = pinned ? JournalOp::Pin : JournalOp::Unpin;
+    op.time = slot(index).record().time;
+    op.payload = payloadName(slot(index));
+    journal().record(std::move(op));
+    m_journalChanged = true;
+    slot(index).pinned = pinned;   // the record itself stays shared
+    if (index >= m_added.size()) m_rewrite = true;
+    return true;
+}
+
+bool HistoryManager::Batch::pinItem(size_t index) { return setPinned(index, true); }
+
+bool HistoryManager::Batch::unpinItem(size_t index) { return setPinned(index, false); }
+
+// Loaded on first use. The last-deleted file of an older version becomes
+// its newest op.
+Journal &HistoryManager::Batch::journal() {
+    if (m_journal) return *m_journal;
+    m_journal = std::make_unique<Journal>(m_owner.m_journalDir);
+    m_journal->load();
+    if (auto legacy = m_owner.loadLastDeleted()) {
+        ItemView item;
+        item.time = legacy->time;
+        item.pinned = legacy->pinned;
+        item.content = legacy->content;
+        item.source = legacy->source;
+        item.size = legacy->content.size();
+        JournalOp op;
+        if (deleteOp(*m_journal, item, op)) m_journal->record(std::move(op));
+        m_journalChanged = true;
+    }
+    return *m_journal;
+}
+
+// What identifies an item's payload in the journal: its blob name, or the
+// name an inline payload would get as one.
+std::string HistoryManager::Batch::payloadName(const ItemRef &ref) const {
+    const ItemBlock::Record &r = ref.record();
+    if (r.blob) return std::string(r.blobView());
+    return BlobStore::nameOf(r.content, static_cast<size_t>(r.size));
+}
+
+// Newest item with this time and payload.
+std::optional<size_t> HistoryManager::Batch::find(int64_t time, const std::string &payload) const {
+    for (size_t i = 0; i < size(); ++i) {
+        const ItemRef &ref = slot(i);
+        if (ref.record().time == time && payloadName(ref) == payload) return i;
+    }
+    return std::nullopt;
+}
+
+// Undoes op, or does it again. False if what it changed is gone.
+bool HistoryManager::Batch::apply(const JournalOp &op, bool undo) {
+    switch (op.kind) {
+    case JournalOp::Delete: {
+        if (!undo) {
+            auto index = find(op.time, op.payload);
+            // The journal's store names a payload differently from nameOf
+            // after a hash collision; such an item is found by its bytes.
+            std::string kept;
+            if (!index && !op.inBlobs && journal().read(op.payload, kept))
+                index = find(op.time, BlobStore::nameOf(kept.data(), kept.size()));
+            if (!index) return false;
+            remove(*index);
+            return true;
+        }
+        HistoryItem it;
+        it.time = op.time;
+        it.pinned = op.pinned;
+        it.mime = op.mime;
+        it.source = op.source;
+        if (op.inBlobs) {
+            it.blob = op.payload;
+            it.size = static_cast<size_t>(op.size);
+        } else if (!journal().read(op.payload, it.content)) {
+            return false;
+        }
+        m_added.push_back(store(std::move(it)));   // back in front, with its own time
+        return true;
+    }
+    case JournalOp::Pin:
+    case JournalOp::Unpin: {
+        auto index = find(op.time, op.payload);
+        if (!index) return false;
+        slot(*index).pinned = (op.kind == JournalOp::Pin) != undo;
+        if (*index >= m_added.size()) m_rewrite = true;
+        return true;
+    }
+    case JournalOp::Slot: {
+        const std::string &name = undo ? op.before : op.after;
+        std::optional<std::string> text;
+        if (!name.empty() && !journal().read(name, text.emplace())) return false;
+        m_slotWrites.emplace_back(op.slot, std::move(text));
+        return true;
+    }
+    }
+    return false;
+}
+
+bool HistoryManager::Batch::undo() {
+    Journal &j = journal();
+    while (const JournalOp *op = j.lastDone()) {
+        m_journalChanged = true;
+        if (apply(*op, true)) {
+            j.stepBack();
+            return true;
+        }
+        j.dropLastDone();
+    }
+    return false;
+}
+
+bool HistoryManager::Batch::redo() {
+    Journal &j = journal();
+    while (const JournalOp *op = j.nextUndone()) {
+        m_journalChanged = true;
+        if (apply(*op, false)) {
+            j.stepForward();
+            return true;
+        }
+        j.dropNextUndone();
+    }
+    return false;
+}
+
+void HistoryManager::Batch::clear() {
+    m_items.clear();
+    m_added.clear();
+    m_rewrite = true;
+}
+
+// A missing .generation file means nothing has been committed with counters
+// yet (generation 0); only an unreadable one reports failure.
+bool HistoryManager::readStoreState(StoreState &st) const {
+    std::ifstream in(m_statePath);
+    if (!in.is_open()) {
+        st = StoreState();
+        return true;
+    }
+    return static_cast<bool>(in >> st.generation >> st.rewrites);
+}
+
+bool HistoryManager::writeStoreState(const Snapshot &snap) const {
+    std::ofstream out(m_statePath, std::ios::trunc);
+    if (!out.is_open()) return false;
+    out << snap.generation << " " << snap.rewrites << "\n";
+    return static_cast<bool>(out);
+}
+
+uint64_t HistoryManager::historyFileSize() const {
+    std::error_code ec;
+    auto size = fs::file_size(m_historyPath, ec);
+    return ec ? 0 : static_cast<uint64_t>(size);
+}
+
+std::string HistoryManager::makePreview(const std::string &text, size_t maxBytes) {
+    size_t begin, length;
+    ItemBlock::previewRange(text.data(), text.size(), maxBytes, begin, length);
+    return text.substr(begin, length);
+}
+
+void HistoryManager::summarize(HistoryItem &it) {
+    if (!it.blob.empty()) return;   // size came with the blob; nothing else applies
+    if (!isTextual(it.type())) {
+        it.preview.clear();
+        it.lineCount = 0;
+        it.size = it.content.size();
+        return;
+    }
+    it.preview = makePreview(it.content);
+    it.size = it.content.size();
+    it.lineCount = it.content.empty() ? 0 : 1 + std::count(it.content.begin(), it.content.end(), '\n');
+}
+
+// A decimal count with nothing after it; false for a damaged field.
+static bool parseCount(const std::string &text, uint64_t &out) {
+    if (text.empty() || text.size() > 19 || text.find_first_not_of("0123456789") != std::string::npos) return false;
+    out = std::strtoull(text.c_str(), nullptr, 10);
+    return true;
 }
 
 std::vector<HistoryItem> HistoryManager::readHistory() {
+    auto snap = snapshot();
     std::vector<HistoryItem> out;
-    std::ifstream in(m_historyPath);
-    if (!in.is_open()) return out;
-    
-    std::string entry;
+    out.reserve(snap->items.size());
+    for (const auto &it : snap->items) out.push_back(it.item());
+    return out;
+}
+
+ItemView HistoryManager::ItemRef::view(size_t position, const std::shared_ptr<const void> *owner) const {
+    const ItemBlock::Record &r = record();
+    ItemView v;
+    v.index = position;
+    v.owner = owner;
+    v.time = r.time;
+    v.pinned = pinned;
+    v.type = r.type;
+    v.content = r.contentView();
+    v.source = block->source(r);
+    v.mime = block->mime(r);
+    v.blob = r.blobView();
+    v.preview = r.previewView();
+    v.lineCount = static_cast<size_t>(r.lineCount);
+    v.size = static_cast<size_t>(r.size);
+    return v;
+}
+
+void HistoryManager::visitHistory(const ItemVisitor &visit) {
+    auto snap = snapshot();
+    const std::shared_ptr<const void> owner = snap;
+    for (size_t i = 0; i < snap->items.size(); ++i) {
+        if (!visit(snap->items[i].view(i, &owner))) break;
+    }
+}
+
+bool HistoryManager::visitItem(size_t index, const ItemVisitor &visit) {
+    auto snap = snapshot();
+    if (index >= snap->items.size()) return false;
+    const std::shared_ptr<const void> owner = snap;
+    visit(snap->items[index].view(index, &owner));
+    return true;
+}
+
+// How many items newer has in front of older's, when older's items are
+// still there unchanged behind them; newer's size otherwise. Without a
+// rewrite in between, existing items are untouched.
+size_t HistoryManager::addedInFront(const Snapshot &older, const Snapshot &newer) {
+    const auto &items = newer.items;
+    if (older.items.empty() || newer.rewrites != older.rewrites || items.size() < older.items.size()) {
+        return items.size();
+    }
+    size_t k = items.size() - older.items.size();
+    if (items[k].sameRecord(older.items.front()) && items.back().sameRecord(older.items.back())) return k;
+    return items.size();
+}
+
+// Index of snap, built on first use and kept until a query sees a newer
+// snapshot. When the newer one only has items added in front (the normal
+// case), just those are read and the rest of the old index is shifted.
+std::shared_ptr<const HistoryManager::QueryIndex>
+HistoryManager::queryIndex(const std::shared_ptr<const Snapshot> &snap) {
+    std::lock_guard<std::mutex> lock(m_queryMutex);
+    if (m_indexed == snap) {
+        queryIndexHits.add();
+        return m_queryIndex;
+    }
+    stats::Timer timer(queryIndexTime);
+
+    const auto &items = snap->items;
+    // Items in front of what m_queryIndex covers.
+    const size_t added = m_indexed ? addedInFront(*m_indexed, *snap) : items.size();
+    const bool extend = added < items.size();
+
+    auto index = std::make_shared<QueryIndex>();
+    if (extend) index->sources = m_queryIndex->sources;
+    else index->sources.push_back("");
+    auto sourceId = [&](const std::string &source) {
+        auto found = std::find(index->sources.begin(), index->sources.end(), source);
+        if (found != index->sources.end()) return static_cast<uint32_t>(found - index->sources.begin());
+        index->sources.push_back(source);
+        return static_cast<uint32_t>(index->sources.size() - 1);
+    };
+
+    index->meta.reserve(items.size());
+    const std::string *lastSource = nullptr;   // runs of items share a block's source string
+    uint32_t lastId = 0;
+    for (size_t i = 0; i < added; ++i) {
+        const ItemBlock::Record &r = items[i].record();
+        const std::string &source = items[i].block->source(r);
+        if (&source != lastSource) {
+            lastSource = &source;
+            lastId = sourceId(source);
+        }
+        index->meta.push_back({r.time, r.size, lastId, items[i].pinned});
+        if (items[i].pinned) index->pinned.push_back(static_cast<uint32_t>(i));
+    }
+    const uint32_t shift = static_cast<uint32_t>(added);
+    if (extend) {
+        const auto &old = *m_queryIndex;
+        index->meta.insert(index->meta.end(), old.meta.begin(), old.meta.end());
+        index->pinned.reserve(index->pinned.size() + old.pinned.size());
+        for (uint32_t i : old.pinned) index->pinned.push_back(i + shift);
+        index->byTime.reserve(items.size());
+        for (uint32_t i : old.byTime) index->byTime.push_back(i + shift);
+    }
+    // Newest first in the list, so walking the new items backwards continues
+    // the time order.
+    for (size_t i = added; i-- > 0;) index->byTime.push_back(static_cast<uint32_t>(i));
+    auto earlier = [&](uint32_t a, uint32_t b) { return index->meta[a].time < index->meta[b].time; };
+    if (!std::is_sorted(index->byTime.begin(), index->byTime.end(), earlier)) {
+        std::stable_sort(index->byTime.begin(), index->byTime.end(), earlier);
+    }
+    m_indexed = snap;
+    m_queryIndex = index;
+    return index;
+}
+
+std::vector<SearchHit> HistoryManager::query(const HistoryQuery &q) {
+    stats::Timer timer(queryTime);
+    auto snap = snapshot();
+    auto index = queryIndex(snap);
+    const auto &meta = index->meta;
+
+    uint32_t source = 0;
+    if (q.source) {
+        auto found = std::find(index->sources.begin(), index->sources.end(), *q.source);
+        if (found == index->sources.end()) return {};
+        source = static_cast<uint32_t>(found - index->sources.begin());
+    }
+    const int64_t since = q.since.value_or(0);
+    const int64_t until = q.until.value_or(0);
+    auto matches = [&](uint32_t i) {
+        const auto &m = meta[i];
+        return (!q.since || m.time >= since) && (!q.until || m.time < until) &&
+               (!q.pinned || m.pinned == *q.pinned) &&
+               (!q.minSize || m.size >= *q.minSize) && (!q.maxSize || m.size <= *q.maxSize) &&
+               (!q.source || m.source == source);
+    };
+
+    std::vector<uint32_t> picked;
+    const size_t limit = q.limit ? q.limit : SIZE_MAX;
+    if (q.pinned.value_or(false)) {
+        for (uint32_t i : index->pinned) {
+            if (picked.size() == limit) break;
+            if (matches(i)) picked.push_back(i);
+        }
+    } else if (q.since || q.until) {
+        auto byTime = [&](uint32_t i, int64_t t) { return meta[i].time < t; };
+        auto lo = q.since ? std::lower_bound(index->byTime.begin(), index->byTime.end(), since, byTime)
+                          : index->byTime.begin();
+        auto hi = q.until ? std::lower_bound(lo, index->byTime.end(), until, byTime)
+                          : index->byTime.end();
+        for (auto it = lo; it != hi; ++it) {
+            if (matches(*it)) picked.push_back(*it);
+        }
+        std::sort(picked.begin(), picked.end());   // newest first
+        if (picked.size() > limit) picked.resize(limit);
+    } else {
+        for (uint32_t i = 0; i < meta.size() && picked.size() < limit; ++i) {
+            if (matches(i)) picked.push_back(i);
+        }
+    }
+
+    std::vector<SearchHit> out;
+    out.reserve(picked.size());
+    for (uint32_t i : picked) out.push_back({i, 0, snap->items[i].item()});
+    return out;
+}
+
+namespace {
+
+// The first `length` bytes of history.txt as a stream. The file is opened
+// anew for each chunk and closed after it, so the export never keeps a
+// writer from replacing it. After each chunk is read, unchanged() tells
+// whether the file is still the one the length was taken from; if not, the
+// chunk is dropped, the stream ends early and rewritten() is set.
+class HistorySliceBuf : public std::streambuf {
+public:
+    static constexpr size_t kChunk = 1024 * 1024;
+
+    HistorySliceBuf(std::string path, uint64_t length, std::function<bool()> unchanged)
+        : m_path(std::move(path)), m_length(length), m_unchanged(std::move(unchanged)), m_buffer(kChunk) {}
+
+    bool rewritten() const { return m_rewritten; }
+    bool failed() const { return m_failed; }
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+        if (m_offset >= m_length || m_rewritten || m_failed) return traits_type::eof();
+        size_t got = 0;
+        {
+            std::ifstream in(m_path, std::ios::binary);
+            in.seekg(static_cast<std::streamoff>(m_offset));
+            const size_t want = static_cast<size_t>(std::min<uint64_t>(kChunk, m_length - m_offset));
+            in.read(m_buffer.data(), static_cast<std::streamsize>(want));
+            got = static_cast<size_t>(in.gcount());
+        }
+        if (!m_unchanged()) {
+            m_rewritten = true;
+            return traits_type::eof();
+        }
+        if (got == 0) {
+            m_failed = true;   // shorter than when it was measured
+            return traits_type::eof();
+        }
+        bytesRead.add(got);
+        m_offset += got;
+        setg(m_buffer.data(), m_buffer.data(), m_buffer.data() + got);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    // Positions are offsets in the file; parseEntries asks for them to
+    // check content lengths.
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        const off_type here = static_cast<off_type>(m_offset) - (egptr() - gptr());
+        const off_type from = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? here
+                                                              : static_cast<off_type>(m_length);
+        return seekpos(pos_type(from + off), which);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode) override {
+        const off_type to = pos;
+        const off_type here = static_cast<off_type>(m_offset) - (egptr() - gptr());
+        if (to < 0 || to > static_cast<off_type>(m_length)) return pos_type(off_type(-1));
+        if (to != here) {
+            m_offset = static_cast<uint64_t>(to);
+            setg(m_buffer.data(), m_buffer.data(), m_buffer.data());
+        }
+        return pos;
+    }
+
+private:
+    std::string m_path;
+    uint64_t m_length;
+    std::function<bool()> m_unchanged;
+    std::vector<char> m_buffer;
+    uint64_t m_offset = 0;
+    bool m_rewritten = false;
+    bool m_failed = false;
+};
+
+} // namespace
+
+// Streams the stored history to visit, oldest first, one entry at a time.
+// Memory use is bounded by the largest entry, not by the history size. The
+// locks are held only to take the file's length and rewrite count, and
+// briefly after each chunk to check that count, which a writer bumps under
+// them when it replaces the file. visit() runs without them, so a slow
+// reader of the export never holds up writers. Entries appended meanwhile
+// are left out. If the file is rewritten before the first entry is handed
+// out, the export starts over from a snapshot; after that it stops and
+// reports failure rather than mix two versions of the history.
+bool HistoryManager::exportHistory(const std::function<bool(const HistoryItem&)> &visit) {
+    uint64_t length = 0;
+    StoreState before;
+    bool streamable = false;
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        FileLock::Guard guard(m_fileLock);
+        std::ifstream in(m_historyPath, std::ios::binary);
+        if (!in.is_open()) return true;   // nothing stored yet
+        std::string first;
+        std::getline(in, first);
+        streamable = guard.held() && first == kOrderHeader && readStoreState(before);
+        length = historyFileSize();
+    }
+    if (streamable) {
+        HistorySliceBuf slice(m_historyPath, length, [&] {
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            FileLock::Guard guard(m_fileLock);
+            StoreState now;
+            return guard.held() && readStoreState(now) && now.rewrites == before.rewrites;
+        });
+        std::istream in(&slice);
+        size_t handedOut = 0;
+        parseEntries(in, [&](HistoryItem &&it) {
+            handedOut++;
+            return visit(it);
+        });
+        if (!slice.rewritten()) return !slice.failed() && !in.bad();
+        if (handedOut > 0) return false;
+    }
+    // A legacy newest-first file has to be reversed, and a text-mode one
+    // from Windows translated; either is converted to the streamable layout
+    // on its next rewrite. A file rewritten under a starting export is read
+    // whole as well.
+    auto snap = snapshot();
+    for (auto it = snap->items.rbegin(); it != snap->items.rend(); ++it) {
+        if (!visit(it->item())) break;
+    }
+    return true;
+}
+
+// Files are written in binary mode, so their first line (the order header
+// or an entry start) only ends in \r when a text-mode write on Windows put
+// it there.
+static bool hasCrlfLines(std::string_view image) {
+    const size_t nl = image.find('\n');
+    return nl != std::string_view::npos && nl > 0 && image[nl - 1] == '\r';
+}
+
+// Reads the history file from offset on into a single chunk of a new block
+// and appends references to its entries to out, in file order. endOffset is
+// set to where reading stopped. crlf tells whether the file was written with
+// \r\n line ends; it is found out when reading from the start and taken as
+// given otherwise. Returns whether the order header was seen.
+bool HistoryManager::loadBlock(const std::string &path, uint64_t offset, BlockList &blocks, ItemList &out,
+                               uint64_t *endOffset, bool *crlf) const {
+    if (endOffset) *endOffset = offset;
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    in.seekg(0, std::ios::end);
+    const auto end = static_cast<uint64_t>(std::max<std::streamoff>(in.tellg(), 0));
+    if (end <= offset) return false;
+    std::string image;
+    image.resize(static_cast<size_t>(end - offset));
+    in.seekg(static_cast<std::streamoff>(offset));
+    in.read(&image[0], static_cast<std::streamsize>(image.size()));
+    image.resize(static_cast<size_t>(in.gcount()));
+    if (endOffset) *endOffset = offset + image.size();
+    bytesRead.add(image.size());
+
+    bool translate = crlf && *crlf;
+    if (offset == 0) {
+        translate = hasCrlfLines(image);
+        if (crlf) *crlf = translate;
+    }
+    if (translate) {
+        // Written in text mode by an older version on Windows: turn its \r\n
+        // back into \n the way a text-mode read did.
+        size_t kept = 0;
+        for (size_t i = 0; i < image.size(); ++i) {
+            if (image[i] == '\r' && i + 1 < image.size() && image[i + 1] == '\n') continue;
+            image[kept++] = image[i];
+        }
+        image.resize(kept);
+    }
+
+    auto block = std::make_shared<ItemBlock>();
+    const size_t before = out.size();
+    bool oldestFirst = parseBlock(block->adopt(std::move(image)), *block, out);
+    itemsParsed.add(out.size() - before);
+    if (block->size() > 0) blocks.push_back(std::move(block));
+    return oldestFirst;
+}
+
+static bool startsWith(std::string_view line, std::string_view prefix) {
+    return line.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Parses the entries of a history file image into records of block that
+// point into the image, appending them to out in file order. A content is
+// taken by its CONTENT_LENGTH when the END_CONTENT line follows right there;
+// otherwise it runs up to the first END_CONTENT line. Returns whether the
+// order header was seen.
+bool HistoryManager::parseBlock(const std::string &image, ItemBlock &block, ItemList &out) {
+    const char *data = image.data();
+    const size_t size = image.size();
+    size_t pos = 0;
+    auto nextLine = [&](std::string_view &line) {
+        if (pos >= size) return false;
+        const char *nl = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+        size_t end = nl ? static_cast<size_t>(nl - data) : size;
+        line = std::string_view(data + pos, end - pos);
+        pos = nl ? end + 1 : size;
+        return true;
+    };
+    static const std::string_view kEndContent = "END_CONTENT";
+    auto endContentAt = [&](size_t at) {   // an END_CONTENT line starts at `at`
+        return size - at >= kEndContent.size() && std::memcmp(data + at, kEndContent.data(), kEndContent.size()) == 0 &&
+               (at + kEndContent.size() == size || data[at + kEndContent.size()] == '\n');
+    };
+
+    bool oldestFirst = false;
+    bool inEntry = false;
+    ItemBlock::Fields fields;
+    bool pinned = false;
+    uint64_t blobSize = 0;
+    size_t length = SIZE_MAX;
+    const char *content = nullptr;
+    size_t contentSize = 0;
+
+    std::string_view line;
+    while (nextLine(line)) {
+        if (line.find("=== ENTRY START ===") != std::string_view::npos) {
+            inEntry = true;
+            fields = ItemBlock::Fields();
+            pinned = false;
+            blobSize = 0;
+            length = SIZE_MAX;
+            content = nullptr;
+            contentSize = 0;
+            continue;
+        }
+        if (!inEntry) {
+            if (line == kOrderHeader) oldestFirst = true;
+            continue;
+        }
+        if (line.find("=== ENTRY END ===") != std::string_view::npos) {
+            if (contentSize > 0 || !fields.blob.empty()) {
+                size_t index = fields.blob.empty() ? block.add(fields, content, contentSize)
+                                                   : block.add(fields, nullptr, blobSize);
+                out.push_back(ItemRef{&block, static_cast<uint32_t>(index), pinned});
+            }
+            inEntry = false;
+        } else if (startsWith(line, "TIME_US: ")) {
+            fields.time = std::strtoll(line.data() + 9, nullptr, 10);
+        } else if (startsWith(line, "TIMESTAMP: ")) {
+            timestamp::parse(std::string(line.substr(11)), fields.time);   // written before TIME_US
+        } else if (startsWith(line, "PINNED: ")) {
+            pinned = line.substr(8) == "1";
+        } else if (startsWith(line, "SOURCE: ")) {
+            fields.source = line.substr(8);
+        } else if (startsWith(line, "MIME: ")) {
+            fields.mime = line.substr(6);
+        } else if (startsWith(line, "BLOB: ") && line.size() > 6 + BlobStore::kNameLength) {
+            // BLOB: <name> <bytes>
+            fields.blob = line.substr(6, BlobStore::kNameLength);
+            blobSize = std::strtoull(line.data() + 6 + BlobStore::kNameLength, nullptr, 10);
+        } else if (startsWith(line, "LINES: ")) {
+            fields.lineCount = std::strtoull(line.data() + 7, nullptr, 10);
+        } else if (startsWith(line, "CONTENT_LENGTH: ")) {
+            length = std::strtoull(line.data() + 16, nullptr, 10);
+        } else if (line == "CONTENT:") {
+            const size_t start = pos;
+            content = data + start;
+            if (length < size - start && data[start + length] == '\n' && endContentAt(start + length + 1)) {
+                contentSize = length;
+                pos = std::min(size, start + length + 1 + kEndContent.size() + 1);
+                continue;
+            }
+            // No usable length: the content ends at the first END_CONTENT line.
+            size_t at = start;
+            while (at < size && !endContentAt(at)) {
+                const char *nl = static_cast<const char*>(std::memchr(data + at, '\n', size - at));
+                at = nl ? static_cast<size_t>(nl - data) + 1 : size;
+            }
+            contentSize = at > start ? at - 1 - start : 0;
+            pos = std::min(size, at + kEndContent.size() + 1);
+        }
+    }
+    return oldestFirst;
+}
+
+// Offset of the end of in, or -1 if it can't seek; in is left where it was.
+static std::streamoff streamEnd(std::istream &in) {
+    const std::streampos here = in.tellg();
+    if (here == std::streampos(-1)) return -1;
+    in.seekg(0, std::ios::end);
+    const std::streamoff end = in ? static_cast<std::streamoff>(in.tellg()) : -1;
+    in.clear();
+    in.seekg(here);
+    return end;
+}
+
+// Hands each complete entry to sink, in file order, until sink returns false.
+bool HistoryManager::parseEntries(std::istream &in, const std::function<bool(HistoryItem&&)> &sink) const {
+    bool oldestFirst = false;
+    const std::streamoff end = streamEnd(in);
     std::string line;
     bool isReading = false;
     bool isReadingContent = false;
     HistoryItem currentItem;
-    size_t contentLength = 0;
+    uint64_t contentLength = 0;
+    bool hasSummary = false;
+    bool badSummary = false;
     
     while (std::getline(in, line)) {
-        if (line.find("=== ENTRY START ===") != std::string::npos) {
+        if (!isReading && line == kOrderHeader) {
+            oldestFirst = true;
+            continue;
+        }
+        if (!isReadingContent && line.find("=== ENTRY START ===") != std::string::npos) {
             isReading = true;
-            isReadingContent = false;
+            hasSummary = false;
+            badSummary = false;
+            contentLength = 0;
             currentItem = HistoryItem();
             continue;
         }
         
-        if (line.find("=== ENTRY END ===") != std::string::npos) {
-            if (isReading && !currentItem.content.empty()) {
-                out.push_back(currentItem);
+        if (!isReadingContent && line.find("=== ENTRY END ===") != std::string::npos) {
+            if (isReading && (!currentItem.content.empty() || !currentItem.blob.empty())) {
+                if (hasSummary && !badSummary) {
+                    if (currentItem.blob.empty()) {
+                        currentItem.size = currentItem.content.size();
+                        if (isTextual(currentItem.type())) currentItem.preview = makePreview(currentItem.content);
+                    }
+                } else {
+                    summarize(currentItem);   // entry written before summaries existed
+                }
+                itemsParsed.add();
+                if (!sink(std::move(currentItem))) break;
             }
             isReading = false;
             isReadingContent = false;
@@ -59,92 +982,211 @@ std::vector<HistoryItem> HistoryManager::readHistory() {
         }
         
         if (isReading) {
-            if (line.find("TIMESTAMP: ") == 0) {
-                currentItem.timestamp = line.substr(11);
+            if (isReadingContent) {
+                // content lines may look like headers, so check them first
+                if (line == "END_CONTENT") {
+                    isReadingContent = false;
+                } else {
+                    if (!currentItem.content.empty()) {
+                        currentItem.content += "\n";
+                    }
+                    currentItem.content += line;
+                }
+            } else if (line.find("TIME_US: ") == 0) {
+                currentItem.time = std::strtoll(line.c_str() + 9, nullptr, 10);
+            } else if (line.find("TIMESTAMP: ") == 0) {
+                timestamp::parse(line.substr(11), currentItem.time);   // written before TIME_US
             } else if (line.find("PINNED: ") == 0) {
                 currentItem.pinned = (line.substr(8) == "1");
+            } else if (line.find("SOURCE: ") == 0) {
+                currentItem.source = line.substr(8);
+            } else if (line.find("MIME: ") == 0) {
+                currentItem.mime = line.substr(6);
+            } else if (line.find("BLOB: ") == 0 && line.size() > 6 + BlobStore::kNameLength) {
+                currentItem.blob = line.substr(6, BlobStore::kNameLength);
+                currentItem.size = std::strtoull(line.c_str() + 6 + BlobStore::kNameLength, nullptr, 10);
+            } else if (line.find("LINES: ") == 0) {
+                uint64_t lines = 0;
+                if (parseCount(line.substr(7), lines)) {
+                    currentItem.lineCount = static_cast<size_t>(lines);
+                    hasSummary = true;
+                } else {
+                    badSummary = true;   // recomputed from the content
+                }
             } else if (line.find("CONTENT_LENGTH: ") == 0) {
-                contentLength = std::stoul(line.substr(15));
+                uint64_t length = 0;
+                contentLength = parseCount(line.substr(16), length) ? length : 0;
             } else if (line == "CONTENT:") {
                 isReadingContent = true;
-                continue;
-            } else if (line == "END_CONTENT") {
-                isReadingContent = false;
-            } else if (isReadingContent) {
-                if (!currentItem.content.empty()) {
-                    currentItem.content += "\n";
+                if (contentLength > 0 && end >= 0) {
+                    // A length past the end of the file is damaged; the
+                    // content is then read up to its END_CONTENT line.
+                    const std::streamoff at = in.tellg();
+                    if (at < 0 || contentLength > static_cast<uint64_t>(end - at)) contentLength = 0;
+                }
+                if (contentLength > 0) {
+                    // Read by length, so any bytes (even an END_CONTENT line)
+                    // come through; then the newline that ends the content.
+                    currentItem.content.resize(static_cast<size_t>(contentLength));
+                    in.read(&currentItem.content[0], static_cast<std::streamsize>(contentLength));
+                    currentItem.content.resize(static_cast<size_t>(in.gcount()));
+                    if (std::getline(in, line) && !line.empty()) {
+                        currentItem.content += line;   // the length was off: go on line by line
+                    }
                 }
-                currentItem.content += line;
             }
         }
     }
-    return out;
+    return oldestFirst;
 }
 
 bool HistoryManager::writeHistory(const std::vector<HistoryItem>& items) {
-    std::ofstream out(m_historyPath, std::ios::trunc);
+    return batch([&](Batch &b) {
+        b.clear();
+        b.m_items.reserve(items.size());
+        for (const auto &it : items) b.m_items.push_back(b.store(HistoryItem(it)));
+        return true;
+    });
+}
+
+void HistoryManager::writeEntry(std::ostream &out, const ItemRef &ref) {
+    const ItemBlock::Record &r = ref.record();
+    const std::string &source = ref.block->source(r);
+    const std::string &mime = ref.block->mime(r);
+    const std::string_view content = r.contentView();
+    out << "=== ENTRY START ===" << "\n";
+    out << "TIME_US: " << r.time << "\n";
+    out << "PINNED: " << (ref.pinned ? "1" : "0") << "\n";
+    if (!source.empty()) out << "SOURCE: " << source << "\n";
+    if (!mime.empty()) out << "MIME: " << mime << "\n";
+    if (r.blob) out << "BLOB: " << r.blobView() << " " << r.size << "\n";
+    // No preview: it is taken from the first bytes of the content on load,
+    // which costs less than reading it back. Older files carry a PREVIEW
+    // line, which is skipped.
+    out << "LINES: " << r.lineCount << "\n";
+    // Content is raw bytes; readers take CONTENT_LENGTH of them.
+    out << "CONTENT_LENGTH: " << content.size() << "\n";
+    out << "CONTENT:\n";
+    out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    out << "\nEND_CONTENT\n";
+    out << "=== ENTRY END ===" << "\n\n";
+}
+
+// Rewrites history.txt oldest first through a temp file, so a crash never
+// leaves a truncated history behind.
+bool HistoryManager::writeItems(const ItemList &items) const {
+    stats::Timer timer(rewriteTime);
+    auto tmpPath = m_historyPath + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::trunc | std::ios::binary);
+        if (!out.is_open()) return false;
+        out << kOrderHeader << "\n";
+        for (auto it = items.rbegin(); it != items.rend(); ++it) writeEntry(out, *it);
+        out.flush();
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmpPath, m_historyPath, ec);
+    return !ec;
+}
+
+bool HistoryManager::appendItems(const ItemList &oldestFirst) const {
+    stats::Timer timer(appendTime);
+    std::ofstream out(m_historyPath, std::ios::app | std::ios::binary);
     if (!out.is_open()) return false;
-    for (const auto &it : items) {
-        out << "=== ENTRY START ===" << "\n";
-        out << "TIMESTAMP: " << it.timestamp << "\n";
-        out << "PINNED: " << (it.pinned ? "1" : "0") << "\n";
-        out << "CONTENT_LENGTH: " << it.content.length() << "\n";
-        out << "CONTENT:\n" << it.content << "\nEND_CONTENT\n";
-        out << "=== ENTRY END ===" << "\n\n";
+    for (const auto &it : oldestFirst) writeEntry(out, it);
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+// Whether history.txt has to be rewritten before entries can be appended:
+// it is newest first, or was written in text mode on Windows.
+bool HistoryManager::needsConversion() const {
+    std::ifstream in(m_historyPath, std::ios::binary);
+    std::string first;
+    if (!in.is_open() || !std::getline(in, first)) return false;   // appended with a header
+    return first != kOrderHeader;
+}
+
+bool HistoryManager::append(std::vector<HistoryItem> &&oldestFirst) {
+    if (needsConversion()) {
+        bool ok = batch([&](Batch &b) {
+            for (auto &it : oldestFirst) b.addItem(std::move(it));
+            return true;
+        });
+        // Later calls append; the history loaded to convert it isn't kept.
+        std::atomic_store(&m_snapshot, std::shared_ptr<const Snapshot>());
+        return ok;
     }
-    return true;
+
+    // The records only live until they are written.
+    auto block = std::make_shared<ItemBlock>();
+    ItemList refs;
+    refs.reserve(oldestFirst.size());
+    int64_t now = 0;
+    for (auto &it : oldestFirst) {
+        if (!prepare(it, now)) continue;
+        const bool pinned = it.pinned;
+        const size_t index = block->add(std::move(it));
+        refs.push_back(ItemRef{block.get(), static_cast<uint32_t>(index), pinned});
+    }
+    if (refs.empty()) return true;
+
+    stats::Timer timer(batchTime);
+    stats::Depth queued(writeQueue);
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    FileLock::Guard guard(m_fileLock);
+    queued.leave();
+    if (!guard.held()) return false;
+    StoreState st;
+    if (!readStoreState(st)) return false;
+    const uint64_t before = historyFileSize();
+    if (before == 0) {
+        // A new file starts with the order header.
+        std::ofstream out(m_historyPath, std::ios::trunc | std::ios::binary);
+        if (!(out << kOrderHeader << "\n")) return false;
+    }
+    if (!appendItems(refs)) return false;
+    bytesWritten.add(historyFileSize() - before);
+    Snapshot state;
+    state.generation = st.generation + 1;
+    state.rewrites = st.rewrites;
+    return writeStoreState(state);
 }
 
-bool HistoryManager::addItem(const std::string &text) {
-    auto items = readHistory();
-    HistoryItem it;
-    it.timestamp = now_iso8601();
-    it.content = text;
-    it.pinned = false;
-    items.insert(items.begin(), it); // newest at front
-    return writeHistory(items);
+bool HistoryManager::addItem(std::string text, const std::string &source) {
+    return batch([&](Batch &b) { return b.addItem(std::move(text), source); });
 }
 
 bool HistoryManager::deleteItem(size_t index) {
-    auto items = readHistory();
-    if (index >= items.size()) return false;
-    auto deleted = items[index];
-    // remove that item
-    items.erase(items.begin() + index);
-    if (!writeHistory(items)) return false;
-    saveLastDeleted(deleted);
-    return true;
+    return batch([&](Batch &b) { return b.deleteItem(index); });
 }
 
 bool HistoryManager::pinItem(size_t index) {
-    auto items = readHistory();
-    if (index >= items.size()) return false;
-    items[index].pinned = true;
-    return writeHistory(items);
+    return batch([&](Batch &b) { return b.pinItem(index); });
 }
 
 bool HistoryManager::unpinItem(size_t index) {
-    auto items = readHistory();
-    if (index >= items.size()) return false;
-    items[index].pinned = false;
-    return writeHistory(items);
-}
-
-bool HistoryManager::saveLastDeleted(const HistoryItem &it) {
-    std::ofstream out(m_lastDeletedPath, std::ios::trunc);
-    if (!out.is_open()) return false;
-    out << "=== ENTRY START ===" << "\n";
-    out << "TIMESTAMP: " << it.timestamp << "\n";
-    out << "PINNED: " << (it.pinned ? "1" : "0") << "\n";
-    out << "CONTENT: " << it.content << "\n";
-    out << "=== ENTRY END ===" << "\n";
-    return true;
+    return batch([&](Batch &b) { return b.unpinItem(index); });
 }
 
+// The single deleted item older versions kept for undo, in the history
+// entry format or, before that, with a "CONTENT: " line.
 std::optional<HistoryItem> HistoryManager::loadLastDeleted() {
     std::ifstream in(m_lastDeletedPath);
     if (!in.is_open()) return std::nullopt;
-    
+
+    std::optional<HistoryItem> entry;
+    parseEntries(in, [&](HistoryItem &&it) {
+        entry = std::move(it);
+        return false;
+    });
+    if (entry) return entry;
+
+    // Written before it used the history entry format: "CONTENT: " and the
+    // first line of text, then the other lines.
+    in.clear();
+    in.seekg(0);
     HistoryItem it;
     std::string line;
     bool isReading = false;
@@ -160,10 +1202,14 @@ std::optional<HistoryItem> HistoryManager::loadLastDeleted() {
         }
         
         if (isReading) {
-            if (line.find("TIMESTAMP: ") == 0) {
-                it.timestamp = line.substr(11);
+            if (line.find("TIME_US: ") == 0) {
+                it.time = std::strtoll(line.c_str() + 9, nullptr, 10);
+            } else if (line.find("TIMESTAMP: ") == 0) {
+                timestamp::parse(line.substr(11), it.time);
             } else if (line.find("PINNED: ") == 0) {
                 it.pinned = (line.substr(8) == "1");
+            } else if (line.find("SOURCE: ") == 0 && it.content.empty()) {
+                it.source = line.substr(8);
             } else if (line.find("CONTENT: ") == 0) {
                 it.content = line.substr(9);
             } else if (!line.empty()) {
@@ -177,19 +1223,42 @@ std::optional<HistoryItem> HistoryManager::loadLastDeleted() {
     return it;
 }
 
-bool HistoryManager::undoDelete() {
-    auto maybe = loadLastDeleted();
-    if (!maybe.has_value()) return false;
-    auto it = maybe.value();
-    auto items = readHistory();
-    items.insert(items.begin(), it);
-    bool ok = writeHistory(items);
-    if (ok) {
-        // remove lastDeleted
-        std::error_code ec;
-        fs::remove(m_lastDeletedPath, ec);
+bool HistoryManager::undo() {
+    return batch([&](Batch &b) { return b.undo(); });
+}
+
+bool HistoryManager::redo() {
+    return batch([&](Batch &b) { return b.redo(); });
+}
+
+bool HistoryManager::addBlob(std::istream &in, const std::string &mime, const std::string &source) {
+    HistoryItem it;
+    it.mime = mime;
+    it.source = source;
+    if (isTextual(it.type())) {
+        // Text is kept inline, where it can be searched.
+        std::ostringstream text;
+        text << in.rdbuf();
+        it.content = text.str();
+    } else {
+        uint64_t size = 0;
+        if (!m_blobs.put(in, it.blob, size) || size == 0) return false;
+        it.size = static_cast<size_t>(size);
+        bytesWritten.add(size);
     }
-    return ok;
+    return batch([&](Batch &b) { return b.addItem(std::move(it)); });
+}
+
+bool HistoryManager::readPayload(size_t index, std::ostream &out) {
+    auto snap = snapshot();
+    if (index >= snap->items.size()) return false;
+    const ItemBlock::Record &r = snap->items[index].record();
+    if (r.blob) {
+        bytesRead.add(r.size);
+        return m_blobs.get(std::string(r.blobView()), out);
+    }
+    out.write(r.content, static_cast<std::streamsize>(r.size));
+    return static_cast<bool>(out);
 }
 
 std::string HistoryManager::historyFilePath() const {
@@ -202,74 +1271,427 @@ std::string HistoryManager::slotFilePath(int slot) const {
     return ss.str();
 }
 
+// The write is journaled with the slot's old and new content, so it can be
+// undone and redone.
 bool HistoryManager::setSlot(int slot, const std::string &text) {
     if (slot < 0 || slot > 9) return false;
-    auto path = slotFilePath(slot);
-    std::ofstream out(path, std::ios::trunc | std::ios::binary);
-    if (!out.is_open()) return false;
-    
-    // Store with entry markers and length to maintain consistency
-    out << "=== SLOT START ===" << "\n";
-    out << "CONTENT_LENGTH: " << text.length() << "\n";
-    out << "CONTENT:\n" << text << "\nEND_CONTENT\n";
-    out << "=== SLOT END ===";
+    stats::Timer timer(slotWriteTime);
+    stats::Depth queued(writeQueue);
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    FileLock::Guard guard(m_fileLock);   // other processes use the same temp name
+    queued.leave();
+    if (!guard.held()) return false;
+    Journal journal(m_journalDir);
+    journal.load();
+    JournalOp op;
+    op.kind = JournalOp::Slot;
+    op.slot = slot;
+    bool kept = true;
+    visitSlot(slot, [&](std::string_view old) {
+        kept = journal.keep(old.data(), old.size(), op.before);
+        op.beforeSize = old.size();
+    });
+    kept = kept && journal.keep(text.data(), text.size(), op.after);
+    op.afterSize = text.size();
+
+    if (!writeSlot(slot, &text)) return false;
+    if (kept) {
+        journal.record(std::move(op));
+        journal.save();
+    }
     return true;
 }
 
-std::optional<std::string> HistoryManager::getSlot(int slot) {
-    if (slot < 0 || slot > 9) return std::nullopt;
+bool HistoryManager::writeSlot(int slot, const std::string *text) {
     auto path = slotFilePath(slot);
-    std::ifstream in(path, std::ios::binary);
-    if (!in.is_open()) return std::nullopt;
-    
-    std::string content;
-    std::string line;
-    bool isReading = false;
-    bool isReadingContent = false;
-    size_t contentLength = 0;
-    
-    while (std::getline(in, line)) {
-        if (line == "=== SLOT START ===") {
-            isReading = true;
-            continue;
+    std::error_code ec;
+    if (!text) {
+        fs::remove(path, ec);
+        return !ec;
+    }
+    auto tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::trunc | std::ios::binary);
+        if (!out.is_open()) return false;
+        
+        // Store with entry markers and length to maintain consistency
+        out << "=== SLOT START ===" << "\n";
+        out << "CONTENT_LENGTH: " << text->length() << "\n";
+        out << "CONTENT:\n" << *text << "\nEND_CONTENT\n";
+        out << "=== SLOT END ===";
+        if (!out) return false;
+        if (stats::enabled()) bytesWritten.add(static_cast<uint64_t>(out.tellp()));
+    }
+    // Replace in one step so a concurrent getSlot never sees a partial file
+    fs::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+std::optional<std::string> HistoryManager::getSlot(int slot) {
+    std::optional<std::string> content;
+    visitSlot(slot, [&](std::string_view text) { content.emplace(text); });
+    return content;
+}
+
+// The slot file is read in one piece; the content is taken by its
+// CONTENT_LENGTH, or up to the END_CONTENT line if that doesn't fit.
+bool HistoryManager::visitSlot(int slot, const std::function<void(std::string_view)> &visit) {
+    if (slot < 0 || slot > 9) return false;
+    stats::Timer timer(slotReadTime);
+    std::ifstream in(slotFilePath(slot), std::ios::binary);
+    if (!in.is_open()) return false;
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    const std::string file = buffer.str();
+    bytesRead.add(file.size());
+    std::string_view data(file);
+
+    std::string_view content;
+    size_t start = data.find("\nCONTENT:\n");
+    if (start != std::string_view::npos) {
+        start += 10;
+        size_t length = SIZE_MAX;
+        size_t field = data.find("CONTENT_LENGTH: ");
+        if (field < start) length = std::strtoull(file.c_str() + field + 16, nullptr, 10);
+        if (length <= data.size() - start && data.substr(start + length).rfind("\nEND_CONTENT", 0) == 0) {
+            content = data.substr(start, length);
+        } else {
+            size_t end = data.find("\nEND_CONTENT", start - 1);
+            content = data.substr(start, end == std::string_view::npos || end < start ? 0 : end - start);
         }
-        if (line == "=== SLOT END ===") {
-            break;
+    }
+    visit(content);
+    return true;
+}
+
+// Text index of snap. The first search of this manager scans instead (null),
+// so a one-shot CLI search doesn't build an index it never reuses; later
+// ones build it, or extend the previous snapshot's by a layer for the items
+// added since, merging the newest layers while they are no more than twice
+// the size of the one added after them.
+std::shared_ptr<const HistoryManager::TextIndex>
+HistoryManager::textIndex(const std::shared_ptr<const Snapshot> &snap) {
+    std::lock_guard<std::mutex> lock(m_searchMutex);
+    if (m_searched == snap) {
+        textIndexHits.add();
+        return m_textIndex;
+    }
+    if (!m_searchedBefore) {
+        m_searchedBefore = true;
+        return nullptr;
+    }
+    stats::Timer timer(textIndexTime);
+
+    const auto &items = snap->items;
+    const size_t n = items.size();
+    const size_t added = m_searched ? addedInFront(*m_searched, *snap) : n;
+    auto index = std::make_shared<TextIndex>();
+    if (added < n) index->layers = m_textIndex->layers;
+    auto build = [&](size_t first, size_t end) {   // numbers [first, end)
+        auto layer = std::make_shared<SearchIndex>();
+        for (size_t k = first; k < end; ++k) layer->add(items[n - 1 - k].record().keyView());
+        layer->seal();
+        return TextIndex::Layer{first, std::move(layer)};
+    };
+    if (added > 0) {
+        size_t first = n - added;
+        while (!index->layers.empty() && index->layers.back().index->size() <= 2 * (n - first)) {
+            first = index->layers.back().first;
+            index->layers.pop_back();
         }
-        if (isReading) {
-            if (line.find("CONTENT_LENGTH: ") == 0) {
-                contentLength = std::stoul(line.substr(15));
-            } else if (line == "CONTENT:") {
-                isReadingContent = true;
-                continue;
-            } else if (line == "END_CONTENT") {
-                isReadingContent = false;
-            } else if (isReadingContent) {
-                if (!content.empty()) {
-                    content += "\n";
-                }
-                content += line;
-            }
+        index->layers.push_back(build(first, n));
+    }
+    m_searched = snap;
+    m_textIndex = index;
+    return index;
+}
+
+// Calls visit with the position of every item whose search key contains
+// key, newest first, until it returns false. Candidates from the text index
+// are confirmed against their key; keys too short for it are scanned.
+void HistoryManager::forEachMatch(const std::shared_ptr<const Snapshot> &snap, const std::string &key,
+                                  const std::function<bool(size_t)> &visit) {
+    const auto &items = snap->items;
+    auto index = SearchIndex::indexable(key) ? textIndex(snap) : nullptr;
+    if (!index) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (items[i].record().keyView().find(key) != std::string_view::npos && !visit(i)) return;
+        }
+        return;
+    }
+    const size_t n = items.size();
+    std::vector<uint32_t> ids;
+    for (auto layer = index->layers.rbegin(); layer != index->layers.rend(); ++layer) {
+        layer->index->candidates(key, ids);
+        for (auto id = ids.rbegin(); id != ids.rend(); ++id) {
+            const size_t i = n - 1 - (layer->first + *id);
+            if (items[i].record().keyView().find(key) != std::string_view::npos && !visit(i)) return;
         }
     }
-    
-    return content;
 }
 
+// Case- and form-insensitive substring search: the keyword's search key is
+// looked up in the keys stored with the items, nothing is folded per query.
 std::vector<HistoryItem> HistoryManager::search(const std::string &keyword) {
     if (keyword.empty()) return readHistory();
-    
-    auto items = readHistory();
+
+    stats::Timer timer(searchTime);
+    auto snap = snapshot();
     std::vector<HistoryItem> results;
-    std::string lowerKeyword = keyword;
-    std::transform(lowerKeyword.begin(), lowerKeyword.end(), lowerKeyword.begin(), ::tolower);
-    
-    for (auto &it : items) {
-        std::string lowerContent = it.content;
-        std::transform(lowerContent.begin(), lowerContent.end(), lowerContent.begin(), ::tolower);
-        if (lowerContent.find(lowerKeyword) != std::string::npos) {
-            results.push_back(it);
+    forEachMatch(snap, text_fold::searchKey(keyword), [&](size_t i) {
+        results.push_back(snap->items[i].item());
+        return true;
+    });
+    return results;
+}
+
+void HistoryManager::visitSearch(const std::string &keyword, const ItemVisitor &visit) {
+    if (keyword.empty()) return visitHistory(visit);
+
+    stats::Timer timer(searchTime);
+    auto snap = snapshot();
+    const std::shared_ptr<const void> owner = snap;
+    forEachMatch(snap, text_fold::searchKey(keyword), [&](size_t i) { return visit(snap->items[i].view(i, &owner)); });
+}
+
+// Added to a fuzzy match score: up to kRecencyBonus for the newest item,
+// falling linearly to 0 for the oldest, and kPinnedBonus for pinned items.
+static const int kRecencyBonus = 12;
+static const int kPinnedBonus = 32;
+
+std::vector<SearchHit> HistoryManager::fuzzySearch(const std::string &query, size_t limit) {
+    stats::Timer timer(fuzzyTime);
+    auto snap = snapshot();
+    std::vector<SearchHit> results;
+    rankFuzzy(snap->items, query, limit, nullptr, nullptr, nullptr, results);
+    return results;
+}
+
+// Scores the items at the indexes in candidates (every item when null) and
+// keeps the best `limit` in out, best first. The index of every match is
+// appended to matched when given. cancelled is polled every few hundred
+// items; returns false if it fired and out is incomplete.
+bool HistoryManager::rankFuzzy(const ItemList &items, const std::string &query, size_t limit,
+                               const std::vector<uint32_t> *candidates, std::vector<uint32_t> *matched,
+                               const std::function<bool()> &cancelled, std::vector<SearchHit> &out) {
+    out.clear();
+    if (limit == 0 && !matched) return true;
+    const size_t n = items.size();
+    const size_t count = candidates ? candidates->size() : n;
+
+    // Bounded heap of (score, index) with the weakest kept hit on top; ties
+    // go to the more recent item.
+    using Hit = std::pair<int, size_t>;
+    auto better = [](const Hit &a, const Hit &b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    };
+    std::vector<Hit> heap;
+    heap.reserve(std::min(limit, count) + 1);
+
+    FuzzyMatcher matcher(query);
+    for (size_t j = 0; j < count; ++j) {
+        if ((j & 255) == 255 && cancelled && cancelled()) return false;
+        size_t i = candidates ? (*candidates)[j] : j;
+        const ItemBlock::Record &r = items[i].record();
+        int score;
+        if (!r.isText() || !matcher.match(r.content, static_cast<size_t>(r.size), score)) continue;
+        if (matched) matched->push_back(static_cast<uint32_t>(i));
+        if (limit == 0) continue;
+        score += static_cast<int>(kRecencyBonus * (n - i) / n);
+        if (items[i].pinned) score += kPinnedBonus;
+        Hit hit(score, i);
+        if (heap.size() == limit) {
+            if (!better(hit, heap.front())) continue;
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.back() = hit;
+        } else {
+            heap.push_back(hit);
+        }
+        std::push_heap(heap.begin(), heap.end(), better);
+    }
+    if (cancelled && cancelled()) return false;
+
+    std::sort_heap(heap.begin(), heap.end(), better);
+    out.reserve(heap.size());
+    for (const auto &hit : heap) {
+        out.push_back(SearchHit{hit.second, hit.first, items[hit.second].item()});
+    }
+    return true;
+}
+
+bool HistoryManager::regexSearch(const std::string &pattern, size_t limit, std::vector<SearchHit> &out,
+                                 std::string &error) {
+    stats::Timer timer(regexTime);
+    out.clear();
+    Regex re(pattern);
+    if (!re.ok()) {
+        error = re.error();
+        return false;
+    }
+    auto snap = snapshot();
+    for (size_t i = 0; i < snap->items.size(); ++i) {
+        const ItemBlock::Record &r = snap->items[i].record();
+        if (!r.isText() || !re.search(r.content, static_cast<size_t>(r.size))) continue;
+        out.push_back(SearchHit{i, 0, snap->items[i].item()});
+        if (out.size() == limit) break;
+    }
+    return true;
+}
+
+// Archived items are written in segments of at most this many items/bytes,
+// so a filter that rules a keyword out saves reading a whole block.
+static const size_t kSegmentItems = 4096;
+static const size_t kSegmentBytes = 4 * 1024 * 1024;
+
+// The number of a segment_NNNNNN base name; false for other files that
+// happen to be in the archive directory.
+static bool segmentNumber(const fs::path &base, unsigned long &number) {
+    const std::string name = base.filename().string();
+    if (name.rfind("segment_", 0) != 0) return false;
+    uint64_t value = 0;
+    if (!parseCount(name.substr(8), value) || value > ULONG_MAX) return false;
+    number = static_cast<unsigned long>(value);
+    return true;
+}
+
+std::vector<std::string> HistoryManager::listSegments() const {
+    std::vector<std::string> bases;
+    std::error_code ec;
+    unsigned long number = 0;
+    for (const auto &entry : fs::directory_iterator(m_archiveDir, ec)) {
+        if (entry.path().extension() == ".txt" && segmentNumber(entry.path().stem(), number)) {
+            bases.push_back((entry.path().parent_path() / entry.path().stem()).string());
         }
     }
+    std::sort(bases.begin(), bases.end());   // names are zero-padded
+    return bases;
+}
+
+// The filter is saved first and the segment appears under its final name
+// last, so a listed segment always has its filter.
+bool HistoryManager::writeSegment(const std::string &base, const ItemList &oldestFirst) const {
+    // Distinct trigrams of the segment, deduplicated in a 2^24-bit map.
+    std::vector<uint8_t> seen(1u << 21, 0);
+    std::vector<uint32_t> grams;
+    for (const auto &it : oldestFirst) {
+        BloomFilter::forEachTrigram(it.record().keyView(), [&](uint64_t g) {
+            uint8_t &byte = seen[g >> 3];
+            uint8_t bit = static_cast<uint8_t>(1u << (g & 7));
+            if (!(byte & bit)) {
+                byte |= bit;
+                grams.push_back(static_cast<uint32_t>(g));
+            }
+        });
+    }
+    BloomFilter filter(grams.size());
+    for (uint32_t g : grams) filter.add(g);
+    if (!filter.save(base + ".bloom")) return false;
+
+    auto tmpPath = base + ".txt.tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::trunc | std::ios::binary);
+        if (!out.is_open()) return false;
+        out << kOrderHeader << "\n";
+        for (const auto &it : oldestFirst) writeEntry(out, it);
+        out.flush();
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmpPath, base + ".txt", ec);
+    return !ec;
+}
+
+std::shared_ptr<const BloomFilter> HistoryManager::segmentFilter(const std::string &base) {
+    std::lock_guard<std::mutex> lock(m_archiveMutex);
+    auto found = m_segmentFilters.find(base);
+    if (found != m_segmentFilters.end()) return found->second;
+    auto filter = std::make_shared<BloomFilter>();
+    if (!filter->load(base + ".bloom")) filter.reset();   // unreadable: always read the segment
+    m_segmentFilters.emplace(base, filter);
+    return filter;
+}
+
+bool HistoryManager::archive(size_t keep) {
+    stats::Timer timer(archiveTime);
+    std::vector<std::string> written;
+    bool nothingToDo = false;
+    bool ok = batch([&](Batch &b) {
+        ItemList live, archived;
+        for (size_t i = 0; i < b.m_items.size(); ++i) {
+            const auto &it = b.m_items[i];
+            (i < keep || it.pinned ? live : archived).push_back(it);
+        }
+        if (archived.empty()) {
+            nothingToDo = true;
+            return false;
+        }
+        std::reverse(archived.begin(), archived.end());   // segments are oldest first
+
+        std::error_code ec;
+        fs::create_directories(m_archiveDir, ec);
+        auto segments = listSegments();
+        unsigned long next = 1;
+        for (const auto &base : segments) {
+            unsigned long number = 0;
+            if (segmentNumber(base, number) && number >= next) next = number + 1;
+        }
+        for (size_t start = 0; start < archived.size();) {
+            ItemList chunk;
+            size_t bytes = 0;
+            while (start < archived.size() && chunk.size() < kSegmentItems && bytes < kSegmentBytes) {
+                bytes += archived[start].record().contentView().size();
+                chunk.push_back(archived[start++]);
+            }
+            char name[32];
+            std::snprintf(name, sizeof(name), "segment_%06lu", next++);
+            auto base = (fs::path(m_archiveDir) / name).string();
+            written.push_back(base);
+            if (!writeSegment(base, chunk)) return false;
+        }
+        b.m_items.swap(live);
+        b.m_rewrite = true;
+        return true;
+    });
+    if (!ok) {
+        // History wasn't rewritten: take back the segments written so far.
+        std::error_code ec;
+        for (const auto &base : written) {
+            fs::remove(base + ".txt", ec);
+            fs::remove(base + ".txt.tmp", ec);
+            fs::remove(base + ".bloom", ec);
+        }
+    }
+    return ok || nothingToDo;
+}
+
+std::vector<HistoryItem> HistoryManager::searchArchive(const std::string &keyword,
+                                                       size_t *segmentsRead, size_t *segmentsTotal) {
+    stats::Timer timer(archiveSearchTime);
+    const std::string key = text_fold::searchKey(keyword);
+    std::vector<uint64_t> grams;
+    BloomFilter::forEachTrigram(key, [&](uint64_t g) { grams.push_back(g); });
+
+    auto segments = listSegments();
+    size_t read = 0;
+    std::vector<HistoryItem> results;
+    for (auto base = segments.rbegin(); base != segments.rend(); ++base) {
+        if (!grams.empty()) {
+            auto filter = segmentFilter(*base);
+            if (filter && !std::all_of(grams.begin(), grams.end(),
+                                       [&](uint64_t g) { return filter->mayContain(g); })) {
+                continue;
+            }
+        }
+        BlockList blocks;
+        ItemList items;
+        loadBlock(*base + ".txt", 0, blocks, items);
+        if (blocks.empty()) continue;
+        read++;
+        for (auto it = items.rbegin(); it != items.rend(); ++it) {
+            if (it->record().keyView().find(key) != std::string_view::npos) results.push_back(it->item());
+        }
+    }
+    if (segmentsRead) *segmentsRead = read;
+    if (segmentsTotal) *segmentsTotal = segments.size();
     return results;
-}
\ No newline at end of file
+}
@@ -4,40 +4,317 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <map>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string_view>
+#include "BlobStore.h"
+#include "FileLock.h"
+#include "ItemBlock.h"
+#include "Journal.h"
 
-struct HistoryItem {
-    std::string timestamp;
-    std::string content;
+class BloomFilter;
+class SearchIndex;
+
+// Non-owning view of a stored item, handed to the visit* callbacks. The
+// views point into the history snapshot the visit runs on and are valid
+// until the visit* call returns; copy what must outlive it, or keep a copy
+// of *owner.
+struct ItemView {
+    size_t index = 0;            // position in the history (0 = latest)
+    int64_t time = 0;
     bool pinned = false;
+    ItemType type = ItemType::Text;
+    std::string_view content;    // empty for a blob payload: see readPayload
+    std::string_view source;
+    std::string_view mime;
+    std::string_view blob;
+    std::string_view preview;
+    size_t lineCount = 0;
+    size_t size = 0;             // payload bytes
+    // The snapshot the views point into. A copy of it keeps their bytes
+    // valid after the visit, for handing them out without copying them.
+    const std::shared_ptr<const void> *owner = nullptr;
+};
+using ItemVisitor = std::function<bool(const ItemView&)>;   // returns false to stop
+
+// One search or query result.
+struct SearchHit {
+    size_t index = 0;   // position in the history (0 = latest)
+    int score = 0;
+    HistoryItem item;
 };
 
+// Filter for HistoryManager::query; unset fields match everything. Times are
+// microseconds since the epoch, since inclusive and until exclusive.
+struct HistoryQuery {
+    std::optional<int64_t> since;
+    std::optional<int64_t> until;
+    std::optional<bool> pinned;
+    std::optional<size_t> minSize;      // content bytes
+    std::optional<size_t> maxSize;
+    std::optional<std::string> source;
+    size_t limit = 0;                   // 0 = all
+};
+
+// Thread-safe: readers work on an immutable snapshot of the history that is
+// swapped atomically, so they never wait for a writer. Writers are serialized,
+// copy the snapshot's item pointers, persist the result and publish it.
+//
+// Several processes may share one data directory. Writers hold the advisory
+// lock on data/.lock, first catch up with other processes' commits, then bump
+// the generation counter in data/.generation. Readers compare that counter
+// with their snapshot and reload only when it moved; if other processes only
+// appended, just the new tail of history.txt is parsed.
 class HistoryManager {
 public:
     HistoryManager(const std::string &data_dir);
 
     // High-level operations
-    std::vector<HistoryItem> readHistory();               // read history.txt
-    bool writeHistory(const std::vector<HistoryItem>&);   // overwrite history.txt
-    bool addItem(const std::string &text);                // prepend new item
+    std::vector<HistoryItem> readHistory();               // current history, newest first
+    // Without copies: every item newest first, one item by index (false if
+    // there is none), or the items search() would return. Each call works on
+    // one snapshot, which stays alive until it returns.
+    void visitHistory(const ItemVisitor &visit);
+    bool visitItem(size_t index, const ItemVisitor &visit);
+    void visitSearch(const std::string &keyword, const ItemVisitor &visit);
+    bool writeHistory(const std::vector<HistoryItem>&);   // replace history and overwrite history.txt
+    // Prepends a new item. text is taken by value: pass an rvalue and a large
+    // clip is moved into the store instead of copied.
+    bool addItem(std::string text, const std::string &source = "");
     bool deleteItem(size_t index);                        // delete by index (0 = latest)
     bool pinItem(size_t index);
     bool unpinItem(size_t index);
-    bool undoDelete();                                    // simple undo support
+    // Multi-step undo and redo of deletes, pins, unpins and slot writes,
+    // kept in data/journal/ across restarts (see Journal). Added items are
+    // not journaled. False when there is nothing left to undo or redo.
+    bool undo();
+    bool redo();
+
+    // Adds an item of the given MIME type whose payload is streamed from in
+    // straight into the blob store (data/blobs/), so a large image never has
+    // to fit in memory or pass through the history file.
+    bool addBlob(std::istream &in, const std::string &mime, const std::string &source = "");
+    // Writes the payload of item index to out, from the history or its blob.
+    bool readPayload(size_t index, std::ostream &out);
+    bool readBlob(const std::string &name, std::ostream &out) const { return m_blobs.get(name, out); }
+    // Binary payloads of at least this many bytes go to the blob store
+    // however they are added.
+    static constexpr size_t kBlobMinBytes = 64 * 1024;
+
+    class Batch;
+    // Applies any number of changes under one lock acquisition with a single
+    // write to disk: new items only are appended, anything else rewrites the
+    // file once. If fn returns false nothing is written or published.
+    bool batch(const std::function<bool(Batch&)> &fn);
+    // Adds items, oldest first, by appending them to history.txt without
+    // loading the history or keeping a snapshot, for bulk imports whose
+    // memory use must not grow with the history. Readers here and in other
+    // processes pick them up through the generation counter. A legacy
+    // newest-first or text-mode file is converted by one batch() first.
+    bool append(std::vector<HistoryItem> &&oldestFirst);
 
     // Slots (0-9) operations stored in files slots/slot_<n>.txt
     bool setSlot(int slot, const std::string &text);
     std::optional<std::string> getSlot(int slot);
+    // Hands the slot's content to visit without copying it out of the read
+    // buffer; the view is valid during the call. False if nothing was saved
+    // to the slot.
+    bool visitSlot(int slot, const std::function<void(std::string_view)> &visit);
+
+    // Items matching every predicate of q, newest first. Predicates run on
+    // compact per-item metadata; time ranges and pinned-only queries go
+    // through an index, so they touch only the items in range.
+    std::vector<SearchHit> query(const HistoryQuery &q);
+
+    // Moves all but the newest `keep` items (pinned items always stay) out of
+    // history.txt into sealed segment files under data/archive/. Each segment
+    // carries a Bloom filter of its items' search-key trigrams.
+    bool archive(size_t keep);
+    // Archived items whose search key contains the keyword's, newest first.
+    // Segments whose filter rules the keyword out are never read; how many
+    // were read out of how many is reported when asked for.
+    std::vector<HistoryItem> searchArchive(const std::string &keyword,
+                                           size_t *segmentsRead = nullptr, size_t *segmentsTotal = nullptr);
+
+    // Streams the stored history oldest first without loading it; visit
+    // returns false to stop early. Writers are not held up meanwhile; false
+    // if the file was rewritten after the first item was handed out.
+    bool exportHistory(const std::function<bool(const HistoryItem&)> &visit);
 
     std::string historyFilePath() const;
     std::string slotFilePath(int slot) const;
     std::vector<HistoryItem> search(const std::string &keyword); // search history items by keyword
+    // Fuzzy match (see FuzzyMatcher) boosted for recent and pinned items.
+    // Only the best `limit` hits are kept while scanning; they are returned
+    // best first.
+    std::vector<SearchHit> fuzzySearch(const std::string &query, size_t limit);
+    // Items matching a regular expression (see Regex), newest first, at most
+    // `limit` of them (0 = all). False, with error set, if pattern is invalid.
+    bool regexSearch(const std::string &pattern, size_t limit, std::vector<SearchHit> &out, std::string &error);
+
+    static constexpr size_t kPreviewMaxBytes = 120;
+    // First non-blank line of text, trimmed and cut to maxBytes on a UTF-8
+    // character boundary.
+    static std::string makePreview(const std::string &text, size_t maxBytes = kPreviewMaxBytes);
+    static void summarize(HistoryItem &it);               // fill preview/lineCount/size
 
 private:
+    // An item of a snapshot: a record in one of the snapshot's blocks, plus
+    // the pinned state, which pinning changes without touching the record.
+    struct ItemRef {
+        const ItemBlock *block = nullptr;
+        uint32_t index = 0;
+        bool pinned = false;
+
+        const ItemBlock::Record &record() const { return (*block)[index]; }
+        HistoryItem item() const { return block->item(index, pinned); }
+        bool sameRecord(const ItemRef &other) const { return block == other.block && index == other.index; }
+        ItemView view(size_t position, const std::shared_ptr<const void> *owner = nullptr) const;
+    };
+    using ItemList = std::vector<ItemRef>;
+    using BlockList = std::vector<std::shared_ptr<const ItemBlock>>;
+
+public:
+    // Working copy handed to batch(). Indexes refer to the list as changed by
+    // the earlier operations of the same batch (0 = latest).
+    class Batch {
+    public:
+        bool addItem(std::string text, const std::string &source = "");
+        bool addItem(HistoryItem &&item);   // keeps time/pinned/source; time 0 = now
+        bool deleteItem(size_t index);
+        bool pinItem(size_t index);
+        bool unpinItem(size_t index);
+        bool undo();
+        bool redo();
+        void clear();
+        size_t size() const { return m_added.size() + m_items.size(); }
+        HistoryItem at(size_t index) const { return slot(index).item(); }
+
+    private:
+        friend class HistoryManager;
+        Batch(HistoryManager &owner, ItemList &items) : m_owner(owner), m_items(items) {}
+        ItemRef &slot(size_t index);
+        const ItemRef &slot(size_t index) const;
+        bool setPinned(size_t index, bool pinned);
+        void remove(size_t index);           // deletes without journaling
+        ItemRef store(HistoryItem &&item);   // into m_block
+        Journal &journal();                  // loaded on first use
+        std::string payloadName(const ItemRef &ref) const;
+        std::optional<size_t> find(int64_t time, const std::string &payload) const;
+        bool apply(const JournalOp &op, bool undo);
+
+        HistoryManager &m_owner;
+        ItemList &m_items;             // entries already on disk, newest first
+        ItemList m_added;              // new entries, oldest first; they precede m_items
+        bool m_rewrite = false;        // existing entries changed: rewrite the file
+        int64_t m_now = 0;             // time shared by the batch's new items
+        std::shared_ptr<ItemBlock> m_block;   // records of the batch's new items
+        std::unique_ptr<Journal> m_journal;
+        bool m_journalChanged = false;
+        // Slot files to write on commit; nullopt removes one.
+        std::vector<std::pair<int, std::optional<std::string>>> m_slotWrites;
+    };
+
+private:
+
+    struct Snapshot {
+        ItemList items;               // newest first
+        BlockList blocks;             // hold the records of items
+        uint64_t generation = 0;      // store generation these items reflect
+        uint64_t rewrites = 0;        // full rewrites of history.txt seen so far
+        uint64_t fileSize = 0;        // bytes of history.txt parsed into items
+        bool chronological = false;   // file is stored oldest first, so adds can append
+        bool crlf = false;            // written in text mode on Windows; rewritten before adds
+    };
+    struct StoreState {
+        uint64_t generation = 0;      // bumped by every commit, from any process
+        uint64_t rewrites = 0;        // bumped only when history.txt is rewritten
+    };
+
+    // Query metadata of one snapshot, built on the first query against it.
+    struct QueryIndex {
+        struct Meta {
+            int64_t time;
+            uint64_t size;
+            uint32_t source;              // index into sources
+            bool pinned;
+        };
+        std::vector<Meta> meta;           // parallel to Snapshot::items
+        std::vector<uint32_t> byTime;     // positions of dated items, oldest first
+        std::vector<uint32_t> pinned;     // positions of pinned items, newest first
+        std::vector<std::string> sources; // distinct sources; "" is always 0
+    };
+    // Trigram index (see SearchIndex) of one snapshot's search keys. Items
+    // are numbered oldest first, so items added in front only extend the
+    // numbering; each extension gets a layer of its own, and small layers
+    // are merged as they pile up.
+    struct TextIndex {
+        struct Layer {
+            size_t first;                                // number of the layer's document 0
+            std::shared_ptr<const SearchIndex> index;
+        };
+        std::vector<Layer> layers;                       // oldest items first
+    };
+
     std::string m_dataDir;
     std::string m_historyPath;
-    std::string m_lastDeletedPath;
-    bool saveLastDeleted(const HistoryItem &it);
+    std::string m_lastDeletedPath;   // single-step undo of older versions, moved into the journal
+    std::string m_journalDir;
+    std::string m_statePath;
+    std::string m_archiveDir;
+
+    FileLock m_fileLock;
+    BlobStore m_blobs;
+    std::shared_ptr<const Snapshot> m_snapshot;  // accessed only via std::atomic_load/store
+    std::mutex m_writeMutex;                     // serializes writers (and reloads)
+    std::mutex m_queryMutex;                     // guards m_indexed/m_queryIndex
+    std::shared_ptr<const Snapshot> m_indexed;   // snapshot m_queryIndex describes
+    std::shared_ptr<const QueryIndex> m_queryIndex;
+    std::mutex m_searchMutex;                    // guards the members below
+    std::shared_ptr<const Snapshot> m_searched;  // snapshot m_textIndex describes
+    std::shared_ptr<const TextIndex> m_textIndex;
+    bool m_searchedBefore = false;
+    std::mutex m_archiveMutex;                   // guards m_segmentFilters
+    // Loaded segment filters by segment path; sealed segments never change.
+    std::map<std::string, std::shared_ptr<const BloomFilter>> m_segmentFilters;
+
+    std::shared_ptr<const Snapshot> snapshot();
+    std::shared_ptr<const Snapshot> reloadLocked();
+    void publish(std::shared_ptr<Snapshot> next);
+    static size_t addedInFront(const Snapshot &older, const Snapshot &newer);
+    std::shared_ptr<const QueryIndex> queryIndex(const std::shared_ptr<const Snapshot> &snap);
+    std::shared_ptr<const TextIndex> textIndex(const std::shared_ptr<const Snapshot> &snap);
+    void forEachMatch(const std::shared_ptr<const Snapshot> &snap, const std::string &key,
+                      const std::function<bool(size_t)> &visit);
+    bool readStoreState(StoreState &st) const;
+    bool writeStoreState(const Snapshot &snap) const;
+    bool loadBlock(const std::string &path, uint64_t offset, BlockList &blocks, ItemList &out,
+                   uint64_t *endOffset = nullptr, bool *crlf = nullptr) const;
+    static bool parseBlock(const std::string &image, ItemBlock &block, ItemList &out);
+    bool parseEntries(std::istream &in, const std::function<bool(HistoryItem&&)> &sink) const;
+    static void writeEntry(std::ostream &out, const ItemRef &ref);
+    static void compactBlocks(Snapshot &snap);
+    bool writeItems(const ItemList &items) const;
+    bool appendItems(const ItemList &oldestFirst) const;
+    bool prepare(HistoryItem &item, int64_t &now);
+    bool needsConversion() const;
+    uint64_t historyFileSize() const;
+    static bool rankFuzzy(const ItemList &items, const std::string &query, size_t limit,
+                          const std::vector<uint32_t> *candidates, std::vector<uint32_t> *matched,
+                          const std::function<bool()> &cancelled, std::vector<SearchHit> &out);
+    friend class SearchSession;   // reuses snapshots and rankFuzzy between keystrokes
+
+    std::vector<std::string> listSegments() const;   // segment paths without extension, oldest first
+    bool writeSegment(const std::string &base, const ItemList &oldestFirst) const;
+    std::shared_ptr<const BloomFilter> segmentFilter(const std::string &base);
+
     std::optional<HistoryItem> loadLastDeleted();
+    bool writeSlot(int slot, const std::string *text);   // null removes it; caller holds the locks
 };
 
 #endif // HISTORY_MANAGER_H
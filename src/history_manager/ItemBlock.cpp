@@ -0,0 +1,152 @@
+#include "ItemBlock.h"
+#include "BlobStore.h"
+#include "HistoryManager.h"
+#include "../search/TextFold.h"
+#include <algorithm>
+#include <cstring>
+
+// Arena chunks start small, so a batch that adds one clip doesn't hold on to
+// a large buffer, and double up to kMaxChunk. Contents of kAdoptBytes or more
+// get a chunk of their own.
+static const size_t kFirstChunk = 1024;
+static const size_t kMaxChunk = 1024 * 1024;
+static const size_t kAdoptBytes = 64 * 1024;
+
+std::string_view ItemBlock::Record::blobView() const {
+    return blob ? std::string_view(blob, BlobStore::kNameLength) : std::string_view();
+}
+
+ItemBlock::ItemBlock() {
+    m_names.emplace_back();
+}
+
+const std::string &ItemBlock::adopt(std::string &&chunk) {
+    m_bytes += chunk.size();
+    m_chunks.push_back(std::move(chunk));
+    return m_chunks.back();
+}
+
+const char *ItemBlock::copy(const char *data, size_t n) {
+    if (n >= kAdoptBytes) return adopt(std::string(data, n)).data();
+    if (!m_open || m_open->capacity() - m_open->size() < n) {
+        size_t capacity = m_open ? std::min(m_open->capacity() * 2, kMaxChunk) : kFirstChunk;
+        m_chunks.emplace_back();
+        m_open = &m_chunks.back();
+        m_open->reserve(std::max(capacity, n));
+    }
+    // Within the reserved capacity, so earlier bytes never move.
+    size_t at = m_open->size();
+    m_open->append(data, n);
+    m_bytes += n;
+    return m_open->data() + at;
+}
+
+uint32_t ItemBlock::intern(std::string_view name) {
+    auto found = std::find(m_names.begin(), m_names.end(), name);
+    if (found != m_names.end()) return static_cast<uint32_t>(found - m_names.begin());
+    m_names.emplace_back(name);
+    return static_cast<uint32_t>(m_names.size() - 1);
+}
+
+void ItemBlock::previewRange(const char *text, size_t size, size_t maxBytes, size_t &begin, size_t &length) {
+    begin = 0;
+    while (begin < size && (text[begin] == ' ' || text[begin] == '\t' || text[begin] == '\r' || text[begin] == '\n')) {
+        begin++;
+    }
+    // Only the first maxBytes of the line matter; don't scan a huge payload
+    // looking for its first newline.
+    size_t limit = std::min(size, begin + maxBytes + 1);
+    size_t end = begin;
+    while (end < limit && text[end] != '\r' && text[end] != '\n') end++;
+    while (end > begin && (text[end - 1] == ' ' || text[end - 1] == '\t')) end--;
+    if (end - begin > maxBytes) {
+        end = begin + maxBytes;
+        // don't cut a multi-byte character in half
+        while (end > begin && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) end--;
+    }
+    length = end - begin;
+}
+
+size_t ItemBlock::add(const Fields &fields, const char *content, size_t size) {
+    Record r;
+    r.time = fields.time;
+    r.content = content;
+    r.size = size;
+    r.source = fields.source.empty() ? 0 : intern(fields.source);
+    r.mime = fields.mime.empty() ? 0 : intern(fields.mime);
+    r.type = itemTypeOf(fields.mime);
+    if (!content || !r.isText()) {
+        // Opaque bytes: no lines, preview or search key.
+        if (fields.blob.size() == BlobStore::kNameLength) r.blob = copy(fields.blob.data(), fields.blob.size());
+        m_records.push_back(r);
+        return m_records.size() - 1;
+    }
+    size_t lineCount = fields.lineCount;
+    if (lineCount == kCountLines) {
+        lineCount = size == 0 ? 0 : 1 + std::count(content, content + size, '\n');
+    }
+    r.lineCount = static_cast<uint32_t>(std::min<size_t>(lineCount, UINT32_MAX));
+    size_t begin, length;
+    previewRange(content, size, HistoryManager::kPreviewMaxBytes, begin, length);
+    r.previewOffset = static_cast<uint32_t>(begin);
+    r.previewLength = static_cast<uint32_t>(length);
+    if (!text_fold::isOwnKey(content, size)) {
+        m_scratch.clear();
+        text_fold::appendSearchKey(content, size, m_scratch);
+        if (m_scratch.size() != size || std::memcmp(m_scratch.data(), content, size) != 0) {
+            r.keySize = m_scratch.size();
+            // A large key becomes a chunk itself rather than a copy (and the
+            // block doesn't keep a large scratch buffer).
+            if (m_scratch.size() >= kAdoptBytes) {
+                r.key = adopt(std::move(m_scratch)).data();
+                m_scratch = std::string();
+            } else {
+                r.key = copy(m_scratch.data(), m_scratch.size());
+            }
+        }
+    }
+    m_records.push_back(r);
+    return m_records.size() - 1;
+}
+
+size_t ItemBlock::add(HistoryItem &&item) {
+    Fields fields;
+    fields.time = item.time;
+    fields.source = item.source;
+    fields.mime = item.mime;
+    if (!item.blob.empty()) {
+        fields.blob = item.blob;
+        return add(fields, nullptr, item.size);
+    }
+    const size_t size = item.content.size();
+    const char *content = size >= kAdoptBytes ? adopt(std::move(item.content)).data()
+                                              : copy(item.content.data(), size);
+    return add(fields, content, size);
+}
+
+size_t ItemBlock::add(const ItemBlock &from, size_t index) {
+    const Record &src = from[index];
+    Record r = src;
+    if (src.content) r.content = copy(src.content, static_cast<size_t>(src.size));
+    if (src.key) r.key = copy(src.key, static_cast<size_t>(src.keySize));
+    if (src.blob) r.blob = copy(src.blob, BlobStore::kNameLength);
+    r.source = src.source == 0 ? 0 : intern(from.source(src));
+    r.mime = src.mime == 0 ? 0 : intern(from.mime(src));
+    m_records.push_back(r);
+    return m_records.size() - 1;
+}
+
+HistoryItem ItemBlock::item(size_t index, bool pinned) const {
+    const Record &r = m_records[index];
+    HistoryItem it;
+    it.time = r.time;
+    it.content = r.contentView();
+    it.pinned = pinned;
+    it.source = m_names[r.source];
+    it.mime = m_names[r.mime];
+    it.blob = r.blobView();
+    it.preview = r.previewView();
+    it.lineCount = r.lineCount;
+    it.size = static_cast<size_t>(r.size);
+    return it;
+}
@@ -0,0 +1,105 @@
+#ifndef ITEM_BLOCK_H
+#define ITEM_BLOCK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../../include/Item.h"
+
+struct HistoryItem;
+
+// History items without a heap allocation per item. The items of a block are
+// fixed-size records; their contents and search keys sit back to back in a
+// few large arena chunks owned by the block. A history file is read into a
+// single chunk and its records point straight into it.
+//
+// A block is filled by one writer (a load or a batch) and never changes once
+// it is published, so any number of snapshots can share its records. It is
+// freed with the last snapshot that holds it.
+class ItemBlock {
+public:
+    struct Record {
+        int64_t time = 0;
+        const char *content = nullptr;   // inline payload; null when it is in a blob
+        uint64_t size = 0;               // payload bytes, inline or in the blob
+        const char *key = nullptr;       // text_fold search key; null when content is its own key
+        uint64_t keySize = 0;
+        const char *blob = nullptr;      // BlobStore name (kNameLength chars) of a blob payload
+        uint32_t lineCount = 0;
+        uint32_t previewOffset = 0;      // preview is content[previewOffset, +previewLength)
+        uint32_t previewLength = 0;
+        uint32_t source = 0;             // index into the block's names; 0 = none
+        uint32_t mime = 0;               // index into the block's names; 0 = text/plain
+        ItemType type = ItemType::Text;
+
+        // Only textual payloads have a search key, a preview and lines.
+        bool isText() const { return isTextual(type); }
+        std::string_view contentView() const {
+            return content ? std::string_view(content, static_cast<size_t>(size)) : std::string_view();
+        }
+        std::string_view keyView() const {
+            if (!isText()) return std::string_view();
+            return key ? std::string_view(key, static_cast<size_t>(keySize)) : contentView();
+        }
+        std::string_view previewView() const {
+            return content ? std::string_view(content + previewOffset, previewLength) : std::string_view();
+        }
+        std::string_view blobView() const;
+    };
+
+    static constexpr size_t kCountLines = SIZE_MAX;
+
+    // What add() needs to know besides the payload. An empty mime is plain
+    // text; a non-empty blob names a payload of `size` bytes in the BlobStore.
+    struct Fields {
+        int64_t time = 0;
+        std::string_view source;
+        std::string_view mime;
+        std::string_view blob;
+        size_t lineCount = kCountLines;   // counted when unknown
+    };
+
+    ItemBlock();
+
+    size_t size() const { return m_records.size(); }
+    size_t bytes() const { return m_bytes; }   // arena bytes in use
+    const Record &operator[](size_t index) const { return m_records[index]; }
+    const std::string &source(const Record &r) const { return m_names[r.source]; }
+    const std::string &mime(const Record &r) const { return m_names[r.mime]; }
+    HistoryItem item(size_t index, bool pinned) const;
+
+    // Appends a record for content that is already in the arena (see adopt
+    // and copy), or for a blob of size bytes when content is null, and
+    // derives the preview and search key of a textual payload.
+    size_t add(const Fields &fields, const char *content, size_t size);
+    // Appends item. A large content string is adopted as a chunk of its own,
+    // anything smaller is copied into the arena.
+    size_t add(HistoryItem &&item);
+    // Appends a copy of another block's record, strings included.
+    size_t add(const ItemBlock &from, size_t index);
+
+    // Takes over chunk; its bytes stay where they are for the block's lifetime.
+    const std::string &adopt(std::string &&chunk);
+    // Copies n bytes into the arena and returns where they went.
+    const char *copy(const char *data, size_t n);
+
+    // [begin, begin + length) of text's preview: its first non-blank line,
+    // trimmed and cut to maxBytes on a UTF-8 character boundary.
+    static void previewRange(const char *text, size_t size, size_t maxBytes, size_t &begin, size_t &length);
+
+private:
+    std::vector<Record> m_records;
+    // A deque, so that chunks (adopted short strings included) never move.
+    std::deque<std::string> m_chunks;
+    std::string *m_open = nullptr;       // chunk copy() is filling
+    size_t m_bytes = 0;
+    std::vector<std::string> m_names;    // distinct sources and MIME types, "" first
+    std::string m_scratch;               // search key being built
+
+    uint32_t intern(std::string_view name);
+};
+
+#endif // ITEM_BLOCK_H
@@ -0,0 +1,177 @@
+#include "Journal.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+// First line of journal.txt. Then "CURSOR: <n>" and one op per line, its
+// fields separated by tabs:
+//   DELETE <time> <pinned> <j|b> <payload> <size> <mime> <source>
+//   PIN <time> <payload>  /  UNPIN <time> <payload>
+//   SLOT <slot> <before> <beforeSize> <after> <afterSize>
+static const char *kJournalHeader = "=== JOURNAL ===";
+
+uint64_t JournalOp::bytes() const {
+    if (kind == Delete) return inBlobs ? 0 : size;
+    if (kind == Slot) return beforeSize + afterSize;
+    return 0;
+}
+
+Journal::Journal(const std::string &dir)
+    : m_path((fs::path(dir) / "journal.txt").string()),
+      m_payloadDir((fs::path(dir) / "payloads").string()),
+      m_payloads(m_payloadDir) {}
+
+static std::vector<std::string> splitTabs(const std::string &line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        if (tab == std::string::npos) return fields;
+        start = tab + 1;
+    }
+}
+
+// Free text goes on one tab-separated line.
+static std::string field(std::string text) {
+    for (char &c : text) {
+        if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+    }
+    return text;
+}
+
+bool Journal::load() {
+    m_ops.clear();
+    m_cursor = 0;
+    std::ifstream in(m_path);
+    if (!in.is_open()) return true;
+
+    std::string line;
+    if (!std::getline(in, line) || line != kJournalHeader) return false;
+    size_t cursor = 0;
+    while (std::getline(in, line)) {
+        if (line.rfind("CURSOR: ", 0) == 0) {
+            cursor = std::strtoull(line.c_str() + 8, nullptr, 10);
+            continue;
+        }
+        auto f = splitTabs(line);
+        JournalOp op;
+        if (f[0] == "DELETE" && f.size() == 8) {
+            op.kind = JournalOp::Delete;
+            op.time = std::strtoll(f[1].c_str(), nullptr, 10);
+            op.pinned = f[2] == "1";
+            op.inBlobs = f[3] == "b";
+            op.payload = f[4];
+            op.size = std::strtoull(f[5].c_str(), nullptr, 10);
+            op.mime = f[6];
+            op.source = f[7];
+        } else if ((f[0] == "PIN" || f[0] == "UNPIN") && f.size() == 3) {
+            op.kind = f[0] == "PIN" ? JournalOp::Pin : JournalOp::Unpin;
+            op.time = std::strtoll(f[1].c_str(), nullptr, 10);
+            op.payload = f[2];
+        } else if (f[0] == "SLOT" && f.size() == 6) {
+            op.kind = JournalOp::Slot;
+            op.slot = std::atoi(f[1].c_str());
+            op.before = f[2];
+            op.beforeSize = std::strtoull(f[3].c_str(), nullptr, 10);
+            op.after = f[4];
+            op.afterSize = std::strtoull(f[5].c_str(), nullptr, 10);
+        } else {
+            continue;   // written by a newer version, or damaged
+        }
+        m_ops.push_back(std::move(op));
+    }
+    m_cursor = std::min(cursor, m_ops.size());
+    return true;
+}
+
+bool Journal::save() {
+    std::error_code ec;
+    fs::create_directories(fs::path(m_path).parent_path(), ec);
+    auto tmpPath = m_path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::trunc);
+        if (!out.is_open()) return false;
+        out << kJournalHeader << "\n";
+        out << "CURSOR: " << m_cursor << "\n";
+        for (const auto &op : m_ops) {
+            switch (op.kind) {
+            case JournalOp::Delete:
+                out << "DELETE\t" << op.time << "\t" << (op.pinned ? "1" : "0") << "\t" << (op.inBlobs ? "b" : "j")
+                    << "\t" << op.payload << "\t" << op.size << "\t" << field(op.mime) << "\t" << field(op.source);
+                break;
+            case JournalOp::Pin:
+            case JournalOp::Unpin:
+                out << (op.kind == JournalOp::Pin ? "PIN\t" : "UNPIN\t") << op.time << "\t" << op.payload;
+                break;
+            case JournalOp::Slot:
+                out << "SLOT\t" << op.slot << "\t" << op.before << "\t" << op.beforeSize << "\t" << op.after << "\t"
+                    << op.afterSize;
+                break;
+            }
+            out << "\n";
+        }
+        out.flush();
+        if (!out) return false;
+    }
+    fs::rename(tmpPath, m_path, ec);
+    if (ec) return false;
+
+    std::unordered_set<std::string> used;
+    for (const auto &op : m_ops) {
+        if (op.kind == JournalOp::Delete && !op.inBlobs) used.insert(op.payload);
+        if (op.kind == JournalOp::Slot) {
+            used.insert(op.before);
+            used.insert(op.after);
+        }
+    }
+    for (fs::directory_iterator it(m_payloadDir, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (name.size() != BlobStore::kNameLength || used.count(name)) continue;   // skips temp files too
+        std::error_code removeEc;
+        fs::remove(it->path(), removeEc);
+    }
+    return true;
+}
+
+void Journal::record(JournalOp op) {
+    m_ops.resize(m_cursor);
+    m_ops.push_back(std::move(op));
+    m_cursor = m_ops.size();
+    trim();
+}
+
+void Journal::trim() {
+    uint64_t bytes = 0;
+    for (const auto &op : m_ops) bytes += op.bytes();
+    size_t drop = 0;
+    // The newest op is always kept, however large.
+    while (drop + 1 < m_ops.size() && (m_ops.size() - drop > kMaxOps || bytes > kMaxBytes)) {
+        bytes -= m_ops[drop].bytes();
+        drop++;
+    }
+    m_ops.erase(m_ops.begin(), m_ops.begin() + drop);
+    m_cursor -= std::min(m_cursor, drop);
+}
+
+void Journal::dropLastDone() {
+    if (m_cursor == 0) return;
+    m_ops.erase(m_ops.begin() + (m_cursor - 1));
+    m_cursor--;
+}
+
+void Journal::dropNextUndone() {
+    if (m_cursor < m_ops.size()) m_ops.erase(m_ops.begin() + m_cursor);
+}
+
+bool Journal::read(const std::string &name, std::string &out) const {
+    std::ostringstream buffer;
+    if (!m_payloads.get(name, buffer)) return false;
+    out = buffer.str();
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BlobStore.h"
+
+// One undoable change. An item is identified by its time and the BlobStore
+// name of its payload (the hash of its bytes), so ops refer to content
+// instead of holding it; payloads that leave the history or a slot are kept
+// once each in the journal's own store.
+struct JournalOp {
+    enum Kind : uint8_t { Delete, Pin, Unpin, Slot };
+    Kind kind = Delete;
+
+    // Delete, Pin, Unpin: the item.
+    int64_t time = 0;
+    std::string payload;        // name in the journal's store, or in data/blobs when inBlobs
+    bool inBlobs = false;       // a blob item's payload stays in the history's blob store
+    // Delete: what else it takes to put the item back.
+    uint64_t size = 0;
+    bool pinned = false;
+    std::string mime;
+    std::string source;
+
+    // Slot: slot contents before and after the write, by name in the
+    // journal's store; "" when the slot had nothing saved.
+    int slot = 0;
+    std::string before;
+    uint64_t beforeSize = 0;
+    std::string after;
+    uint64_t afterSize = 0;
+
+    uint64_t bytes() const;     // of the journal's store this op holds on to
+};
+
+// Bounded undo/redo log under data/journal/: ops oldest first in
+// journal.txt and the payloads they refer to in payloads/. Ops before the
+// cursor are done and can be undone, latest first; ops from the cursor on
+// were undone and can be redone until a new op is recorded. The oldest ops
+// are dropped beyond kMaxOps or kMaxBytes of payloads.
+//
+// Not thread-safe: it is loaded, changed and saved by one writer under the
+// data directory's lock.
+class Journal {
+public:
+    static constexpr size_t kMaxOps = 100;
+    static constexpr uint64_t kMaxBytes = 64ull * 1024 * 1024;
+
+    explicit Journal(const std::string &dir);
+
+    bool load();                // a missing journal is an empty one
+    // Writes journal.txt through a temp file, then deletes payloads no op
+    // refers to any more.
+    bool save();
+
+    void record(JournalOp op);  // forgets the undone ops
+    const JournalOp *lastDone() const { return m_cursor > 0 ? &m_ops[m_cursor - 1] : nullptr; }
+    const JournalOp *nextUndone() const { return m_cursor < m_ops.size() ? &m_ops[m_cursor] : nullptr; }
+    void stepBack() { if (m_cursor > 0) m_cursor--; }
+    void stepForward() { if (m_cursor < m_ops.size()) m_cursor++; }
+    void dropLastDone();        // an op that can no longer be applied
+    void dropNextUndone();
+
+    // Copies a payload into the journal's store and names it.
+    bool keep(const char *data, size_t size, std::string &name) { return m_payloads.put(data, size, name); }
+    bool read(const std::string &name, std::string &out) const;
+
+private:
+    std::string m_path;
+    std::string m_payloadDir;
+    BlobStore m_payloads;
+    std::vector<JournalOp> m_ops;   // oldest first
+    size_t m_cursor = 0;
+
+    void trim();
+};
+
+#endif // JOURNAL_H
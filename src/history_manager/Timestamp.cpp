@@ -0,0 +1,111 @@
+#include "Timestamp.h"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <limits>
+
+namespace timestamp {
+
+static const int64_t kMicros = 1000000;
+
+int64_t nowMicros() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+static int64_t floorDiv(int64_t a, int64_t b) {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+static void localTime(std::time_t t, std::tm &tm) {
+#ifdef _WIN32
+    localtime_s(&tm, &t);   // std::localtime shares a static buffer between threads
+#else
+    localtime_r(&t, &tm);
+#endif
+}
+
+namespace {
+struct MinuteCache {
+    int64_t start = std::numeric_limits<int64_t>::min();   // epoch second the minute starts at
+    char prefix[24];                                        // "YYYY-MM-DD HH:MM:"
+    int length = 0;
+};
+thread_local MinuteCache t_minute;
+
+// Wall-clock minute (local, as counted from 1970-01-01 00:00) -> its epoch
+// second, for parse().
+struct ParseCache {
+    int64_t wallMinute = std::numeric_limits<int64_t>::min();
+    int64_t epoch = 0;
+};
+thread_local ParseCache t_parsed;
+} // namespace
+
+void appendFormatted(int64_t micros, std::string &out) {
+    const int64_t seconds = floorDiv(micros, kMicros);
+    const int64_t minute = floorDiv(seconds, 60) * 60;
+    MinuteCache &cache = t_minute;
+    if (minute != cache.start) {
+        std::tm tm{};
+        localTime(static_cast<std::time_t>(minute), tm);
+        cache.length = std::snprintf(cache.prefix, sizeof(cache.prefix), "%04d-%02d-%02d %02d:%02d:",
+                                     tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min);
+        cache.start = minute;
+    }
+    const int second = static_cast<int>(seconds - minute);
+    out.append(cache.prefix, cache.length);
+    out += static_cast<char>('0' + second / 10);
+    out += static_cast<char>('0' + second % 10);
+}
+
+// Days from 1970-01-01 to a proleptic Gregorian date.
+static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+bool parse(const std::string &text, int64_t &micros) {
+    const char *p = text.c_str();
+    auto digits = [&](size_t at, size_t n, int &out) {
+        out = 0;
+        for (size_t i = at; i < at + n; ++i) {
+            if (p[i] < '0' || p[i] > '9') return false;
+            out = out * 10 + (p[i] - '0');
+        }
+        return true;
+    };
+    int year, month, day, hour, minute, second;
+    if (text.size() < 19 || p[4] != '-' || p[7] != '-' || (p[10] != ' ' && p[10] != 'T') ||
+        p[13] != ':' || p[16] != ':' ||
+        !digits(0, 4, year) || !digits(5, 2, month) || !digits(8, 2, day) ||
+        !digits(11, 2, hour) || !digits(14, 2, minute) || !digits(17, 2, second) ||
+        month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+    // Old files hold long runs of items from the same minute; mktime (a time
+    // zone lookup) runs once per minute.
+    const int64_t wallMinute = (daysFromCivil(year, month, day) * 24 + hour) * 60 + minute;
+    ParseCache &cache = t_parsed;
+    if (wallMinute != cache.wallMinute) {
+        std::tm tm{};
+        tm.tm_year = year - 1900;
+        tm.tm_mon = month - 1;
+        tm.tm_mday = day;
+        tm.tm_hour = hour;
+        tm.tm_min = minute;
+        tm.tm_isdst = -1;
+        std::time_t t = std::mktime(&tm);
+        if (t == static_cast<std::time_t>(-1)) return false;
+        cache.wallMinute = wallMinute;
+        cache.epoch = static_cast<int64_t>(t);
+    }
+    micros = (cache.epoch + second) * kMicros;
+    return true;
+}
+
+} // namespace timestamp
@@ -0,0 +1,32 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <cstdint>
+#include <string>
+
+// Item times are int64 microseconds since the Unix epoch (UTC), so storing,
+// ordering and range-checking them are plain integer operations. They are
+// turned into local "YYYY-MM-DD HH:MM:SS" text only where they are shown.
+namespace timestamp {
+
+int64_t nowMicros();
+
+// Appends the local time of micros as "YYYY-MM-DD HH:MM:SS". Each thread
+// keeps the last minute it converted, so formatting a list of items costs one
+// time zone lookup per distinct minute instead of one per item.
+void appendFormatted(int64_t micros, std::string &out);
+
+inline std::string format(int64_t micros) {
+    std::string text;
+    appendFormatted(micros, text);
+    return text;
+}
+
+// Reads local "YYYY-MM-DD HH:MM:SS" (or with a 'T' separator), the format
+// history files used before times were stored as integers. False if text
+// isn't in that form.
+bool parse(const std::string &text, int64_t &micros);
+
+} // namespace timestamp
+
+#endif // TIMESTAMP_H
@@ -0,0 +1,235 @@
+#include "Exporter.h"
+#include "../history_manager/Timestamp.h"
+#include <functional>
+#include <ostream>
+#include <streambuf>
+
+// The encode buffer is written out once it grows past this.
+static const size_t kWriteChunk = 1024 * 1024;
+
+Exporter::Exporter(HistoryManager &history) : m_history(history) {}
+
+bool Exporter::parseFormat(const std::string &name, Format &format) {
+    if (name == "jsonl") format = Format::Jsonl;
+    else if (name == "json") format = Format::Json;
+    else if (name == "raw") format = Format::Raw;
+    else return false;
+    return true;
+}
+
+bool Exporter::run(std::ostream &out, Format format) {
+    m_out = &out;
+    m_buffer.clear();
+    m_buffer.reserve(kWriteChunk + 64 * 1024);
+    m_exported = 0;
+    m_error.clear();
+
+    if (format == Format::Json) m_buffer += "[";
+    bool ok = m_history.exportHistory([&](const HistoryItem &it) {
+        if (format == Format::Raw && !isTextual(it.type())) return true;
+        if (!writeRecord(it, format)) return false;
+        m_exported++;
+        return m_buffer.size() < kWriteChunk || drain();
+    });
+    if (!ok && m_error.empty()) m_error = "could not read the history, or it was rewritten during the export";
+    if (format == Format::Json) m_buffer += m_exported ? "\n]\n" : "]\n";
+    ok = drain() && ok;
+    m_out->flush();
+    if (!*m_out && m_error.empty()) m_error = "could not write the export";
+    return ok && static_cast<bool>(*m_out);
+}
+
+bool Exporter::drain() {
+    if (!m_buffer.empty()) {
+        m_out->write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+        m_buffer.clear();
+    }
+    if (!*m_out) {
+        m_error = "could not write the export";
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+// Output stream buffer that hands every write straight to a consumer, so a
+// blob is encoded as BlobStore reads it instead of being collected first.
+class ForwardingBuf : public std::streambuf {
+public:
+    explicit ForwardingBuf(std::function<bool(const char*, size_t)> consume) : m_consume(std::move(consume)) {}
+
+protected:
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        return m_consume(s, static_cast<size_t>(n)) ? n : 0;
+    }
+    int_type overflow(int_type c) override {
+        if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+        const char ch = traits_type::to_char_type(c);
+        return m_consume(&ch, 1) ? c : traits_type::eof();
+    }
+
+private:
+    std::function<bool(const char*, size_t)> m_consume;
+};
+
+} // namespace
+
+bool Exporter::writeRecord(const HistoryItem &it, Format format) {
+    if (format == Format::Raw) {
+        m_buffer += it.content;
+        m_buffer += '\0';
+        return true;
+    }
+    if (format == Format::Json) m_buffer += m_exported ? ",\n" : "\n";
+    // time is exact (microseconds since the epoch); timestamp is for people
+    m_buffer += "{\"time\":";
+    m_buffer += std::to_string(it.time);
+    m_buffer += ",\"timestamp\":\"";
+    timestamp::appendFormatted(it.time, m_buffer);
+    m_buffer += '"';
+    m_buffer += it.pinned ? ",\"pinned\":true" : ",\"pinned\":false";
+    if (!it.source.empty()) {
+        m_buffer += ",\"source\":";
+        appendJsonString(it.source);
+    }
+    if (isTextual(it.type())) {
+        if (!it.mime.empty()) {
+            m_buffer += ",\"mime\":";
+            appendJsonString(it.mime);
+        }
+        m_buffer += ",\"content\":";
+        appendJsonString(it.content);
+    } else {
+        // Bytes that are not text would not survive a JSON string.
+        m_buffer += ",\"mime\":";
+        appendJsonString(it.mime);
+        m_buffer += ",\"content_base64\":\"";
+        if (it.blob.empty()) {
+            appendBase64(it.content.data(), it.content.size());
+        } else {
+            // Streamed through the encode buffer, which is drained as it fills.
+            ForwardingBuf forward([&](const char *data, size_t size) {
+                appendBase64(data, size);
+                return m_buffer.size() < kWriteChunk || drain();
+            });
+            std::ostream payload(&forward);
+            if (!m_history.readBlob(it.blob, payload)) {
+                if (m_error.empty()) m_error = "could not read blob " + it.blob;
+                return false;
+            }
+        }
+        endBase64();
+        m_buffer += '"';
+    }
+    m_buffer += format == Format::Jsonl ? "}\n" : "}";
+    return true;
+}
+
+static const char kBase64Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void appendGroup(std::string &out, const unsigned char *b) {
+    const uint32_t v = uint32_t(b[0]) << 16 | uint32_t(b[1]) << 8 | b[2];
+    out += kBase64Digits[v >> 18];
+    out += kBase64Digits[(v >> 12) & 63];
+    out += kBase64Digits[(v >> 6) & 63];
+    out += kBase64Digits[v & 63];
+}
+
+// Whole 3-byte groups are encoded as they arrive; the 0-2 bytes after the
+// last one are carried over to the next piece, or padded by endBase64().
+void Exporter::appendBase64(const char *data, size_t size) {
+    const auto *p = reinterpret_cast<const unsigned char*>(data);
+    if (m_carried > 0) {
+        while (m_carried < 3 && size > 0) {
+            m_carry[m_carried++] = *p++;
+            size--;
+        }
+        if (m_carried < 3) return;
+        appendGroup(m_buffer, m_carry);
+        m_carried = 0;
+    }
+    for (; size >= 3; p += 3, size -= 3) appendGroup(m_buffer, p);
+    for (size_t i = 0; i < size; ++i) m_carry[i] = p[i];
+    m_carried = size;
+}
+
+void Exporter::endBase64() {
+    if (m_carried > 0) {
+        const uint32_t v = uint32_t(m_carry[0]) << 16 | (m_carried > 1 ? uint32_t(m_carry[1]) << 8 : 0);
+        m_buffer += kBase64Digits[v >> 18];
+        m_buffer += kBase64Digits[(v >> 12) & 63];
+        m_buffer += m_carried > 1 ? kBase64Digits[(v >> 6) & 63] : '=';
+        m_buffer += '=';
+    }
+    m_carried = 0;
+}
+
+// Length of the well-formed UTF-8 sequence starting at s[i], or 0.
+static size_t utf8SequenceLength(const std::string &s, size_t i) {
+    unsigned char c = static_cast<unsigned char>(s[i]);
+    size_t len;
+    unsigned char lo = 0x80, hi = 0xBF;   // allowed range of the second byte
+    if (c >= 0xC2 && c <= 0xDF) len = 2;
+    else if (c >= 0xE0 && c <= 0xEF) {
+        len = 3;
+        if (c == 0xE0) lo = 0xA0;         // overlong
+        if (c == 0xED) hi = 0x9F;         // surrogates
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        len = 4;
+        if (c == 0xF0) lo = 0x90;
+        if (c == 0xF4) hi = 0x8F;         // beyond U+10FFFF
+    } else {
+        return 0;
+    }
+    if (i + len > s.size()) return 0;
+    unsigned char c1 = static_cast<unsigned char>(s[i + 1]);
+    if (c1 < lo || c1 > hi) return 0;
+    for (size_t k = 2; k < len; ++k) {
+        if ((static_cast<unsigned char>(s[i + k]) & 0xC0) != 0x80) return 0;
+    }
+    return len;
+}
+
+// Quotes and escapes text. Runs of plain bytes are copied in one append;
+// bytes that are not valid UTF-8 become U+FFFD so the output always parses.
+void Exporter::appendJsonString(const std::string &text) {
+    static const char hex[] = "0123456789abcdef";
+    m_buffer += '"';
+    size_t run = 0, i = 0;
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\' && c < 0x80) {
+            i++;
+            continue;
+        }
+        if (c >= 0x80) {
+            size_t len = utf8SequenceLength(text, i);
+            if (len) {
+                i += len;
+                continue;
+            }
+        }
+        m_buffer.append(text, run, i - run);
+        switch (c) {
+            case '"':  m_buffer += "\\\""; break;
+            case '\\': m_buffer += "\\\\"; break;
+            case '\n': m_buffer += "\\n"; break;
+            case '\r': m_buffer += "\\r"; break;
+            case '\t': m_buffer += "\\t"; break;
+            case '\b': m_buffer += "\\b"; break;
+            case '\f': m_buffer += "\\f"; break;
+            default:
+                if (c >= 0x80) {
+                    m_buffer += "\\ufffd";
+                } else {
+                    m_buffer += "\\u00";
+                    m_buffer += hex[c >> 4];
+                    m_buffer += hex[c & 0xF];
+                }
+        }
+        run = ++i;
+    }
+    m_buffer.append(text, run, text.size() - run);
+    m_buffer += '"';
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "../history_manager/HistoryManager.h"
+#include <ostream>
+#include <string>
+
+// Streams the stored history out of HistoryManager for backup or for other
+// tools. Records are visited oldest first straight from history.txt and
+// encoded into a fixed-size buffer that is flushed whenever it fills, so
+// memory use does not grow with the history. Every format can be read back
+// by Importer with the same order.
+class Exporter {
+public:
+    enum class Format {
+        Jsonl,   // one {"time", "timestamp", "pinned", "source", "content"} object per line;
+                 // binary items carry "mime" and "content_base64" instead of "content"
+        Json,    // a single array of those objects
+        Raw      // contents of textual items only, each followed by '\0'
+    };
+
+    explicit Exporter(HistoryManager &history);
+
+    bool run(std::ostream &out, Format format);
+    static bool parseFormat(const std::string &name, Format &format);
+
+    size_t exported() const { return m_exported; }
+    const std::string &error() const { return m_error; }
+
+private:
+    HistoryManager &m_history;
+    std::ostream *m_out = nullptr;
+    std::string m_buffer;
+    size_t m_exported = 0;
+    std::string m_error;
+
+    bool writeRecord(const HistoryItem &it, Format format);
+    void appendJsonString(const std::string &text);
+    // Base64 of a payload handed over in pieces; see appendBase64.
+    void appendBase64(const char *data, size_t size);
+    void endBase64();
+    unsigned char m_carry[3];
+    size_t m_carried = 0;
+    bool drain();   // write the buffer out
+};
@@ -0,0 +1,289 @@
+#include "Importer.h"
+#include "../history_manager/Timestamp.h"
+#include "../../include/nlohmann/json.hpp"
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <memory>
+
+// Pending records are committed once either limit is reached.
+static const size_t kBatchBytes = 8 * 1024 * 1024;
+static const size_t kBatchItems = 20000;
+static const size_t kReadChunk = 1024 * 1024;
+
+Importer::Importer(HistoryManager &history) : m_history(history) {}
+
+bool Importer::parseFormat(const std::string &name, Format &format) {
+    if (name == "json") format = Format::Json;
+    else if (name == "jsonl") format = Format::Jsonl;
+    else if (name == "lines") format = Format::Lines;
+    else if (name == "nul") format = Format::Nul;
+    else return false;
+    return true;
+}
+
+bool Importer::run(std::istream &in, Format format) {
+    bool ok;
+    switch (format) {
+        case Format::Json:  ok = importJson(in, false); break;
+        case Format::Jsonl: ok = importJson(in, true); break;
+        case Format::Lines: ok = importDelimited(in, '\n'); break;
+        default:            ok = importDelimited(in, '\0'); break;
+    }
+    // Whatever parsed cleanly before an error is kept.
+    return flush() && ok;
+}
+
+bool Importer::push(HistoryItem &&item) {
+    if (item.content.empty()) return true;
+    // Only what Exporter writes is taken: inline bytes, never a blob name.
+    item.blob.clear();
+    if (item.source.empty()) item.source = "import";
+    m_pendingBytes += item.content.size();
+    m_pending.push_back(std::move(item));
+    if (m_pendingBytes >= kBatchBytes || m_pending.size() >= kBatchItems) return flush();
+    return true;
+}
+
+bool Importer::flush() {
+    if (m_pending.empty()) return true;
+    bool ok = m_history.append(std::move(m_pending));
+    if (ok) {
+        m_imported += m_pending.size();
+    } else if (m_error.empty()) {
+        m_error = "could not write to the history";
+    }
+    m_pending.clear();
+    m_pendingBytes = 0;
+    return ok;
+}
+
+bool Importer::importDelimited(std::istream &in, char delimiter) {
+    std::unique_ptr<char[]> buf(new char[kReadChunk]);
+    std::string record;
+    while (in) {
+        in.read(buf.get(), kReadChunk);
+        size_t got = static_cast<size_t>(in.gcount());
+        size_t start = 0;
+        for (;;) {
+            const void *hit = std::memchr(buf.get() + start, delimiter, got - start);
+            if (!hit) break;
+            size_t end = static_cast<const char*>(hit) - buf.get();
+            record.append(buf.get() + start, end - start);
+            if (delimiter == '\n' && !record.empty() && record.back() == '\r') record.pop_back();
+            HistoryItem it;
+            it.content.swap(record);
+            if (!push(std::move(it))) return false;
+            start = end + 1;
+        }
+        record.append(buf.get() + start, got - start);
+    }
+    if (delimiter == '\n' && !record.empty() && record.back() == '\r') record.pop_back();
+    HistoryItem it;
+    it.content.swap(record);
+    return push(std::move(it));
+}
+
+// Decodes standard base64, skipping anything that is not a base64 digit.
+static void decodeBase64(const std::string &text, std::string &out) {
+    out.clear();
+    out.reserve(text.size() / 4 * 3);
+    uint32_t bits = 0;
+    int count = 0;
+    for (char c : text) {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '+') v = 62;
+        else if (c == '/') v = 63;
+        else continue;
+        bits = bits << 6 | static_cast<uint32_t>(v);
+        if (++count == 4) {
+            out += static_cast<char>(bits >> 16);
+            out += static_cast<char>(bits >> 8);
+            out += static_cast<char>(bits);
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 3) {
+        out += static_cast<char>(bits >> 10);
+        out += static_cast<char>(bits >> 2);
+    } else if (count == 2) {
+        out += static_cast<char>(bits >> 4);
+    }
+}
+
+// SAX handler: records are picked out as they stream past, nothing else is
+// kept. Accepted shapes:
+//   ["text", ...]
+//   [{"content": "text", "time": <us>, "timestamp": "...", "pinned": true, "source": "..."}, ...]
+//   ("text" is accepted for "content"; "time", microseconds since the epoch,
+//   wins over a local "YYYY-MM-DD HH:MM:SS" "timestamp"; binary items have
+//   "mime" and "content_base64")
+//   {"history": [...], "pinned": [...]}   (the extension's clipboard_history.json)
+// With lines, the input is a sequence of top-level values, each one record
+// object or string.
+class JsonImportHandler : public nlohmann::json_sax<nlohmann::json> {
+public:
+    JsonImportHandler(Importer &importer, bool lines) : m_importer(importer), m_lines(lines) {}
+
+    bool null() override { return true; }
+    bool boolean(bool val) override {
+        if (top() == Role::ItemObject && m_key == "pinned") m_item.pinned = val;
+        return true;
+    }
+    bool number_integer(number_integer_t val) override {
+        if (top() == Role::ItemObject && m_key == "time") {
+            m_item.time = val;
+            m_hasTime = true;
+        }
+        return true;
+    }
+    bool number_unsigned(number_unsigned_t val) override {
+        return number_integer(static_cast<number_integer_t>(val));
+    }
+    bool number_float(number_float_t, const string_t&) override { return true; }
+    bool binary(binary_t&) override { return true; }
+
+    bool string(string_t &val) override {
+        if (top() == Role::ItemArray) {
+            HistoryItem it;
+            it.content = std::move(val);
+            it.pinned = m_pinnedArray;
+            return m_importer.push(std::move(it));
+        }
+        if (top() == Role::ItemObject) {
+            if (m_key == "content" || m_key == "text") m_item.content = std::move(val);
+            else if (m_key == "content_base64") decodeBase64(val, m_item.content);
+            else if (m_key == "timestamp" && !m_hasTime) timestamp::parse(val, m_item.time);
+            else if (m_key == "source") m_item.source = std::move(val);
+            else if (m_key == "mime") m_item.mime = std::move(val);
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        if (m_stack.empty() && !m_lines) {
+            m_stack.push_back(Role::RootObject);
+        } else if (top() == Role::ItemArray) {
+            m_item = HistoryItem();
+            m_item.pinned = m_pinnedArray;
+            m_hasTime = false;
+            m_stack.push_back(Role::ItemObject);
+        } else {
+            m_stack.push_back(Role::Ignored);
+        }
+        return true;
+    }
+
+    bool key(string_t &val) override {
+        m_key.swap(val);
+        return true;
+    }
+
+    bool end_object() override {
+        bool ok = true;
+        if (top() == Role::ItemObject) ok = m_importer.push(std::move(m_item));
+        m_stack.pop_back();
+        return ok;
+    }
+
+    bool start_array(std::size_t) override {
+        if (m_stack.empty() && !m_lines) {
+            m_pinnedArray = false;
+            m_stack.push_back(Role::ItemArray);
+        } else if (top() == Role::RootObject && (m_key == "history" || m_key == "pinned")) {
+            m_pinnedArray = (m_key == "pinned");
+            m_stack.push_back(Role::ItemArray);
+        } else {
+            m_stack.push_back(Role::Ignored);
+        }
+        return true;
+    }
+
+    bool end_array() override {
+        m_stack.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception &ex) override {
+        m_importer.m_error = "JSON error at byte " + std::to_string(position) + ": " + ex.what();
+        return false;
+    }
+
+private:
+    enum class Role { RootObject, ItemArray, ItemObject, Ignored };
+    // Between the records of lines, the top level takes items like an array.
+    Role top() const {
+        if (m_stack.empty()) return m_lines ? Role::ItemArray : Role::Ignored;
+        return m_stack.back();
+    }
+
+    Importer &m_importer;
+    const bool m_lines;
+    std::vector<Role> m_stack;
+    std::string m_key;
+    HistoryItem m_item;
+    bool m_hasTime = false;   // m_item has an exact "time"
+    bool m_pinnedArray = false;
+};
+
+// Input iterator over an istream read in kReadChunk blocks. nlohmann's own
+// istream adapter goes through the streambuf one character at a time, which
+// roughly halves parsing throughput. A default-constructed iterator is the
+// end sentinel.
+namespace {
+struct ChunkedInput {
+    std::istream &in;
+    std::unique_ptr<char[]> buf{new char[kReadChunk]};
+    size_t pos = 0;
+    size_t len = 0;
+
+    explicit ChunkedInput(std::istream &stream) : in(stream) {}
+    bool fill() {
+        if (pos < len) return true;
+        in.read(buf.get(), kReadChunk);
+        len = static_cast<size_t>(in.gcount());
+        pos = 0;
+        return len > 0;
+    }
+};
+
+struct ChunkIterator {
+    using iterator_category = std::input_iterator_tag;
+    using value_type = char;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const char*;
+    using reference = const char&;
+
+    ChunkedInput *input = nullptr;
+
+    const char &operator*() const { return input->buf[input->pos]; }
+    ChunkIterator &operator++() { ++input->pos; return *this; }
+    bool atEnd() const { return !input || !input->fill(); }
+    bool operator==(const ChunkIterator &other) const { return atEnd() == other.atEnd(); }
+    bool operator!=(const ChunkIterator &other) const { return !(*this == other); }
+};
+}
+
+bool Importer::importJson(std::istream &in, bool lines) {
+    JsonImportHandler handler(*this, lines);
+    ChunkedInput input(in);
+    bool ok;
+    if (!lines) {
+        ok = nlohmann::json::sax_parse(ChunkIterator{&input}, ChunkIterator{}, &handler);
+    } else {
+        // Not strict: the parser stops right after each value, and the next
+        // one is parsed from there, until only whitespace is left.
+        do {
+            ok = nlohmann::json::sax_parse(ChunkIterator{&input}, ChunkIterator{}, &handler,
+                                           nlohmann::json::input_format_t::json, false);
+            while (ok && input.fill() && std::isspace(static_cast<unsigned char>(input.buf[input.pos])))
+                ++input.pos;
+        } while (ok && !ChunkIterator{&input}.atEnd());
+    }
+    if (!ok && m_error.empty()) m_error = "could not write to the history";
+    return ok;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "../history_manager/HistoryManager.h"
+#include <istream>
+#include <string>
+#include <vector>
+
+// Streams clipboard history from another tool into HistoryManager. Input is
+// consumed in fixed-size chunks and parsed records are appended through
+// HistoryManager::append() every few MB, which neither loads nor keeps the
+// history, so memory use stays at about one pending chunk whatever the size
+// of the input or of the history. Records are taken oldest first:
+// the last record read becomes the newest history item.
+class Importer {
+public:
+    enum class Format {
+        Json,    // SAX-parsed; see importJson for the accepted shapes
+        Jsonl,   // one record object (or string) per line, as Exporter writes
+        Lines,   // one item per line
+        Nul      // items separated by '\0' (may span lines)
+    };
+
+    explicit Importer(HistoryManager &history);
+
+    bool run(std::istream &in, Format format);
+    static bool parseFormat(const std::string &name, Format &format);
+
+    size_t imported() const { return m_imported; }
+    const std::string &error() const { return m_error; }
+
+private:
+    HistoryManager &m_history;
+    std::vector<HistoryItem> m_pending;
+    size_t m_pendingBytes = 0;
+    size_t m_imported = 0;
+    std::string m_error;
+
+    bool importJson(std::istream &in, bool lines);
+    bool importDelimited(std::istream &in, char delimiter);
+
+    friend class JsonImportHandler;
+    bool push(HistoryItem &&item);   // queue one record, committing full chunks
+    bool flush();
+};
@@ -1,102 +1,258 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <windows.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <cstdio>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 #include "cli/CLI.h"
 #include "clipboard_monitor/ClipboardMonitor.h"
 #include "history_manager/HistoryManager.h"
 #include "advanced_features/AdvancedFeatures.h"
+#include "daemon/Daemon.h"
+#include "import_export/Importer.h"
+#include "import_export/Exporter.h"
+
+// Keeps \r\n and ^Z in data piped through stdin/stdout on Windows.
+static void setBinary(FILE *stream) {
+#ifdef _WIN32
+    _setmode(_fileno(stream), _O_BINARY);
+#else
+    (void)stream;
+#endif
+}
+
+// MIME type for add-file from the file name; unknown kinds are opaque bytes.
+static std::string mimeForPath(const std::string &path) {
+    static const struct { const char *extension; const char *mime; } known[] = {
+        {".png", "image/png"}, {".jpg", "image/jpeg"}, {".jpeg", "image/jpeg"}, {".gif", "image/gif"},
+        {".bmp", "image/bmp"}, {".webp", "image/webp"}, {".html", "text/html"}, {".htm", "text/html"},
+        {".rtf", "text/rtf"}, {".txt", "text/plain"}, {".md", "text/plain"}, {".json", "text/plain"}};
+    std::string extension = std::filesystem::path(path).extension().string();
+    for (char &c : extension) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    for (const auto &k : known) {
+        if (extension == k.extension) return k.mime;
+    }
+    return "application/octet-stream";
+}
 
 int main(int argc, char* argv[]) {
     std::string dataDir = "data";  // Folder for storing history and slots
-    HistoryManager history(dataDir);
-    CLI cli(dataDir);
+    std::string socketPath = (std::filesystem::path(dataDir) / "clipboard.sock").string();
 
     if (argc > 1) {
         std::string cmd = argv[1];
         std::vector<std::string> args(argv + 1, argv + argc);
 
-        // ---------- HISTORY COMMAND ----------
-        if (cmd == "history") {
-            auto items = history.readHistory();
-            for (size_t i = 0; i < items.size(); ++i) {
-                std::cout << i << ": [" << items[i].timestamp << "] "
-                          << (items[i].pinned ? "[PINNED] " : "")
-                          << items[i].content << "\n";
+        // ---------- BATCH COMMAND ----------
+        // The script (a file, or stdin for "-" or no argument) travels as a
+        // single argument, so a running daemon can apply it as well.
+        if (cmd == "batch") {
+            std::ostringstream script;
+            if (args.size() >= 2 && args[1] != "-") {
+                std::ifstream in(args[1], std::ios::binary);
+                if (!in.is_open()) {
+                    std::cerr << "Cannot open " << args[1] << "\n";
+                    return 1;
+                }
+                script << in.rdbuf();
+            } else {
+                script << std::cin.rdbuf();
             }
-            return 0;
+            args = { "batch", script.str() };
         }
 
-        // ---------- SEARCH COMMAND ----------
-        else if (cmd == "search" && args.size() >= 2) {
-            std::string query = args[1];
-            auto results = history.search(query);
-            for (const auto& it : results)
-                std::cout << "[" << it.timestamp << "] " << it.content << "\n";
-            return 0;
+        // ---------- DAEMON COMMAND ----------
+        if (cmd == "daemon") {
+            HistoryManager history(dataDir);
+            CLI cli(history);
+            DaemonServer server(socketPath, cli);
+            return server.run() ? 0 : 1;
+        }
+
+        // ---------- HISTORY / SEARCH / PIN / UNPIN / DELETE / UNDO / BATCH / STATS ----------
+        else if (CLI::isCommand(cmd) || cmd == "shutdown") {
+            // Thin client: a running daemon answers from its resident history,
+            // so this process never loads the history file.
+            // Only a daemon that can't be reached hands the command back: once
+            // the request is sent it may have been applied, and running it here
+            // too could delete or undo twice.
+            DaemonClient client(socketPath);
+            if (client.connect()) {
+                std::string output;
+                int status = 0;
+                if (!client.request(args, output, status)) {
+                    std::cerr << "Lost the connection to the daemon; " << cmd << " may or may not have been applied\n";
+                    return 1;
+                }
+                std::cout << output;
+                return status;
+            }
+            if (cmd == "shutdown") return 0;   // no daemon running
+
+            HistoryManager history(dataDir);
+            CLI cli(history);
+            return cli.handleCommand(args, std::cout);
         }
 
-        // ---------- PIN COMMAND ----------
-        else if (cmd == "pin" && args.size() >= 2) {
-            int index = std::stoi(args[1]);
-            history.pinItem(index);
+        // ---------- IMPORT COMMAND ----------
+        // import [--format=json|jsonl|lines|nul] [file|-]
+        // Always runs in this process so the input can be streamed; a running
+        // daemon picks the new items up through the generation counter.
+        else if (cmd == "import") {
+            std::string path = "-";
+            std::string formatName;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i].rfind("--format=", 0) == 0) formatName = args[i].substr(9);
+                else path = args[i];
+            }
+            if (formatName.empty()) {
+                const auto extension = std::filesystem::path(path).extension();
+                formatName = extension == ".json" ? "json" : extension == ".jsonl" ? "jsonl" : "lines";
+            }
+            Importer::Format format;
+            if (!Importer::parseFormat(formatName, format)) {
+                std::cerr << "Unknown import format: " << formatName << "\n";
+                return 1;
+            }
+
+            std::ifstream file;
+            if (path != "-") {
+                file.open(path, std::ios::binary);
+                if (!file.is_open()) {
+                    std::cerr << "Cannot open " << path << "\n";
+                    return 1;
+                }
+            } else {
+                setBinary(stdin);
+            }
+            HistoryManager history(dataDir);
+            Importer importer(history);
+            bool ok = importer.run(path == "-" ? std::cin : file, format);
+            std::cout << "Imported " << importer.imported() << " item(s).\n";
+            if (!ok) {
+                std::cerr << importer.error() << "\n";
+                return 1;
+            }
             return 0;
         }
 
-        // ---------- UNPIN COMMAND ----------
-        else if (cmd == "unpin" && args.size() >= 2) {
-            int index = std::stoi(args[1]);
-            history.unpinItem(index);
+        // ---------- EXPORT COMMAND ----------
+        // export [--format=jsonl|json|raw] [file|-]
+        // Streams history.txt without loading it, so it also runs locally.
+        else if (cmd == "export") {
+            std::string path = "-";
+            std::string formatName;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i].rfind("--format=", 0) == 0) formatName = args[i].substr(9);
+                else path = args[i];
+            }
+            if (formatName.empty()) {
+                formatName = std::filesystem::path(path).extension() == ".json" ? "json" : "jsonl";
+            }
+            Exporter::Format format;
+            if (!Exporter::parseFormat(formatName, format)) {
+                std::cerr << "Unknown export format: " << formatName << "\n";
+                return 1;
+            }
+
+            std::ofstream file;
+            if (path != "-") {
+                file.open(path, std::ios::binary | std::ios::trunc);
+                if (!file.is_open()) {
+                    std::cerr << "Cannot open " << path << "\n";
+                    return 1;
+                }
+            } else {
+                setBinary(stdout);
+            }
+            HistoryManager history(dataDir);
+            Exporter exporter(history);
+            bool ok = exporter.run(path == "-" ? std::cout : file, format);
+            if (!ok) {
+                std::cerr << exporter.error() << "\n";
+                return 1;
+            }
+            if (path != "-") std::cout << "Exported " << exporter.exported() << " item(s).\n";
             return 0;
         }
 
-        // ---------- DELETE COMMAND ----------
-        else if (cmd == "delete" && args.size() >= 2) {
-            int index = std::stoi(args[1]);
-            history.deleteItem(index);
+        // ---------- ADD-FILE COMMAND ----------
+        // add-file [--mime=type] <file>: the file's bytes as one item. Binary
+        // payloads are streamed into the blob store, so this runs in this
+        // process like import.
+        else if (cmd == "add-file" && args.size() >= 2) {
+            std::string path;
+            std::string mime;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i].rfind("--mime=", 0) == 0) mime = args[i].substr(7);
+                else path = args[i];
+            }
+            if (mime.empty()) mime = mimeForPath(path);
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open()) {
+                std::cerr << "Cannot open " << path << "\n";
+                return 1;
+            }
+            HistoryManager history(dataDir);
+            if (!history.addBlob(file, mime, "cli")) {
+                std::cerr << "Could not add " << path << "\n";
+                return 1;
+            }
             return 0;
         }
 
-        // ---------- UNDO COMMAND ----------
-        else if (cmd == "undo") {
-            history.undoDelete();
+        // ---------- SAVE COMMAND ----------
+        // save <index> <file>: writes an item's payload, text or binary, to a file.
+        else if (cmd == "save" && args.size() >= 3) {
+            size_t index = 0;
+            if (!CLI::parseIndex(args[1], index)) {
+                std::cerr << "Usage: save <index> <file>\n";
+                return 1;
+            }
+            std::ofstream file(args[2], std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "Cannot open " << args[2] << "\n";
+                return 1;
+            }
+            HistoryManager history(dataDir);
+            if (!history.readPayload(index, file)) {
+                std::cerr << "No item " << args[1] << "\n";
+                return 1;
+            }
             return 0;
         }
 
         // ---------- COPY COMMAND ----------
         else if (cmd == "copy" && args.size() >= 3) {
-            if (!IsClipboardFormatAvailable(CF_UNICODETEXT))
-                return 4;
-            if (!OpenClipboard(nullptr))
-                return 5;
-
-            std::string value;
-            HGLOBAL hData = GetClipboardData(CF_UNICODETEXT);
-            if (hData) {
-                LPCWSTR pszText = static_cast<LPCWSTR>(GlobalLock(hData));
-                if (pszText) {
-                    int size_needed = WideCharToMultiByte(CP_UTF8, 0, pszText, -1, NULL, 0, NULL, NULL);
-                    std::string buffer(size_needed, '\0');
-                    WideCharToMultiByte(CP_UTF8, 0, pszText, -1, &buffer[0], size_needed, NULL, NULL);
-                    if (!buffer.empty() && buffer.back() == '\0')
-                        buffer.pop_back();
-                    value = buffer;
-                    GlobalUnlock(hData);
-                }
+            size_t slot = 0;
+            if (!CLI::parseIndex(args[2], slot) || slot > 9) {
+                std::cerr << "Invalid slot " << args[2] << " (0-9)\n";
+                return 1;
             }
-            CloseClipboard();
+            std::string value;
+            if (!ClipboardMonitor::readText(value))
+                return 4;
 
-            int slot = std::stoi(args[2]);
-            history.setSlot(slot, value);
-            history.addItem(value);
+            // A running daemon picks this up through the generation counter.
+            HistoryManager history(dataDir);
+            history.setSlot(static_cast<int>(slot), value);
+            history.addItem(std::move(value), "slot");
             return 0;
         }
     }
 
     // --- Interactive mode ---
+    HistoryManager history(dataDir);   // one instance, shared with the CLI and the monitor
+    CLI cli(history);
     ClipboardMonitor monitor;
-    monitor.start([&](const std::string &text) {
-        history.addItem(text);
+    monitor.start([&](std::string &&text) {
+        history.addItem(std::move(text), "clipboard");
     });
 
     cli.runMenu();
@@ -1,8 +1,31 @@
 #include <napi.h>
 #include "../history_manager/HistoryManager.h"
+#include "../history_manager/Timestamp.h"
+#include "../clipboard_monitor/ClipboardMonitor.h"
+#include "../search/SearchSession.h"
+#include "../stats/Stats.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
 
-static std::unique_ptr<HistoryManager> historyManager;
+// Shared with the searchIncremental workers, which keep their own references:
+// init() may replace both while a worker is still searching on a pool thread.
+static std::shared_ptr<HistoryManager> historyManager;
+static std::shared_ptr<SearchSession> searchSession;   // shared by searchIncremental calls
+
+// Native clipboard monitor owned by the addon. Its thread never touches the
+// HistoryManager: clips are queued here and handed to the JS thread through
+// monitorTsfn. Only the clip that finds the queue empty schedules a call, so
+// a burst of copies is delivered (and refreshed in the UI) as one event.
+static std::unique_ptr<ClipboardMonitor> clipboardMonitor;
+static Napi::ThreadSafeFunction monitorTsfn;
+static std::mutex pendingMutex;
+static std::vector<std::string> pendingClips;
+static stats::Gauge &pendingDepth = stats::gauge("addon.monitor_queue");
 
 Napi::Value InitManager(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
@@ -12,7 +35,9 @@ Napi::Value InitManager(const Napi::CallbackInfo& info) {
     }
 
     std::string dataDir = info[0].As<Napi::String>().Utf8Value();
-    historyManager = std::make_unique<HistoryManager>(dataDir);
+    if (searchSession) searchSession->cancel();   // a running worker returns early
+    historyManager = std::make_shared<HistoryManager>(dataDir);
+    searchSession = std::make_shared<SearchSession>(*historyManager);
     return env.Undefined();
 }
 
@@ -24,25 +49,222 @@ Napi::Value AddToHistory(const Napi::CallbackInfo& info) {
     }
 
     std::string text = info[0].As<Napi::String>().Utf8Value();
-    bool success = historyManager->addItem(text);
+    bool success = historyManager->addItem(std::move(text), "extension");
     return Napi::Boolean::New(env, success);
 }
 
-Napi::Value GetHistory(const Napi::CallbackInfo& info) {
-    Napi::Env env = info.Env();
-    auto items = historyManager->readHistory();
-    
+// Options accepted by getHistory/searchHistory. Every item carries the
+// summary HistoryManager stored at insert time (`preview`, `lineCount`,
+// `size`); without options `content` stays a string as before.
+//   previewLength   - max bytes of `preview`, up to kPreviewMaxBytes
+//   previewOnly     - leave out `content`, for list views
+//   bufferThreshold - content of at least this many bytes is returned as a
+//                     Buffer instead of being copied into a V8 string
+//   external        - let those Buffers wrap the stored bytes instead of a
+//                     copy (see ExternalBuffer); they must not be written to
+struct ListOptions {
+    size_t previewLength = HistoryManager::kPreviewMaxBytes;
+    bool previewOnly = false;
+    size_t bufferThreshold = SIZE_MAX;
+    bool external = false;
+};
+
+static ListOptions ParseListOptions(const Napi::CallbackInfo& info, size_t argIndex) {
+    ListOptions opts;
+    if (info.Length() <= argIndex || !info[argIndex].IsObject()) return opts;
+    Napi::Object o = info[argIndex].As<Napi::Object>();
+    if (o.Has("previewLength") && o.Get("previewLength").IsNumber())
+        opts.previewLength = o.Get("previewLength").As<Napi::Number>().Uint32Value();
+    if (o.Has("previewOnly"))
+        opts.previewOnly = o.Get("previewOnly").ToBoolean().Value();
+    if (o.Has("bufferThreshold") && o.Get("bufferThreshold").IsNumber())
+        opts.bufferThreshold = std::max<uint32_t>(1, o.Get("bufferThreshold").As<Napi::Number>().Uint32Value());
+    if (o.Has("external"))
+        opts.external = o.Get("external").ToBoolean().Value();
+    return opts;
+}
+
+// Hands the string's heap block to V8 as an external Buffer; the finalizer
+// frees it once JS drops the Buffer. Runtimes that forbid external buffers
+// (Electron's V8 sandbox) get a copy instead.
+static Napi::Value AdoptAsBuffer(Napi::Env env, std::string &&content) {
+    auto *owned = new std::string(std::move(content));
+    return Napi::Buffer<char>::NewOrCopy(env, &(*owned)[0], owned->size(),
+        [](Napi::Env, char*, std::string *hint) { delete hint; }, owned);
+}
+
+// Content below this size is always copied: the copy is cheap, and a Buffer
+// JS can write to then never aliases the history.
+static constexpr size_t kExternalMinBytes = 64 * 1024;
+
+// The content of a view as a Buffer. With external, large content is handed
+// to V8 as an external Buffer over the stored bytes, without a copy; the
+// finalizer hint holds the snapshot the bytes belong to, so they stay valid
+// for as long as JS keeps the Buffer. Such a Buffer shares the history's
+// memory, so writing to it would change stored items: it is only handed out
+// to callers that asked for it. Runtimes that forbid external buffers get a
+// copy, and the snapshot is let go right away.
+static Napi::Value ExternalBuffer(Napi::Env env, const ItemView &it, bool external) {
+    if (!external || it.content.size() < kExternalMinBytes || !it.owner)
+        return Napi::Buffer<char>::Copy(env, it.content.data(), it.content.size());
+    auto *owner = new std::shared_ptr<const void>(*it.owner);
+    return Napi::Buffer<char>::NewOrCopy(env, const_cast<char*>(it.content.data()), it.content.size(),
+        [](Napi::Env, char*, std::shared_ptr<const void> *hint) { delete hint; }, owner);
+}
+
+static Napi::String StringFromView(Napi::Env env, std::string_view text) {
+    return Napi::String::New(env, text.data(), text.size());
+}
+
+// An item object with everything but `content`, built straight from the
+// stored strings. when is a reused buffer for the formatted time.
+static Napi::Object ItemObject(Napi::Env env, const ItemView &it, const ListOptions &opts, std::string &when) {
+    Napi::Object item = Napi::Object::New(env);
+    when.clear();
+    timestamp::appendFormatted(it.time, when);
+    item.Set("timestamp", when);
+    // Stored time in microseconds; with `size` it tells whether an index read
+    // earlier still holds the same item.
+    item.Set("time", Napi::Number::New(env, static_cast<double>(it.time)));
+    item.Set("pinned", it.pinned);
+    item.Set("size", Napi::Number::New(env, static_cast<double>(it.size)));
+    item.Set("lineCount", Napi::Number::New(env, static_cast<double>(it.lineCount)));
+    std::string_view preview = it.preview;
+    if (preview.size() > opts.previewLength) {
+        size_t begin, length;
+        ItemBlock::previewRange(preview.data(), preview.size(), opts.previewLength, begin, length);
+        preview = preview.substr(begin, length);
+    }
+    item.Set("preview", StringFromView(env, preview));
+    if (!it.mime.empty()) item.Set("mime", StringFromView(env, it.mime));
+    return item;
+}
+
+// ItemObject plus `content`: a V8 string copied from the stored text, or a
+// Buffer (see ExternalBuffer). Binary content is always a Buffer;
+// a payload in the blob store is left for getItemContent.
+static Napi::Object ViewToObject(Napi::Env env, const ItemView &it, const ListOptions &opts, std::string &when) {
+    Napi::Object item = ItemObject(env, it, opts, when);
+    if (!opts.previewOnly && it.blob.empty()) {
+        if (it.content.size() >= opts.bufferThreshold || !isTextual(it.type))
+            item.Set("content", ExternalBuffer(env, it, opts.external));
+        else
+            item.Set("content", StringFromView(env, it.content));
+    }
+    return item;
+}
+
+// Items a visit* call hands out, in the order they come.
+static Napi::Array VisitToArray(Napi::Env env, const ListOptions &opts,
+                                const std::function<void(const ItemVisitor&)> &run) {
+    Napi::Array result = Napi::Array::New(env);
+    std::string when;
+    uint32_t n = 0;
+    run([&](const ItemView &it) {
+        result[n++] = ViewToObject(env, it, opts, when);
+        return true;
+    });
+    return result;
+}
+
+static Napi::Array ItemsToArray(Napi::Env env, std::vector<HistoryItem> &items, const ListOptions &opts) {
     Napi::Array result = Napi::Array::New(env, items.size());
+    std::string when;
     for (size_t i = 0; i < items.size(); i++) {
-        Napi::Object item = Napi::Object::New(env);
-        item.Set("timestamp", items[i].timestamp);
-        item.Set("content", items[i].content);
-        item.Set("pinned", items[i].pinned);
+        ItemView view;
+        view.time = items[i].time;
+        view.pinned = items[i].pinned;
+        view.type = items[i].type();
+        view.mime = items[i].mime;
+        view.preview = items[i].preview;
+        view.lineCount = items[i].lineCount;
+        view.size = items[i].size;
+        Napi::Object item = ItemObject(env, view, opts, when);
+        if (!opts.previewOnly && items[i].blob.empty()) {
+            if (items[i].content.size() >= opts.bufferThreshold || !isTextual(view.type))
+                item.Set("content", AdoptAsBuffer(env, std::move(items[i].content)));
+            else
+                item.Set("content", items[i].content);
+        }
         result[i] = item;
     }
     return result;
 }
 
+// Search results: ItemsToArray plus each hit's history `index` and `score`.
+static Napi::Array HitsToArray(Napi::Env env, std::vector<SearchHit> &hits, const ListOptions &opts) {
+    std::vector<HistoryItem> items;
+    items.reserve(hits.size());
+    for (auto &hit : hits) items.push_back(std::move(hit.item));
+    Napi::Array result = ItemsToArray(env, items, opts);
+    for (size_t i = 0; i < hits.size(); i++) {
+        Napi::Object item = result.Get(i).As<Napi::Object>();
+        item.Set("index", Napi::Number::New(env, static_cast<double>(hits[i].index)));
+        item.Set("score", Napi::Number::New(env, hits[i].score));
+    }
+    return result;
+}
+
+// `limit` of a search options object, 50 by default.
+static size_t ParseLimit(const Napi::CallbackInfo& info, size_t argIndex) {
+    if (info.Length() <= argIndex || !info[argIndex].IsObject()) return 50;
+    Napi::Object o = info[argIndex].As<Napi::Object>();
+    if (o.Has("limit") && o.Get("limit").IsNumber())
+        return o.Get("limit").As<Napi::Number>().Uint32Value();
+    return 50;
+}
+
+Napi::Value GetHistory(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    return VisitToArray(env, ParseListOptions(info, 0),
+                        [&](const ItemVisitor &visit) { historyManager->visitHistory(visit); });
+}
+
+// Full content of one item as a Buffer, for views that listed previews only
+// and for binary items, whose payload may be in the blob store.
+// getItemContent(index, { external: true }) may return a Buffer over the
+// stored bytes (see ExternalBuffer); without it the content is copied.
+Napi::Value GetItemContent(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1) {
+        Napi::TypeError::New(env, "Wrong number of arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    size_t index = info[0].As<Napi::Number>().Uint32Value();
+    const bool external = ParseListOptions(info, 1).external;
+    Napi::Value content = env.Null();
+    bool inBlob = false;
+    historyManager->visitItem(index, [&](const ItemView &it) {
+        inBlob = !it.blob.empty();
+        if (!inBlob) content = ExternalBuffer(env, it, external);
+        return true;
+    });
+    if (inBlob) {
+        std::ostringstream payload;
+        if (historyManager->readPayload(index, payload)) content = AdoptAsBuffer(env, payload.str());
+    }
+    return content;
+}
+
+// addBinaryToHistory(buffer, mime): bytes of another format, e.g. an image.
+// Large payloads go to the blob store.
+Napi::Value AddBinaryToHistory(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[0].IsBuffer()) {
+        Napi::TypeError::New(env, "Expected a Buffer and a MIME type").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto bytes = info[0].As<Napi::Buffer<char>>();
+    HistoryItem item;
+    item.content.assign(bytes.Data(), bytes.Length());
+    item.mime = info[1].As<Napi::String>().Utf8Value();
+    item.source = "extension";
+    bool success = historyManager->batch([&](HistoryManager::Batch &b) { return b.addItem(std::move(item)); });
+    return Napi::Boolean::New(env, success);
+}
+
 Napi::Value SaveToSlot(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     if (info.Length() < 2) {
@@ -64,11 +286,9 @@ Napi::Value GetFromSlot(const Napi::CallbackInfo& info) {
     }
 
     int slot = info[0].As<Napi::Number>().Int32Value();
-    auto text = historyManager->getSlot(slot);
-    if (!text.has_value()) {
-        return env.Null();
-    }
-    return Napi::String::New(env, text.value());
+    Napi::Value text = env.Null();
+    historyManager->visitSlot(slot, [&](std::string_view content) { text = StringFromView(env, content); });
+    return text;
 }
 
 Napi::Value PinItem(const Napi::CallbackInfo& info) {
@@ -107,6 +327,16 @@ Napi::Value DeleteItem(const Napi::CallbackInfo& info) {
     return Napi::Boolean::New(env, success);
 }
 
+// undo() / redo(): steps through the journal of deletes, pins and slot
+// writes; false when there is nothing left.
+Napi::Value Undo(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), historyManager->undo());
+}
+
+Napi::Value Redo(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), historyManager->redo());
+}
+
 Napi::Value SearchHistory(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     if (info.Length() < 1) {
@@ -115,38 +345,322 @@ Napi::Value SearchHistory(const Napi::CallbackInfo& info) {
     }
 
     std::string query = info[0].As<Napi::String>().Utf8Value();
-    auto items = historyManager->search(query);
-    
-    Napi::Array result = Napi::Array::New(env, items.size());
-    for (size_t i = 0; i < items.size(); i++) {
-        Napi::Object item = Napi::Object::New(env);
-        item.Set("timestamp", items[i].timestamp);
-        item.Set("content", items[i].content);
-        item.Set("pinned", items[i].pinned);
-        result[i] = item;
+    return VisitToArray(env, ParseListOptions(info, 1),
+                        [&](const ItemVisitor &visit) { historyManager->visitSearch(query, visit); });
+}
+
+// fuzzySearch(query, { limit = 50, ...list options }): the best `limit`
+// matches, best first. Each item also carries its history `index` and
+// `score`, so the UI can act on it without resolving it by content.
+Napi::Value FuzzySearch(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1) {
+        Napi::TypeError::New(env, "Wrong number of arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string query = info[0].As<Napi::String>().Utf8Value();
+    size_t limit = ParseLimit(info, 1);
+
+    auto hits = historyManager->fuzzySearch(query, limit);
+    return HitsToArray(env, hits, ParseListOptions(info, 1));
+}
+
+// regexSearch(pattern, { limit = 50, ...list options }): matching items,
+// newest first, with their `index`. Throws if the pattern is invalid.
+Napi::Value RegexSearch(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1) {
+        Napi::TypeError::New(env, "Wrong number of arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string pattern = info[0].As<Napi::String>().Utf8Value();
+    size_t limit = ParseLimit(info, 1);
+    std::vector<SearchHit> hits;
+    std::string error;
+    if (!historyManager->regexSearch(pattern, limit, hits, error)) {
+        Napi::Error::New(env, "Invalid pattern: " + error).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    return HitsToArray(env, hits, ParseListOptions(info, 1));
+}
+
+// Runs one SearchSession query on the libuv thread pool. The promise
+// resolves to the items like fuzzySearch, or to null when a newer call
+// superseded this one.
+class IncrementalSearchWorker : public Napi::AsyncWorker {
+public:
+    IncrementalSearchWorker(Napi::Env env, std::string query, size_t limit, const ListOptions &opts)
+        : Napi::AsyncWorker(env), m_deferred(Napi::Promise::Deferred::New(env)),
+          m_history(historyManager), m_session(searchSession),
+          m_query(std::move(query)), m_limit(limit), m_opts(opts) {}
+
+    Napi::Promise Promise() { return m_deferred.Promise(); }
+
+    void Execute() override {
+        static stats::Histogram &runTime = stats::histogram("addon.searchIncremental.run");
+        stats::Timer timer(runTime);
+        m_done = m_session->search(m_query, m_limit, m_hits);
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        if (!m_done) {
+            m_deferred.Resolve(env.Null());
+            return;
+        }
+        m_deferred.Resolve(HitsToArray(env, m_hits, m_opts));
+    }
+
+    void OnError(const Napi::Error &e) override {
+        m_deferred.Reject(e.Value());
+    }
+
+private:
+    Napi::Promise::Deferred m_deferred;
+    // The manager and session the search started on, alive until the worker
+    // is deleted on the JS thread; the session refers to the manager, so it
+    // goes first.
+    std::shared_ptr<HistoryManager> m_history;
+    std::shared_ptr<SearchSession> m_session;
+    std::string m_query;
+    size_t m_limit;
+    ListOptions m_opts;
+    std::vector<SearchHit> m_hits;
+    bool m_done = false;
+};
+
+// searchIncremental(query, { limit = 50, ...list options }) -> Promise.
+// Meant to be called on every keystroke: a query extending an earlier one
+// only rescans that query's matches, and a newer call cancels this one.
+Napi::Value SearchIncremental(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1) {
+        Napi::TypeError::New(env, "Wrong number of arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!searchSession) {
+        Napi::Error::New(env, "init() must be called before searchIncremental()").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string query = info[0].As<Napi::String>().Utf8Value();
+    size_t limit = ParseLimit(info, 1);
+
+    searchSession->cancel();   // don't let an outdated query hold a pool thread
+    auto *worker = new IncrementalSearchWorker(env, std::move(query), limit, ParseListOptions(info, 1));
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// query({ since, until, pinned, minSize, maxSize, source, limit, ...list
+// options }): since/until are Dates or epoch milliseconds; limit 0 (the
+// default) returns every match. Only matching items are converted to JS.
+Napi::Value Query(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    HistoryQuery q;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Object o = info[0].As<Napi::Object>();
+        auto seconds = [](Napi::Value v) {
+            double ms = v.IsDate() ? v.As<Napi::Date>().ValueOf() : v.As<Napi::Number>().DoubleValue();
+            return static_cast<int64_t>(ms * 1000);
+        };
+        auto isTime = [](Napi::Value v) { return v.IsDate() || v.IsNumber(); };
+        if (o.Has("since") && isTime(o.Get("since"))) q.since = seconds(o.Get("since"));
+        if (o.Has("until") && isTime(o.Get("until"))) q.until = seconds(o.Get("until"));
+        if (o.Has("pinned") && o.Get("pinned").IsBoolean())
+            q.pinned = o.Get("pinned").As<Napi::Boolean>().Value();
+        if (o.Has("minSize") && o.Get("minSize").IsNumber())
+            q.minSize = static_cast<size_t>(o.Get("minSize").As<Napi::Number>().Int64Value());
+        if (o.Has("maxSize") && o.Get("maxSize").IsNumber())
+            q.maxSize = static_cast<size_t>(o.Get("maxSize").As<Napi::Number>().Int64Value());
+        if (o.Has("source") && o.Get("source").IsString())
+            q.source = o.Get("source").As<Napi::String>().Utf8Value();
+        if (o.Has("limit") && o.Get("limit").IsNumber())
+            q.limit = o.Get("limit").As<Napi::Number>().Uint32Value();
+    }
+    auto hits = historyManager->query(q);
+    return HitsToArray(env, hits, ParseListOptions(info, 0));
+}
+
+static void DeliverPendingClips(Napi::Env env, Napi::Function jsCallback) {
+    std::vector<std::string> clips;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        clips.swap(pendingClips);
+        pendingDepth.set(0);
+    }
+    if (clips.empty() || !historyManager) return;
+
+    uint32_t added = 0;
+    for (auto &text : clips) {
+        if (historyManager->addItem(std::move(text), "clipboard")) added++;
+    }
+    if (added > 0) jsCallback.Call({ Napi::Number::New(env, added) });
+}
+
+static void StopMonitorThread() {
+    if (!clipboardMonitor) return;
+    clipboardMonitor->stop();
+    clipboardMonitor.reset();
+    monitorTsfn.Release();
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    pendingClips.clear();
+}
+
+Napi::Value StartMonitor(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsFunction()) {
+        Napi::TypeError::New(env, "Expected a callback function").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!historyManager) {
+        Napi::Error::New(env, "init() must be called before startMonitor()").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    StopMonitorThread();
+    monitorTsfn = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(),
+                                                "ClipboardMonitor", 0, 1);
+    monitorTsfn.Unref(env);   // the monitor alone must not keep Node alive
+
+    clipboardMonitor = std::make_unique<ClipboardMonitor>();
+    clipboardMonitor->start([](std::string &&text) {
+        bool wasEmpty;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            wasEmpty = pendingClips.empty();
+            pendingClips.push_back(std::move(text));
+            pendingDepth.set(static_cast<int64_t>(pendingClips.size()));
+        }
+        if (wasEmpty) monitorTsfn.NonBlockingCall(DeliverPendingClips);
+    });
+    return Napi::Boolean::New(env, true);
+}
+
+Napi::Value StopMonitor(const Napi::CallbackInfo& info) {
+    StopMonitorThread();
+    return info.Env().Undefined();
+}
+
+// Milliseconds, the unit of performance.now().
+static Napi::Number Millis(Napi::Env env, uint64_t nanos) {
+    return Napi::Number::New(env, static_cast<double>(nanos) / 1e6);
+}
+
+// getStats({ reset = false }) -> { enabled, latencies, counters, queues }
+//   latencies: { "history.load": { count, mean, p50, p90, p99, p999, max }, ... }
+//              with times in milliseconds
+//   counters:  { "history.bytes_read": n, ... }
+//   queues:    { "addon.monitor_queue": { now, max }, ... }
+// Only what was recorded since start (or the last reset) is listed; see
+// setStatsEnabled().
+Napi::Value GetStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    const stats::Report r = stats::report();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("enabled", Napi::Boolean::New(env, r.enabled));
+    Napi::Object latencies = Napi::Object::New(env);
+    for (const auto &l : r.latencies) {
+        const auto &s = l.summary;
+        Napi::Object o = Napi::Object::New(env);
+        o.Set("count", Napi::Number::New(env, static_cast<double>(s.count)));
+        o.Set("mean", Millis(env, s.sumNanos / s.count));
+        o.Set("p50", Millis(env, s.p50));
+        o.Set("p90", Millis(env, s.p90));
+        o.Set("p99", Millis(env, s.p99));
+        o.Set("p999", Millis(env, s.p999));
+        o.Set("max", Millis(env, s.maxNanos));
+        latencies.Set(l.name, o);
+    }
+    result.Set("latencies", latencies);
+    Napi::Object counters = Napi::Object::New(env);
+    for (const auto &c : r.counters) counters.Set(c.name, Napi::Number::New(env, static_cast<double>(c.value)));
+    result.Set("counters", counters);
+    Napi::Object queues = Napi::Object::New(env);
+    for (const auto &g : r.gauges) {
+        Napi::Object o = Napi::Object::New(env);
+        o.Set("now", Napi::Number::New(env, static_cast<double>(g.value)));
+        o.Set("max", Napi::Number::New(env, static_cast<double>(g.max)));
+        queues.Set(g.name, o);
+    }
+    result.Set("queues", queues);
+
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Value reset = info[0].As<Napi::Object>().Get("reset");
+        if (reset.IsBoolean() && reset.As<Napi::Boolean>().Value()) stats::reset();
     }
     return result;
 }
 
+// setStatsEnabled(on): collection is off unless CLIPBOARD_STATS was set
+// when the addon loaded.
+Napi::Value SetStatsEnabled(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsBoolean()) {
+        Napi::TypeError::New(env, "Expected a boolean").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    stats::setEnabled(info[0].As<Napi::Boolean>().Value());
+    return env.Undefined();
+}
+
+// Exported functions are timed as "addon.<name>", from the call to its
+// return; searchIncremental's search itself is "addon.searchIncremental.run".
+static Napi::Function Timed(Napi::Env env, Napi::Value (*fn)(const Napi::CallbackInfo&), const char *name) {
+    stats::Histogram *time = &stats::histogram(std::string("addon.") + name);
+    return Napi::Function::New(env, [fn, time](const Napi::CallbackInfo& info) {
+        stats::Timer timer(*time);
+        return fn(info);
+    }, name);
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
     exports.Set(Napi::String::New(env, "init"), 
-                Napi::Function::New(env, InitManager, "init"));
+                Timed(env, InitManager, "init"));
     exports.Set(Napi::String::New(env, "addToHistory"), 
-                Napi::Function::New(env, AddToHistory, "addToHistory"));
+                Timed(env, AddToHistory, "addToHistory"));
+    exports.Set(Napi::String::New(env, "addBinaryToHistory"), 
+                Timed(env, AddBinaryToHistory, "addBinaryToHistory"));
     exports.Set(Napi::String::New(env, "getHistory"), 
-                Napi::Function::New(env, GetHistory, "getHistory"));
+                Timed(env, GetHistory, "getHistory"));
+    exports.Set(Napi::String::New(env, "getItemContent"), 
+                Timed(env, GetItemContent, "getItemContent"));
     exports.Set(Napi::String::New(env, "saveToSlot"), 
-                Napi::Function::New(env, SaveToSlot, "saveToSlot"));
+                Timed(env, SaveToSlot, "saveToSlot"));
     exports.Set(Napi::String::New(env, "getFromSlot"), 
-                Napi::Function::New(env, GetFromSlot, "getFromSlot"));
+                Timed(env, GetFromSlot, "getFromSlot"));
     exports.Set(Napi::String::New(env, "pinItem"), 
-                Napi::Function::New(env, PinItem, "pinItem"));
+                Timed(env, PinItem, "pinItem"));
     exports.Set(Napi::String::New(env, "unpinItem"), 
-                Napi::Function::New(env, UnpinItem, "unpinItem"));
+                Timed(env, UnpinItem, "unpinItem"));
     exports.Set(Napi::String::New(env, "deleteItem"), 
-                Napi::Function::New(env, DeleteItem, "deleteItem"));
+                Timed(env, DeleteItem, "deleteItem"));
+    exports.Set(Napi::String::New(env, "undo"), 
+                Timed(env, Undo, "undo"));
+    exports.Set(Napi::String::New(env, "redo"), 
+                Timed(env, Redo, "redo"));
     exports.Set(Napi::String::New(env, "searchHistory"), 
-                Napi::Function::New(env, SearchHistory, "searchHistory"));
+                Timed(env, SearchHistory, "searchHistory"));
+    exports.Set(Napi::String::New(env, "fuzzySearch"), 
+                Timed(env, FuzzySearch, "fuzzySearch"));
+    exports.Set(Napi::String::New(env, "regexSearch"), 
+                Timed(env, RegexSearch, "regexSearch"));
+    exports.Set(Napi::String::New(env, "searchIncremental"), 
+                Timed(env, SearchIncremental, "searchIncremental"));
+    exports.Set(Napi::String::New(env, "query"), 
+                Timed(env, Query, "query"));
+    exports.Set(Napi::String::New(env, "startMonitor"), 
+                Timed(env, StartMonitor, "startMonitor"));
+    exports.Set(Napi::String::New(env, "stopMonitor"), 
+                Timed(env, StopMonitor, "stopMonitor"));
+    exports.Set(Napi::String::New(env, "getStats"), 
+                Napi::Function::New(env, GetStats, "getStats"));
+    exports.Set(Napi::String::New(env, "setStatsEnabled"), 
+                Napi::Function::New(env, SetStatsEnabled, "setStatsEnabled"));
+    env.AddCleanupHook(StopMonitorThread);
     return exports;
 }
 
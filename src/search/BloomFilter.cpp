@@ -0,0 +1,70 @@
+#include "BloomFilter.h"
+#include <cstring>
+#include <fstream>
+
+static const uint32_t kBitsPerKey = 10;
+static const uint32_t kHashes = 7;   // optimal for 10 bits per key
+static const char kMagic[8] = { 'C', 'M', 'B', 'L', 'O', 'O', 'M', '1' };
+
+static uint64_t mix(uint64_t x) {   // splitmix64 finalizer
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+BloomFilter::BloomFilter(size_t expectedKeys) : m_hashes(kHashes) {
+    size_t bits = expectedKeys * kBitsPerKey;
+    if (bits < 1024) bits = 1024;
+    m_bits.assign((bits + 7) / 8, 0);
+}
+
+// Double hashing: probe i is h1 + i * h2.
+void BloomFilter::add(uint64_t key) {
+    if (m_bits.empty()) return;
+    const uint64_t h = mix(key), bits = m_bits.size() * 8;
+    const uint32_t h1 = static_cast<uint32_t>(h), h2 = static_cast<uint32_t>(h >> 32) | 1;
+    for (uint32_t i = 0; i < m_hashes; ++i) {
+        uint64_t bit = (h1 + static_cast<uint64_t>(i) * h2) % bits;
+        m_bits[bit >> 3] |= static_cast<uint8_t>(1u << (bit & 7));
+    }
+}
+
+bool BloomFilter::mayContain(uint64_t key) const {
+    if (m_bits.empty()) return true;   // no filter: can't rule anything out
+    const uint64_t h = mix(key), bits = m_bits.size() * 8;
+    const uint32_t h1 = static_cast<uint32_t>(h), h2 = static_cast<uint32_t>(h >> 32) | 1;
+    for (uint32_t i = 0; i < m_hashes; ++i) {
+        uint64_t bit = (h1 + static_cast<uint64_t>(i) * h2) % bits;
+        if (!(m_bits[bit >> 3] & (1u << (bit & 7)))) return false;
+    }
+    return true;
+}
+
+// Layout: magic, uint32 hash count, uint64 byte count, the bit array.
+bool BloomFilter::save(const std::string &path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    uint64_t bytes = m_bits.size();
+    out.write(kMagic, sizeof(kMagic));
+    out.write(reinterpret_cast<const char*>(&m_hashes), sizeof(m_hashes));
+    out.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+    out.write(reinterpret_cast<const char*>(m_bits.data()), static_cast<std::streamsize>(bytes));
+    return static_cast<bool>(out);
+}
+
+bool BloomFilter::load(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    uint32_t hashes = 0;
+    uint64_t bytes = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) return false;
+    if (!in.read(reinterpret_cast<char*>(&hashes), sizeof(hashes)) ||
+        !in.read(reinterpret_cast<char*>(&bytes), sizeof(bytes))) return false;
+    if (hashes == 0 || hashes > 32 || bytes == 0 || bytes > (1u << 30)) return false;
+    std::vector<uint8_t> bits(static_cast<size_t>(bytes));
+    if (!in.read(reinterpret_cast<char*>(bits.data()), static_cast<std::streamsize>(bytes))) return false;
+    m_bits.swap(bits);
+    m_hashes = hashes;
+    return true;
+}
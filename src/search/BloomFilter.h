@@ -0,0 +1,41 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Bloom filter over 64-bit keys: mayContain() never misses a key that was
+// added and wrongly reports about 1% of others at ~10 bits per key. Used as
+// the sidecar of an archived history segment, filled with the trigrams of
+// its items' search keys, so a keyword search can skip the segment file.
+class BloomFilter {
+public:
+    BloomFilter() = default;
+    explicit BloomFilter(size_t expectedKeys);
+
+    void add(uint64_t key);
+    bool mayContain(uint64_t key) const;
+    bool empty() const { return m_bits.empty(); }
+
+    bool save(const std::string &path) const;
+    bool load(const std::string &path);
+
+    // Trigram keys of text: every run of 3 consecutive bytes. fn(uint64_t).
+    template <typename Fn>
+    static void forEachTrigram(std::string_view text, Fn fn) {
+        for (size_t i = 0; i + 3 <= text.size(); ++i) {
+            fn(static_cast<uint64_t>(static_cast<unsigned char>(text[i])) << 16 |
+               static_cast<uint64_t>(static_cast<unsigned char>(text[i + 1])) << 8 |
+               static_cast<uint64_t>(static_cast<unsigned char>(text[i + 2])));
+        }
+    }
+
+private:
+    std::vector<uint8_t> m_bits;
+    uint32_t m_hashes = 0;
+};
+
+#endif // BLOOM_FILTER_H
@@ -0,0 +1,94 @@
+#include "FuzzyMatcher.h"
+#include <algorithm>
+
+static const int kScoreMatch = 16;
+static const int kScoreGapStart = -3;
+static const int kScoreGapExtension = -1;
+static const int kBonusBoundary = 8;
+static const int kBonusCamel = 7;
+static const int kBonusConsecutive = -(kScoreGapStart + kScoreGapExtension);
+static const int kFirstCharMultiplier = 2;
+
+enum class CharClass { NonWord, Lower, Upper, Digit };
+
+static CharClass classOf(char c) {
+    if (c >= 'a' && c <= 'z') return CharClass::Lower;
+    if (c >= 'A' && c <= 'Z') return CharClass::Upper;
+    if (c >= '0' && c <= '9') return CharClass::Digit;
+    // bytes of multi-byte UTF-8 characters count as word characters
+    return (static_cast<unsigned char>(c) & 0x80) ? CharClass::Lower : CharClass::NonWord;
+}
+
+static int bonusFor(CharClass prev, CharClass cur) {
+    if (cur == CharClass::NonWord) return 0;
+    if (prev == CharClass::NonWord) return kBonusBoundary;
+    if ((prev == CharClass::Lower && cur == CharClass::Upper) ||
+        (prev != CharClass::Digit && cur == CharClass::Digit)) return kBonusCamel;
+    return 0;
+}
+
+FuzzyMatcher::FuzzyMatcher(const std::string &pattern) : m_pattern(pattern) {
+    bool caseSensitive = std::any_of(pattern.begin(), pattern.end(),
+                                     [](char c) { return c >= 'A' && c <= 'Z'; });
+    for (int c = 0; c < 256; ++c) {
+        m_fold[c] = static_cast<unsigned char>(!caseSensitive && c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+}
+
+bool FuzzyMatcher::match(const char *text, size_t length, int &score) const {
+    score = 0;
+    const size_t m = m_pattern.size();
+    if (m == 0) return true;
+
+    // Forward: find where the first complete match ends.
+    size_t pi = 0, start = 0, end = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (same(text[i], m_pattern[pi])) {
+            if (pi == 0) start = i;
+            if (++pi == m) {
+                end = i + 1;
+                break;
+            }
+        }
+    }
+    if (pi < m) return false;
+
+    // Backward: tighten the start of that window.
+    pi = m;
+    for (size_t i = end; i-- > start;) {
+        if (same(text[i], m_pattern[pi - 1]) && --pi == 0) {
+            start = i;
+            break;
+        }
+    }
+
+    // Score the window.
+    CharClass prev = start > 0 ? classOf(text[start - 1]) : CharClass::NonWord;
+    int consecutive = 0, firstBonus = 0;
+    bool inGap = false;
+    pi = 0;
+    for (size_t i = start; i < end; ++i) {
+        CharClass cls = classOf(text[i]);
+        if (pi < m && same(text[i], m_pattern[pi])) {
+            int bonus = bonusFor(prev, cls);
+            if (consecutive == 0) {
+                firstBonus = bonus;
+            } else {
+                // a run keeps the bonus of the boundary it started on
+                if (bonus >= kBonusBoundary && bonus > firstBonus) firstBonus = bonus;
+                bonus = std::max({bonus, firstBonus, kBonusConsecutive});
+            }
+            score += kScoreMatch + (pi == 0 ? bonus * kFirstCharMultiplier : bonus);
+            consecutive++;
+            inGap = false;
+            pi++;
+        } else {
+            score += inGap ? kScoreGapExtension : kScoreGapStart;
+            consecutive = 0;
+            firstBonus = 0;
+            inGap = true;
+        }
+        prev = cls;
+    }
+    return true;
+}
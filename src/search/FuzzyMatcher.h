@@ -0,0 +1,36 @@
+#ifndef FUZZY_MATCHER_H
+#define FUZZY_MATCHER_H
+
+#include <string>
+#include <cstddef>
+
+// fzf-style fuzzy matching: every pattern character must appear in the text
+// in order, not necessarily adjacent. Among the matches, the shortest window
+// ending at the first complete match is scored:
+//   +16 per matched character, +8 when it starts a word, +7 on a camelCase
+//   or letter/digit transition, at least +4 while the run stays consecutive
+//   (the first character's bonus counts twice)
+//   -3 for opening a gap, -1 for every further skipped character
+// Smart case: the match ignores ASCII case unless the pattern contains an
+// uppercase letter.
+class FuzzyMatcher {
+public:
+    explicit FuzzyMatcher(const std::string &pattern);
+
+    // Returns false if text does not contain the pattern. An empty pattern
+    // matches everything with score 0.
+    bool match(const char *text, size_t length, int &score) const;
+    bool match(const std::string &text, int &score) const {
+        return match(text.data(), text.size(), score);
+    }
+
+private:
+    std::string m_pattern;
+    unsigned char m_fold[256];   // text byte -> byte compared with the pattern
+
+    bool same(char textChar, char patternChar) const {
+        return static_cast<char>(m_fold[static_cast<unsigned char>(textChar)]) == patternChar;
+    }
+};
+
+#endif // FUZZY_MATCHER_H
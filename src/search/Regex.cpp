@@ -0,0 +1,733 @@
+#include "Regex.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+// Upper bounds that keep compilation and the DFA cache small.
+static const size_t kMaxNfaStates = 100000;
+static const size_t kMaxDfaStates = 4096;   // the cache is flushed beyond this
+static const int kMaxRepeat = 1000;
+static const int kMatched = -2;             // DfaState::next: a match was found
+
+static const uint32_t kMaxCodepoint = 0x10FFFF;
+
+namespace {
+
+using Ranges = std::vector<std::pair<uint32_t, uint32_t>>;   // codepoint ranges
+
+struct Node {
+    enum Kind { Empty, Class, Concat, Alternate, Repeat, LineStart, LineEnd } kind;
+    Ranges ranges;              // Class
+    int32_t literal = -1;       // Class written as a single character
+    std::vector<std::unique_ptr<Node>> children;
+    int min = 0, max = 0;       // Repeat; max -1 = unbounded
+
+    explicit Node(Kind k) : kind(k) {}
+};
+
+void normalize(Ranges &r) {
+    std::sort(r.begin(), r.end());
+    Ranges merged;
+    for (const auto &range : r) {
+        if (!merged.empty() && range.first <= merged.back().second + 1) {
+            merged.back().second = std::max(merged.back().second, range.second);
+        } else {
+            merged.push_back(range);
+        }
+    }
+    r.swap(merged);
+}
+
+Ranges complement(const Ranges &r) {
+    Ranges out;
+    uint32_t next = 0;
+    for (const auto &range : r) {
+        if (range.first > next) out.push_back({next, range.first - 1});
+        next = range.second + 1;
+    }
+    if (next <= kMaxCodepoint) out.push_back({next, kMaxCodepoint});
+    return out;
+}
+
+// Adds the other ASCII case of every letter in r.
+void addOtherCase(Ranges &r) {
+    Ranges extra;
+    for (const auto &range : r) {
+        uint32_t lo = std::max<uint32_t>(range.first, 'a'), hi = std::min<uint32_t>(range.second, 'z');
+        if (lo <= hi) extra.push_back({lo - 32, hi - 32});
+        lo = std::max<uint32_t>(range.first, 'A');
+        hi = std::min<uint32_t>(range.second, 'Z');
+        if (lo <= hi) extra.push_back({lo + 32, hi + 32});
+    }
+    r.insert(r.end(), extra.begin(), extra.end());
+    normalize(r);
+}
+
+void appendUtf8(std::string &out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+using ByteSequence = std::vector<std::pair<uint8_t, uint8_t>>;
+
+// Splits [lo, hi] (same encoded length) into byte-range sequences in which
+// every continuation position spans a contiguous range.
+void utf8Split(uint32_t lo, uint32_t hi, std::vector<ByteSequence> &out) {
+    // first split at the boundaries between encoded lengths
+    static const uint32_t lengthEnds[] = { 0x7F, 0x7FF, 0xFFFF };
+    for (uint32_t end : lengthEnds) {
+        if (lo <= end && hi > end) {
+            utf8Split(lo, end, out);
+            utf8Split(end + 1, hi, out);
+            return;
+        }
+    }
+    if (hi < 0x80) {
+        out.push_back({{static_cast<uint8_t>(lo), static_cast<uint8_t>(hi)}});
+        return;
+    }
+    size_t n = hi < 0x800 ? 2 : hi < 0x10000 ? 3 : 4;
+    for (size_t i = 1; i < n; ++i) {
+        uint32_t m = (1u << (6 * i)) - 1;
+        if ((lo & ~m) != (hi & ~m)) {
+            if ((lo & m) != 0) {
+                utf8Split(lo, lo | m, out);
+                utf8Split((lo | m) + 1, hi, out);
+                return;
+            }
+            if ((hi & m) != m) {
+                utf8Split(lo, (hi & ~m) - 1, out);
+                utf8Split(hi & ~m, hi, out);
+                return;
+            }
+        }
+    }
+    std::string a, b;
+    appendUtf8(a, lo);
+    appendUtf8(b, hi);
+    ByteSequence seq;
+    for (size_t i = 0; i < n; ++i) {
+        seq.push_back({static_cast<uint8_t>(a[i]), static_cast<uint8_t>(b[i])});
+    }
+    out.push_back(seq);
+}
+
+} // namespace
+
+// Parses the pattern into a Node tree, then compiles it back to front into
+// Regex's NFA.
+class RegexCompiler {
+public:
+    RegexCompiler(Regex &re, const std::string &pattern)
+        : m_re(re), m_p(pattern), m_ci(re.m_caseInsensitive) {}
+
+    bool run() {
+        if (m_p.compare(0, 4, "(?i)") == 0) {
+            m_ci = true;
+            m_pos = 4;
+        }
+        m_re.m_caseInsensitive = m_ci;
+        auto root = parseAlternate();
+        if (!root) return false;
+        if (m_pos < m_p.size()) return fail("unmatched )");
+
+        int match = m_re.addState(Regex::NfaState::Match);
+        m_re.m_start = compile(*root, match);
+        if (m_re.m_start < 0) return false;
+
+        Literal lit = literalOf(*root);
+        m_re.m_literal = lit.best;
+        return true;
+    }
+
+private:
+    Regex &m_re;
+    const std::string &m_p;
+    size_t m_pos = 0;
+    bool m_ci;
+
+    bool fail(const std::string &why) {
+        if (m_re.m_error.empty()) m_re.m_error = why + " at offset " + std::to_string(m_pos);
+        return false;
+    }
+
+    bool more() const { return m_pos < m_p.size(); }
+    char peek() const { return m_p[m_pos]; }
+
+    uint32_t decodeChar() {
+        unsigned char c = static_cast<unsigned char>(m_p[m_pos++]);
+        if (c < 0x80) return c;
+        int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+        uint32_t cp = c & (0x3F >> extra);
+        for (int i = 0; i < extra && more(); ++i) cp = (cp << 6) | (static_cast<unsigned char>(m_p[m_pos++]) & 0x3F);
+        return cp;
+    }
+
+    std::unique_ptr<Node> makeClass(Ranges r, int32_t literal = -1) {
+        auto n = std::make_unique<Node>(Node::Class);
+        normalize(r);
+        if (m_ci) addOtherCase(r);
+        n->ranges = std::move(r);
+        n->literal = literal;
+        return n;
+    }
+
+    std::unique_ptr<Node> parseAlternate() {
+        auto first = parseConcat();
+        if (!first) return nullptr;
+        if (!more() || peek() != '|') return first;
+        auto alt = std::make_unique<Node>(Node::Alternate);
+        alt->children.push_back(std::move(first));
+        while (more() && peek() == '|') {
+            m_pos++;
+            auto next = parseConcat();
+            if (!next) return nullptr;
+            alt->children.push_back(std::move(next));
+        }
+        return alt;
+    }
+
+    std::unique_ptr<Node> parseConcat() {
+        auto cat = std::make_unique<Node>(Node::Concat);
+        while (more() && peek() != '|' && peek() != ')') {
+            auto atom = parseRepeat();
+            if (!atom) return nullptr;
+            cat->children.push_back(std::move(atom));
+        }
+        return cat;
+    }
+
+    // {m}, {m,} or {m,n} at m_pos; anything else leaves '{' a literal.
+    bool parseBraces(int &min, int &max) {
+        size_t p = m_pos + 1;
+        auto number = [&](int &v) {
+            size_t start = p;
+            v = 0;
+            while (p < m_p.size() && m_p[p] >= '0' && m_p[p] <= '9' && v <= kMaxRepeat) v = v * 10 + (m_p[p++] - '0');
+            return p > start;
+        };
+        if (!number(min)) return false;
+        max = min;
+        if (p < m_p.size() && m_p[p] == ',') {
+            p++;
+            if (!number(max)) max = -1;
+        }
+        if (p >= m_p.size() || m_p[p] != '}') return false;
+        m_pos = p + 1;
+        return true;
+    }
+
+    std::unique_ptr<Node> parseRepeat() {
+        auto atom = parseAtom();
+        if (!atom) return nullptr;
+        while (more()) {
+            int min, max;
+            char c = peek();
+            if (c == '*') { min = 0; max = -1; m_pos++; }
+            else if (c == '+') { min = 1; max = -1; m_pos++; }
+            else if (c == '?') { min = 0; max = 1; m_pos++; }
+            else if (c == '{' && parseBraces(min, max)) {}
+            else break;
+            if (min > kMaxRepeat || max > kMaxRepeat || (max >= 0 && max < min)) {
+                fail("bad repetition count");
+                return nullptr;
+            }
+            if (atom->kind == Node::LineStart || atom->kind == Node::LineEnd) {
+                fail("nothing to repeat");
+                return nullptr;
+            }
+            if (more() && peek() == '?') m_pos++;   // lazy: same set of matches
+            auto rep = std::make_unique<Node>(Node::Repeat);
+            rep->min = min;
+            rep->max = max;
+            rep->children.push_back(std::move(atom));
+            atom = std::move(rep);
+        }
+        return atom;
+    }
+
+    // \d \w \s and their negations; false for any other escape letter.
+    static bool perlClass(char c, Ranges &r) {
+        switch (c) {
+            case 'd': case 'D': r = {{'0', '9'}}; break;
+            case 'w': case 'W': r = {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}}; break;
+            case 's': case 'S': r = {{'\t', '\r'}, {' ', ' '}}; break;
+            default: return false;
+        }
+        if (c >= 'A' && c <= 'Z') r = complement(r);
+        return true;
+    }
+
+    // Character after a backslash, as a codepoint; -1 on error.
+    int64_t escapedChar() {
+        if (!more()) { fail("trailing backslash"); return -1; }
+        char c = m_p[m_pos];
+        switch (c) {
+            case 'n': m_pos++; return '\n';
+            case 't': m_pos++; return '\t';
+            case 'r': m_pos++; return '\r';
+            case 'f': m_pos++; return '\f';
+            case 'v': m_pos++; return '\v';
+            case '0': m_pos++; return 0;
+            case 'x': {
+                if (m_pos + 2 >= m_p.size()) { fail("bad \\x escape"); return -1; }
+                int v = 0;
+                for (int i = 1; i <= 2; ++i) {
+                    char h = m_p[m_pos + i];
+                    int d = (h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10
+                          : (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+                    if (d < 0) { fail("bad \\x escape"); return -1; }
+                    v = v * 16 + d;
+                }
+                m_pos += 3;
+                return v;
+            }
+            default: break;
+        }
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+            fail(std::string("unsupported escape \\") + c);
+            return -1;
+        }
+        return decodeChar();   // escaped punctuation or non-ASCII: itself
+    }
+
+    std::unique_ptr<Node> parseClass() {
+        m_pos++;   // '['
+        bool negate = more() && peek() == '^';
+        if (negate) m_pos++;
+        Ranges r;
+        bool first = true;
+        while (more() && (peek() != ']' || first)) {
+            first = false;
+            int64_t lo;
+            if (peek() == '\\') {
+                m_pos++;
+                Ranges perl;
+                if (more() && perlClass(peek(), perl)) {
+                    m_pos++;
+                    r.insert(r.end(), perl.begin(), perl.end());
+                    continue;
+                }
+                lo = escapedChar();
+                if (lo < 0) return nullptr;
+            } else {
+                lo = decodeChar();
+            }
+            int64_t hi = lo;
+            if (m_pos + 1 < m_p.size() && peek() == '-' && m_p[m_pos + 1] != ']') {
+                m_pos++;
+                if (peek() == '\\') {
+                    m_pos++;
+                    hi = escapedChar();
+                    if (hi < 0) return nullptr;
+                } else {
+                    hi = decodeChar();
+                }
+                if (hi < lo) {
+                    fail("bad class range");
+                    return nullptr;
+                }
+            }
+            r.push_back({static_cast<uint32_t>(lo), static_cast<uint32_t>(hi)});
+        }
+        if (!more()) {
+            fail("missing ]");
+            return nullptr;
+        }
+        m_pos++;   // ']'
+        normalize(r);
+        if (m_ci) addOtherCase(r);
+        if (negate) r = complement(r);
+        auto n = std::make_unique<Node>(Node::Class);
+        n->ranges = std::move(r);
+        return n;
+    }
+
+    std::unique_ptr<Node> parseAtom() {
+        char c = peek();
+        switch (c) {
+            case '(': {
+                m_pos++;
+                if (m_p.compare(m_pos, 2, "?:") == 0) {
+                    m_pos += 2;
+                } else if (more() && peek() == '?') {
+                    fail("unsupported group syntax");
+                    return nullptr;
+                }
+                auto inner = parseAlternate();
+                if (!inner) return nullptr;
+                if (!more() || peek() != ')') {
+                    fail("missing )");
+                    return nullptr;
+                }
+                m_pos++;
+                return inner;
+            }
+            case '[':
+                return parseClass();
+            case '.':
+                m_pos++;
+                return makeClass(complement({{'\n', '\n'}}));
+            case '^':
+                m_pos++;
+                return std::make_unique<Node>(Node::LineStart);
+            case '$':
+                m_pos++;
+                return std::make_unique<Node>(Node::LineEnd);
+            case '*': case '+': case '?':
+                fail("nothing to repeat");
+                return nullptr;
+            case '\\': {
+                m_pos++;
+                Ranges perl;
+                if (more() && perlClass(peek(), perl)) {
+                    m_pos++;
+                    auto n = std::make_unique<Node>(Node::Class);
+                    n->ranges = std::move(perl);
+                    return n;
+                }
+                int64_t cp = escapedChar();
+                if (cp < 0) return nullptr;
+                return makeClass({{static_cast<uint32_t>(cp), static_cast<uint32_t>(cp)}}, static_cast<int32_t>(cp));
+            }
+            default: {
+                uint32_t cp = decodeChar();
+                return makeClass({{cp, cp}}, static_cast<int32_t>(cp));
+            }
+        }
+    }
+
+    // ---- NFA construction: compile(node, next) returns the entry state of
+    // a fragment that continues with `next`; -1 once the pattern is too big.
+
+    int compileClass(const Node &n, int next) {
+        std::vector<ByteSequence> seqs;
+        for (const auto &range : n.ranges) utf8Split(range.first, range.second, seqs);
+        std::bitset<256> single;
+        std::vector<int> entries;
+        for (const auto &seq : seqs) {
+            if (seq.size() == 1) {
+                for (unsigned b = seq[0].first; b <= seq[0].second; ++b) single.set(b);
+                continue;
+            }
+            int s = next;
+            for (size_t i = seq.size(); i-- > 0;) {
+                std::bitset<256> set;
+                for (unsigned b = seq[i].first; b <= seq[i].second; ++b) set.set(b);
+                s = byteState(set, s);
+            }
+            entries.push_back(s);
+        }
+        if (single.any()) entries.push_back(byteState(single, next));
+        if (entries.empty()) return byteState(std::bitset<256>(), next);   // matches nothing
+        int s = entries.back();
+        for (size_t i = entries.size() - 1; i-- > 0;) s = m_re.addState(Regex::NfaState::Split, entries[i], s);
+        return s;
+    }
+
+    int byteState(const std::bitset<256> &set, int next) {
+        m_re.m_byteSets.push_back(set);
+        return m_re.addState(Regex::NfaState::Byte, next, -1, static_cast<int>(m_re.m_byteSets.size() - 1));
+    }
+
+    int compile(const Node &n, int next) {
+        if (m_re.m_nfa.size() > kMaxNfaStates) {
+            fail("pattern too large");
+            return -1;
+        }
+        switch (n.kind) {
+            case Node::Empty:
+                return next;
+            case Node::Class:
+                return compileClass(n, next);
+            case Node::LineStart:
+                return m_re.addState(Regex::NfaState::Bol, next);
+            case Node::LineEnd:
+                return m_re.addState(Regex::NfaState::Eol, next);
+            case Node::Concat: {
+                int s = next;
+                for (size_t i = n.children.size(); i-- > 0 && s >= 0;) s = compile(*n.children[i], s);
+                return s;
+            }
+            case Node::Alternate: {
+                int s = compile(*n.children.back(), next);
+                for (size_t i = n.children.size() - 1; i-- > 0 && s >= 0;) {
+                    int e = compile(*n.children[i], next);
+                    if (e < 0) return -1;
+                    s = m_re.addState(Regex::NfaState::Split, e, s);
+                }
+                return s;
+            }
+            case Node::Repeat: {
+                const Node &body = *n.children[0];
+                int tail = next;
+                if (n.max < 0) {
+                    // loop: L -> body -> L, or L -> next
+                    int loop = m_re.addState(Regex::NfaState::Split, -1, next);
+                    int entry = compile(body, loop);
+                    if (entry < 0) return -1;
+                    m_re.m_nfa[loop].out = entry;
+                    tail = loop;
+                } else {
+                    for (int i = n.min; i < n.max && tail >= 0; ++i) {
+                        int entry = compile(body, tail);
+                        if (entry < 0) return -1;
+                        tail = m_re.addState(Regex::NfaState::Split, entry, next);
+                    }
+                }
+                for (int i = 0; i < n.min && tail >= 0; ++i) tail = compile(body, tail);
+                return tail;
+            }
+        }
+        return -1;
+    }
+
+    // ---- Required literal: the longest string every match contains.
+
+    struct Literal {
+        bool exact = false;   // the node matches exactly `text`
+        std::string text;
+        std::string best;     // longest required substring
+    };
+
+    static void keepLonger(std::string &best, const std::string &candidate) {
+        if (candidate.size() > best.size()) best = candidate;
+    }
+
+    Literal literalOf(const Node &n) const {
+        Literal l;
+        switch (n.kind) {
+            case Node::Empty:
+            case Node::LineStart:
+            case Node::LineEnd:
+                l.exact = true;
+                break;
+            case Node::Class:
+                if (n.literal >= 0) {
+                    uint32_t cp = static_cast<uint32_t>(n.literal);
+                    if (m_ci && cp >= 'A' && cp <= 'Z') cp += 32;
+                    l.exact = true;
+                    appendUtf8(l.text, cp);
+                    l.best = l.text;
+                }
+                break;
+            case Node::Concat: {
+                std::string run;
+                l.exact = true;
+                for (const auto &child : n.children) {
+                    Literal c = literalOf(*child);
+                    if (c.exact) {
+                        run += c.text;
+                    } else {
+                        l.exact = false;
+                        keepLonger(l.best, run);
+                        keepLonger(l.best, c.best);
+                        run.clear();
+                    }
+                }
+                keepLonger(l.best, run);
+                if (l.exact) l.text = run;
+                break;
+            }
+            case Node::Repeat:
+                if (n.min >= 1) {
+                    Literal c = literalOf(*n.children[0]);
+                    l.best = c.exact ? c.text : c.best;
+                    if (c.exact && n.min == n.max && c.text.size() * n.min <= 256) {
+                        l.exact = true;
+                        for (int i = 0; i < n.min; ++i) l.text += c.text;
+                        l.best = l.text;
+                    }
+                }
+                break;
+            case Node::Alternate:
+                break;   // no single literal is required
+        }
+        return l;
+    }
+};
+
+Regex::Regex(const std::string &pattern, bool caseInsensitive) : m_caseInsensitive(caseInsensitive) {
+    RegexCompiler compiler(*this, pattern);
+    if (!compiler.run()) {
+        if (m_error.empty()) m_error = "invalid pattern";
+        m_nfa.clear();
+        return;
+    }
+    m_mark.assign(m_nfa.size(), 0);
+}
+
+int Regex::addState(NfaState::Op op, int out, int out1, int set) {
+    NfaState s;
+    s.op = op;
+    s.out = out;
+    s.out1 = out1;
+    s.set = set;
+    m_nfa.push_back(s);
+    return static_cast<int>(m_nfa.size() - 1);
+}
+
+static unsigned char foldAscii(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + 32) : c;
+}
+
+bool Regex::containsLiteral(const char *text, size_t length) const {
+    const size_t n = m_literal.size();
+    if (n == 0) return true;
+    if (n > length) return false;
+    const char *lit = m_literal.data();
+    if (!m_caseInsensitive) {
+        const char *p = text, *end = text + length - n + 1;
+        while (p < end) {
+            p = static_cast<const char*>(std::memchr(p, lit[0], end - p));
+            if (!p) return false;
+            if (std::memcmp(p + 1, lit + 1, n - 1) == 0) return true;
+            ++p;
+        }
+        return false;
+    }
+    // (?i): the literal is lowercase; look for either case of its first byte
+    unsigned char first = static_cast<unsigned char>(lit[0]);
+    unsigned char upper = (first >= 'a' && first <= 'z') ? static_cast<unsigned char>(first - 32) : first;
+    for (size_t i = 0; i + n <= length; ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c != first && c != upper) continue;
+        size_t k = 1;
+        while (k < n && foldAscii(static_cast<unsigned char>(text[i + k])) == static_cast<unsigned char>(lit[k])) k++;
+        if (k == n) return true;
+    }
+    return false;
+}
+
+// Follows epsilon edges from seeds. ^ passes when bol, $ when eol; a $ that
+// cannot be decided yet stays in the set, as do byte and match states.
+void Regex::closure(const std::vector<int> &seeds, bool bol, bool eol, std::vector<int> &out) {
+    out.clear();
+    if (++m_markGen == 0) {
+        std::fill(m_mark.begin(), m_mark.end(), 0);
+        m_markGen = 1;
+    }
+    std::vector<int> stack(seeds.rbegin(), seeds.rend());
+    while (!stack.empty()) {
+        int s = stack.back();
+        stack.pop_back();
+        if (s < 0 || m_mark[s] == m_markGen) continue;
+        m_mark[s] = m_markGen;
+        const NfaState &st = m_nfa[s];
+        switch (st.op) {
+            case NfaState::Split:
+                stack.push_back(st.out1);
+                stack.push_back(st.out);
+                break;
+            case NfaState::Bol:
+                if (bol) stack.push_back(st.out);
+                break;
+            case NfaState::Eol:
+                if (eol) stack.push_back(st.out);
+                else out.push_back(s);
+                break;
+            default:
+                out.push_back(s);
+        }
+    }
+    std::sort(out.begin(), out.end());
+}
+
+int Regex::intern(std::vector<int> &nfa, bool bol) {
+    nfa.push_back(bol ? -1 : -2);   // the flag is part of the key
+    auto found = m_dfaIndex.find(nfa);
+    if (found != m_dfaIndex.end()) return found->second;
+
+    if (m_dfa.size() >= kMaxDfaStates) {
+        // Cache full: start over. Callers only hold the index returned here.
+        m_dfa.clear();
+        m_dfaIndex.clear();
+    }
+    DfaState d;
+    d.bol = bol;
+    std::fill(std::begin(d.next), std::end(d.next), -1);
+    int id = static_cast<int>(m_dfa.size());
+    m_dfaIndex.emplace(nfa, id);
+    nfa.pop_back();
+    d.nfa = std::move(nfa);
+    m_dfa.push_back(std::move(d));
+    return id;
+}
+
+int Regex::startState() {
+    std::vector<int> set;
+    closure({m_start}, true, false, set);
+    for (int s : set) {
+        if (m_nfa[s].op == NfaState::Match) return kMatched;
+    }
+    return intern(set, true);
+}
+
+int Regex::step(int state, unsigned char byte) {
+    std::vector<int> current = m_dfa[state].nfa;
+    const bool bol = m_dfa[state].bol;
+    if (byte == '\n') {
+        // a pending $ holds right before a newline
+        std::vector<int> expanded;
+        closure(current, bol, true, expanded);
+        current.swap(expanded);
+    }
+    std::vector<int> targets;
+    for (int s : current) {
+        const NfaState &st = m_nfa[s];
+        if (st.op == NfaState::Match) return m_dfa[state].next[byte] = kMatched;
+        if (st.op == NfaState::Byte && m_byteSets[st.set][byte]) targets.push_back(st.out);
+    }
+    targets.push_back(m_start);   // unanchored: a match may begin anywhere
+    std::vector<int> next;
+    closure(targets, byte == '\n', false, next);
+    int result = kMatched;
+    if (std::none_of(next.begin(), next.end(), [&](int s) { return m_nfa[s].op == NfaState::Match; })) {
+        size_t before = m_dfa.size();
+        result = intern(next, byte == '\n');
+        // interning may have flushed the cache, taking `state` with it
+        if (m_dfa.size() < before) return result;
+    }
+    m_dfa[state].next[byte] = result;
+    return result;
+}
+
+bool Regex::matchesAtEnd(int state) {
+    DfaState &d = m_dfa[state];
+    if (d.endMatch < 0) {
+        std::vector<int> expanded;
+        closure(d.nfa, d.bol, true, expanded);
+        d.endMatch = std::any_of(expanded.begin(), expanded.end(),
+                                 [&](int s) { return m_nfa[s].op == NfaState::Match; });
+    }
+    return d.endMatch == 1;
+}
+
+bool Regex::search(const char *text, size_t length) {
+    if (!ok()) return false;
+    if (!containsLiteral(text, length)) return false;
+
+    int state = startState();
+    if (state == kMatched) return true;
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(text);
+    for (size_t i = 0; i < length; ++i) {
+        int next = m_dfa[state].next[p[i]];
+        if (next == -1) next = step(state, p[i]);
+        if (next == kMatched) return true;
+        state = next;
+    }
+    return matchesAtEnd(state);
+}
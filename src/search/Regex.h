@@ -0,0 +1,77 @@
+#ifndef REGEX_H
+#define REGEX_H
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Regular expression search in time linear in the text: the pattern is
+// compiled to a Thompson NFA over UTF-8 bytes, which is run as a DFA built
+// lazily, one state per set of NFA states, and cached across calls. There is
+// no backtracking, so no pattern can blow up on a long clip.
+//
+// Syntax: literals, . [...] [^...] \d \w \s \D \W \S, groups (...) (?:...),
+// alternation |, quantifiers * + ? {m} {m,} {m,n} (a trailing lazy ? is
+// accepted; only whether a match exists is reported), ^ and $ at line
+// boundaries, escapes \n \t \r \f \v \xHH, and a leading (?i) for
+// ASCII-case-insensitive matching. Backreferences and \b are not supported.
+//
+// Before the automaton runs, a literal that every match must contain (e.g.
+// "http" for https?://\S+) is looked up with a fast substring search, so most
+// records are rejected without running the DFA at all.
+//
+// Not thread-safe: search() fills the DFA cache. Use one Regex per thread.
+class Regex {
+public:
+    explicit Regex(const std::string &pattern, bool caseInsensitive = false);
+
+    bool ok() const { return m_error.empty(); }
+    const std::string &error() const { return m_error; }   // why the pattern did not compile
+
+    // Whether the pattern matches anywhere in text.
+    bool search(const char *text, size_t length);
+    bool search(const std::string &text) { return search(text.data(), text.size()); }
+
+    const std::string &requiredLiteral() const { return m_literal; }
+
+private:
+    struct NfaState {
+        enum Op { Byte, Split, Bol, Eol, Match } op;
+        int set = -1;    // Byte: index into m_byteSets
+        int out = -1;
+        int out1 = -1;   // Split: second branch
+    };
+    struct DfaState {
+        std::vector<int> nfa;   // sorted NFA states, epsilon closure applied
+        bool bol = false;       // at a line start: decides pending ^ assertions
+        int endMatch = -1;      // -1 unknown, else whether a match ends here at end of text
+        int next[256];          // -1 unknown, kMatched, or next DFA state
+    };
+
+    std::string m_error;
+    bool m_caseInsensitive;
+    std::string m_literal;   // required literal, folded to lowercase with (?i)
+    std::vector<NfaState> m_nfa;
+    std::vector<std::bitset<256>> m_byteSets;
+    int m_start = -1;
+
+    std::vector<DfaState> m_dfa;
+    std::map<std::vector<int>, int> m_dfaIndex;   // NFA set + bol flag -> DFA state
+    std::vector<uint32_t> m_mark;                 // closure bookkeeping, per NFA state
+    uint32_t m_markGen = 0;
+
+    friend class RegexCompiler;
+    int addState(NfaState::Op op, int out = -1, int out1 = -1, int set = -1);
+
+    bool containsLiteral(const char *text, size_t length) const;
+    void closure(const std::vector<int> &seeds, bool bol, bool eol, std::vector<int> &out);
+    int intern(std::vector<int> &nfa, bool bol);
+    int startState();
+    int step(int state, unsigned char byte);
+    bool matchesAtEnd(int state);
+};
+
+#endif // REGEX_H
@@ -0,0 +1,133 @@
+#include "SearchIndex.h"
+#include "BloomFilter.h"
+#include <algorithm>
+
+static void putVarint(std::string &out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static uint32_t getVarint(const char *&p) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t byte = static_cast<uint8_t>(*p++);
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) return value;
+    }
+}
+
+static size_t slotOf(uint32_t gram, size_t mask) {
+    return static_cast<size_t>(gram * 0x9E3779B97F4A7C15ull >> 32) & mask;
+}
+
+SearchIndex::Open &SearchIndex::open(uint32_t gram) {
+    if (m_open.size() * 2 >= m_slots.size()) {
+        // Keep the table at most half full.
+        m_slots.assign(m_slots.empty() ? 1024 : m_slots.size() * 2, -1);
+        const size_t mask = m_slots.size() - 1;
+        for (size_t i = 0; i < m_open.size(); ++i) {
+            size_t s = slotOf(m_open[i].gram, mask);
+            while (m_slots[s] >= 0) s = (s + 1) & mask;
+            m_slots[s] = static_cast<int32_t>(i);
+        }
+    }
+    const size_t mask = m_slots.size() - 1;
+    size_t s = slotOf(gram, mask);
+    while (m_slots[s] >= 0) {
+        if (m_open[m_slots[s]].gram == gram) return m_open[m_slots[s]];
+        s = (s + 1) & mask;
+    }
+    m_slots[s] = static_cast<int32_t>(m_open.size());
+    m_open.emplace_back();
+    m_open.back().gram = gram;
+    return m_open.back();
+}
+
+void SearchIndex::add(std::string_view text) {
+    const uint32_t id = m_documents++;
+    BloomFilter::forEachTrigram(text, [&](uint64_t g) {
+        Open &list = open(static_cast<uint32_t>(g));
+        if (list.count > 0 && list.last == id) return;   // already listed for this document
+        putVarint(list.bytes, list.count == 0 ? id : id - list.last);
+        list.last = id;
+        list.count++;
+    });
+}
+
+void SearchIndex::seal() {
+    std::sort(m_open.begin(), m_open.end(), [](const Open &a, const Open &b) { return a.gram < b.gram; });
+    size_t total = 0;
+    for (const Open &list : m_open) total += list.bytes.size();
+    m_postings.reserve(total);
+    m_lists.reserve(m_open.size());
+    for (const Open &list : m_open) {
+        m_lists.push_back({list.gram, list.count, m_postings.size()});
+        m_postings += list.bytes;
+    }
+    std::vector<Open>().swap(m_open);
+    std::vector<int32_t>().swap(m_slots);
+}
+
+size_t SearchIndex::bytes() const {
+    size_t open = 0;
+    for (const Open &list : m_open) open += sizeof(Open) + list.bytes.capacity();
+    return open + m_slots.capacity() * sizeof(int32_t) + m_lists.capacity() * sizeof(List) + m_postings.capacity();
+}
+
+const SearchIndex::List *SearchIndex::find(uint32_t gram) const {
+    auto it = std::lower_bound(m_lists.begin(), m_lists.end(), gram,
+                               [](const List &list, uint32_t g) { return list.gram < g; });
+    return it != m_lists.end() && it->gram == gram ? &*it : nullptr;
+}
+
+std::string_view SearchIndex::postings(const List &list) const {
+    const size_t end = &list + 1 == m_lists.data() + m_lists.size() ? m_postings.size() : (&list + 1)->offset;
+    return std::string_view(m_postings).substr(list.offset, end - list.offset);
+}
+
+// Intersects the needle's lists, rarest first, so the candidate set only
+// shrinks; later lists are decoded in step with it rather than expanded.
+void SearchIndex::candidates(std::string_view needle, std::vector<uint32_t> &out) const {
+    out.clear();
+    std::vector<const List *> lists;
+    bool missing = false;
+    BloomFilter::forEachTrigram(needle, [&](uint64_t g) {
+        const List *list = find(static_cast<uint32_t>(g));
+        if (!list) missing = true;
+        else lists.push_back(list);
+    });
+    if (missing || lists.empty()) return;   // some trigram occurs nowhere
+    std::sort(lists.begin(), lists.end(), [](const List *a, const List *b) {
+        return a->count < b->count || (a->count == b->count && a < b);
+    });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+
+    std::string_view first = postings(*lists[0]);
+    out.reserve(lists[0]->count);
+    const char *p = first.data();
+    uint32_t id = 0;
+    for (uint32_t i = 0; i < lists[0]->count; ++i) {
+        id += getVarint(p);
+        out.push_back(id);
+    }
+    for (size_t l = 1; l < lists.size() && !out.empty(); ++l) {
+        p = postings(*lists[l]).data();
+        uint32_t remaining = lists[l]->count;
+        uint32_t current = 0;
+        bool started = false;
+        size_t kept = 0;
+        for (uint32_t candidate : out) {
+            while (remaining > 0 && (!started || current < candidate)) {
+                current += getVarint(p);
+                started = true;
+                remaining--;
+            }
+            if (!started || current < candidate) break;   // list exhausted
+            if (current == candidate) out[kept++] = candidate;
+        }
+        out.resize(kept);
+    }
+}
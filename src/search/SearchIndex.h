@@ -0,0 +1,64 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Substring index over a set of documents, numbered 0, 1, 2, ... in the
+// order they are added. Every trigram (see BloomFilter::forEachTrigram)
+// has a postings list of the documents containing it, stored as varint
+// gaps between ascending ids, so a list costs about a byte per entry and
+// the documents themselves are never copied.
+//
+// A document holding a needle holds all of the needle's trigrams, so
+// candidates() returns every match plus the occasional document that has
+// the trigrams elsewhere; callers confirm each candidate against its text.
+//
+// Filled with add() and then sealed; a sealed index is immutable and may be
+// read from any number of threads.
+class SearchIndex {
+public:
+    SearchIndex() = default;
+
+    void add(std::string_view text);   // the next document
+    void seal();                       // packs the postings; no add() after
+
+    size_t size() const { return m_documents; }
+    size_t bytes() const;              // memory held by the postings
+
+    // Whether candidates() can narrow a search for needle; shorter needles
+    // have no trigram and every document is a candidate.
+    static bool indexable(std::string_view needle) { return needle.size() >= 3; }
+    // Ascending ids of the documents that may contain needle.
+    void candidates(std::string_view needle, std::vector<uint32_t> &out) const;
+
+private:
+    struct Open {                      // a list being filled
+        uint32_t gram = 0;
+        uint32_t count = 0;
+        uint32_t last = 0;             // id of the last document added
+        std::string bytes;             // varint gaps
+    };
+    struct List {                      // a sealed list: m_postings[offset, +length)
+        uint32_t gram;
+        uint32_t count;
+        uint64_t offset;
+    };
+
+    Open &open(uint32_t gram);
+    const List *find(uint32_t gram) const;
+    std::string_view postings(const List &list) const;
+
+    uint32_t m_documents = 0;
+    // Open addressing, keyed by gram; only used until seal().
+    std::vector<Open> m_open;
+    std::vector<int32_t> m_slots;      // index into m_open, -1 = free
+    // Sealed: lists sorted by gram, their bytes back to back.
+    std::vector<List> m_lists;
+    std::string m_postings;
+};
+
+#endif // SEARCH_INDEX_H
@@ -0,0 +1,57 @@
+#include "SearchSession.h"
+
+SearchSession::SearchSession(HistoryManager &history) : m_history(history) {}
+
+void SearchSession::cancel() {
+    ++m_ticket;
+}
+
+void SearchSession::reset() {
+    ++m_ticket;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_snapshot.reset();
+    m_steps.clear();
+}
+
+bool SearchSession::search(const std::string &query, size_t limit, std::vector<SearchHit> &out) {
+    const uint64_t ticket = ++m_ticket;
+    auto cancelled = [&] { return m_ticket.load(std::memory_order_relaxed) != ticket; };
+
+    auto snap = m_history.snapshot();
+    std::shared_ptr<const Step> base;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (snap != m_snapshot) {
+            m_snapshot = snap;
+            m_steps.clear();
+        }
+        // Keep the steps whose query is a prefix of this one; the last of
+        // them holds the smallest candidate set.
+        while (!m_steps.empty() && query.compare(0, m_steps.back()->query.size(), m_steps.back()->query) != 0) {
+            m_steps.pop_back();
+        }
+        if (!m_steps.empty()) base = m_steps.back();
+    }
+
+    if (query.empty()) {
+        return HistoryManager::rankFuzzy(snap->items, query, limit, nullptr, nullptr, cancelled, out);
+    }
+    if (base && base->query == query) {
+        return HistoryManager::rankFuzzy(snap->items, query, limit, &base->matched, nullptr, cancelled, out);
+    }
+
+    auto step = std::make_shared<Step>();
+    step->query = query;
+    if (!HistoryManager::rankFuzzy(snap->items, query, limit, base ? &base->matched : nullptr,
+                                   &step->matched, cancelled, out)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // A newer search may have moved on meanwhile; only extend a chain this
+    // query still belongs to.
+    if (m_snapshot == snap && (m_steps.empty() ? !base : m_steps.back() == base)) {
+        m_steps.push_back(std::move(step));
+    }
+    return true;
+}
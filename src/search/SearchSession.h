@@ -0,0 +1,44 @@
+#ifndef SEARCH_SESSION_H
+#define SEARCH_SESSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../history_manager/HistoryManager.h"
+
+// Search-as-you-type over a HistoryManager. A fuzzy match of a query is also
+// a match of every prefix of it, so the session remembers which items matched
+// each query typed so far: a query that extends one of them is only checked
+// against those candidates, and backspacing falls back to the candidates of
+// the shorter query. The candidates are dropped when the history changes.
+//
+// search() may be called from several threads. Each call supersedes the
+// ones still running, which notice within a few hundred items and return
+// false, so an outdated keystroke never delays the current one.
+class SearchSession {
+public:
+    explicit SearchSession(HistoryManager &history);
+
+    // Best `limit` fuzzy matches of query, best first (see fuzzySearch).
+    // Returns false if cancelled or superseded before it finished.
+    bool search(const std::string &query, size_t limit, std::vector<SearchHit> &out);
+    void cancel();   // stop the running search, if any
+    void reset();    // forget the remembered queries
+
+private:
+    struct Step {
+        std::string query;
+        std::vector<uint32_t> matched;   // indexes into the snapshot's items
+    };
+
+    HistoryManager &m_history;
+    std::atomic<uint64_t> m_ticket{0};   // bumped by every search and cancel
+    std::mutex m_mutex;                  // guards the members below
+    std::shared_ptr<const HistoryManager::Snapshot> m_snapshot;
+    std::vector<std::shared_ptr<const Step>> m_steps;   // each query extends the previous
+};
+
+#endif // SEARCH_SESSION_H
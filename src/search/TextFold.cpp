@@ -0,0 +1,141 @@
+#include "TextFold.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+struct FoldRange {
+    uint32_t first, last;
+    int32_t delta;
+    uint32_t step;   // 2: only every other character, from `first`
+};
+struct FoldExpansion {
+    uint32_t cp;
+    const char *key;   // UTF-8
+};
+struct FoldComposition {
+    uint32_t base, mark, composed;
+};
+
+#include "FoldTables.inc"
+
+void appendUtf8(std::string &out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Decodes the well-formed UTF-8 character at text[i]; 0 bytes if malformed.
+size_t decodeUtf8(const unsigned char *text, size_t length, size_t i, uint32_t &cp) {
+    unsigned char c = text[i];
+    size_t n = c >= 0xF0 && c <= 0xF4 ? 4 : c >= 0xE0 ? 3 : c >= 0xC2 && c <= 0xDF ? 2 : 0;
+    if (n == 0 || c >= 0xF5 || i + n > length) return 0;
+    cp = c & (0x7F >> n);
+    for (size_t k = 1; k < n; ++k) {
+        if ((text[i + k] & 0xC0) != 0x80) return 0;
+        cp = (cp << 6) | (text[i + k] & 0x3F);
+    }
+    static const uint32_t minimum[] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (cp < minimum[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return 0;
+    return n;
+}
+
+// Single-character key of cp, or -1 if cp has none in kFoldRanges.
+int64_t foldSingle(uint32_t cp) {
+    auto it = std::upper_bound(std::begin(kFoldRanges), std::end(kFoldRanges), cp,
+                               [](uint32_t v, const FoldRange &r) { return v < r.first; });
+    if (it == std::begin(kFoldRanges)) return -1;
+    --it;
+    if (cp > it->last || (cp - it->first) % it->step != 0) return -1;
+    return static_cast<int64_t>(cp) + it->delta;
+}
+
+const char *foldExpansion(uint32_t cp) {
+    auto it = std::lower_bound(std::begin(kFoldExpansions), std::end(kFoldExpansions), cp,
+                               [](const FoldExpansion &e, uint32_t v) { return e.cp < v; });
+    return (it != std::end(kFoldExpansions) && it->cp == cp) ? it->key : nullptr;
+}
+
+int64_t compose(uint32_t base, uint32_t mark) {
+    auto it = std::lower_bound(std::begin(kFoldCompositions), std::end(kFoldCompositions),
+                               std::make_pair(base, mark),
+                               [](const FoldComposition &c, const std::pair<uint32_t, uint32_t> &v) {
+                                   return c.base < v.first || (c.base == v.first && c.mark < v.second);
+                               });
+    if (it == std::end(kFoldCompositions) || it->base != base || it->mark != mark) return -1;
+    return it->composed;
+}
+
+} // namespace
+
+namespace text_fold {
+
+bool isOwnKey(const char *text, size_t length) {
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(text);
+    for (size_t i = 0; i < length; ++i) {
+        if (p[i] >= 0x80 || static_cast<unsigned char>(p[i] - 'A') < 26) return false;
+    }
+    return true;
+}
+
+void appendSearchKey(const char *text, size_t length, std::string &out) {
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(text);
+    out.reserve(out.size() + length);
+    size_t lastStart = 0;      // where the previous character's key starts in out
+    int64_t last = -1;         // that character, if a combining mark may join it
+    size_t i = 0;
+    while (i < length) {
+        unsigned char c = p[i];
+        if (c < 0x80) {
+            lastStart = out.size();
+            last = (c >= 'A' && c <= 'Z') ? c + 32 : c;
+            out += static_cast<char>(last);
+            i++;
+            continue;
+        }
+        uint32_t cp;
+        size_t n = decodeUtf8(p, length, i, cp);
+        if (n == 0) {
+            out += static_cast<char>(c);   // not UTF-8: keep the byte
+            last = -1;
+            i++;
+            continue;
+        }
+        i += n;
+        if (cp >= 0x300 && cp <= 0x36F && last >= 0) {
+            int64_t composed = compose(static_cast<uint32_t>(last), cp);
+            if (composed >= 0) {
+                out.resize(lastStart);
+                appendUtf8(out, static_cast<uint32_t>(composed));
+                last = composed;
+                continue;
+            }
+        }
+        lastStart = out.size();
+        int64_t single = foldSingle(cp);
+        if (single >= 0) {
+            appendUtf8(out, static_cast<uint32_t>(single));
+            last = single;
+        } else if (const char *expansion = foldExpansion(cp)) {
+            out += expansion;
+            last = -1;
+        } else {
+            out.append(text + i - n, n);
+            last = cp;
+        }
+    }
+}
+
+} // namespace text_fold
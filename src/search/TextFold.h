@@ -0,0 +1,34 @@
+#ifndef TEXT_FOLD_H
+#define TEXT_FOLD_H
+
+#include <cstddef>
+#include <string>
+
+// Search keys: text brought to NFKC form (compatibility characters such as
+// ligatures, fullwidth letters, superscripts and styled math letters become
+// their plain equivalents; a letter followed by a combining accent becomes
+// the precomposed letter) with simple Unicode case folding applied. Two
+// strings that differ only in those respects get the same key, so matching
+// keys byte for byte is a case- and form-insensitive comparison.
+//
+// The tables cover Latin, Greek, Cyrillic, Armenian, Georgian, Cherokee and
+// the common symbol blocks (see gen_fold_tables.py); other scripts pass
+// through unchanged, as do bytes that are not valid UTF-8.
+namespace text_fold {
+
+// Cheap pre-check: true when text is plain lowercase ASCII (no uppercase
+// letters, no bytes >= 0x80) and therefore its own key.
+bool isOwnKey(const char *text, size_t length);
+
+// Appends the key of text to out.
+void appendSearchKey(const char *text, size_t length, std::string &out);
+
+inline std::string searchKey(const std::string &text) {
+    std::string key;
+    appendSearchKey(text.data(), text.size(), key);
+    return key;
+}
+
+} // namespace text_fold
+
+#endif // TEXT_FOLD_H
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Generates FoldTables.inc for TextFold.cpp from Python's unicodedata.
+
+The search key of a character is its NFKC form with simple case folding
+applied to every resulting character. Only the scripts and symbol blocks
+clipboard text commonly uses are covered (Latin, Greek, Cyrillic, Armenian,
+Georgian, Cherokee, punctuation, letterlike and number forms, enclosed
+alphanumerics, Latin ligatures, fullwidth forms, mathematical alphanumerics);
+CJK and Hangul are left as they are.
+
+    python3 gen_fold_tables.py > FoldTables.inc
+"""
+import unicodedata as ud
+
+BLOCKS = [
+    (0x0080, 0x058F), (0x10A0, 0x10FF), (0x13A0, 0x13FF), (0x1C80, 0x1CBF),
+    (0x1D00, 0x1DBF), (0x1E00, 0x1FFF), (0x2000, 0x24FF), (0x2C00, 0x2CFF),
+    (0xA640, 0xA69F), (0xA720, 0xA7FF), (0xAB30, 0xAB6F), (0xFB00, 0xFB06),
+    (0xFF00, 0xFFEF), (0x1D400, 0x1D7FF), (0x1F100, 0x1F1FF),
+]
+
+
+def fold(c):
+    """Simple case folding: casefold() unless that expands (e.g. ß -> ss)."""
+    for f in (c.casefold(), c.lower()):
+        if len(f) == 1:
+            return f
+    return c
+
+
+def key(c):
+    return ''.join(fold(x) for x in ud.normalize('NFKC', c))
+
+
+def c_string(s):
+    return '"' + ''.join('\\x%02x' % b for b in s.encode('utf-8')) + '"'
+
+
+def emit(name, rows, per_line):
+    print(name + ' = {')
+    for i in range(0, len(rows), per_line):
+        print('    ' + ' '.join(r + ',' for r in rows[i:i + per_line]))
+    print('};')
+
+
+def main():
+    single, multi = {}, {}
+    for lo, hi in BLOCKS:
+        for cp in range(lo, hi + 1):
+            c = chr(cp)
+            if ud.category(c) in ('Cn', 'Cs'):
+                continue
+            k = key(c)
+            if k == c:
+                continue
+            if len(k) == 1:
+                single[cp] = ord(k)
+            else:
+                multi[cp] = k
+
+    # Runs of characters shifted by the same delta, every one (step 1) or
+    # every other one (step 2, alternating upper/lower case pairs).
+    items = sorted(single.items())
+    ranges = []
+    i = 0
+    while i < len(items):
+        cp, mapped = items[i]
+        delta = mapped - cp
+        best = (i, 1)
+        for step in (1, 2):
+            j = i
+            while (j + 1 < len(items) and items[j + 1][0] == items[j][0] + step
+                   and items[j + 1][1] - items[j + 1][0] == delta):
+                j += 1
+            if j > best[0]:
+                best = (j, step)
+        j, step = best
+        ranges.append('{0x%04X, 0x%04X, %d, %d}' % (cp, items[j][0], delta, step))
+        i = j + 1
+
+    # Folded base + combining mark -> key of the precomposed character.
+    compositions = {}
+    for cp in range(0xC0, 0x2000):
+        c = chr(cp)
+        d = ud.normalize('NFD', c)
+        if len(d) != 2 or not 0x300 <= ord(d[1]) <= 0x36F:
+            continue
+        base, composed = key(d[0]), key(c)
+        if len(base) == 1 and len(composed) == 1:
+            compositions[(ord(base), ord(d[1]))] = ord(composed)
+
+    print('// Generated by gen_fold_tables.py from Unicode %s data. Do not edit.' % ud.unidata_version)
+    print()
+    emit('static const FoldRange kFoldRanges[]', ranges, 4)
+    print()
+    emit('static const FoldExpansion kFoldExpansions[]',
+         ['{0x%04X, %s}' % (cp, c_string(k)) for cp, k in sorted(multi.items())], 3)
+    print()
+    emit('static const FoldComposition kFoldCompositions[]',
+         ['{0x%04X, 0x%04X, 0x%04X}' % (b, m, c) for (b, m), c in sorted(compositions.items())], 4)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,181 @@
+#include "Stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace stats {
+
+static bool enabledByEnvironment() {
+    const char *value = std::getenv("CLIPBOARD_STATS");
+    return value && *value && std::strcmp(value, "0") != 0;
+}
+
+std::atomic<bool> g_enabled{enabledByEnvironment()};
+
+void setEnabled(bool on) { g_enabled.store(on, std::memory_order_relaxed); }
+
+static int highestBit(uint64_t value) {   // value > 0
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanReverse64(&bit, value);
+    return static_cast<int>(bit);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+// Values below 2^(kSubBits + 1) have a bucket each. Above, a value whose top
+// bit is b lands in row b - kSubBits, at the column given by the kSubBits
+// bits after b.
+size_t Histogram::bucketOf(uint64_t nanos) {
+    if (nanos < (uint64_t(1) << kSubBits)) return static_cast<size_t>(nanos);
+    const int shift = highestBit(nanos) - kSubBits;
+    return (size_t(shift + 1) << kSubBits) + static_cast<size_t>((nanos >> shift) & ((1u << kSubBits) - 1));
+}
+
+uint64_t Histogram::highestIn(size_t bucket) {
+    if (bucket < (size_t(1) << kSubBits)) return bucket;
+    const int shift = static_cast<int>(bucket >> kSubBits) - 1;
+    const uint64_t lowest = ((uint64_t(1) << kSubBits) + (bucket & ((1u << kSubBits) - 1))) << shift;
+    return lowest + ((uint64_t(1) << shift) - 1);
+}
+
+Histogram::~Histogram() { delete[] m_buckets.load(); }
+
+void Histogram::record(uint64_t nanos) {
+    auto *buckets = m_buckets.load(std::memory_order_acquire);
+    if (!buckets) {
+        auto *fresh = new std::atomic<uint64_t>[kBuckets]();
+        if (m_buckets.compare_exchange_strong(buckets, fresh, std::memory_order_acq_rel)) buckets = fresh;
+        else delete[] fresh;   // another thread was first; buckets is theirs
+    }
+    buckets[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(nanos, std::memory_order_relaxed);
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (nanos > max && !m_max.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {}
+}
+
+Histogram::Summary Histogram::summary() const {
+    Summary s;
+    const auto *buckets = m_buckets.load(std::memory_order_acquire);
+    if (!buckets) return s;
+    std::vector<uint64_t> counts(kBuckets);
+    for (size_t i = 0; i < kBuckets; ++i) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        s.count += counts[i];
+    }
+    s.sumNanos = m_sum.load(std::memory_order_relaxed);
+    s.maxNanos = m_max.load(std::memory_order_relaxed);
+    if (s.count == 0) return s;
+
+    auto quantile = [&](double q) {
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(s.count))));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(highestIn(i), s.maxNanos);
+        }
+        return s.maxNanos;
+    };
+    s.p50 = quantile(0.5);
+    s.p90 = quantile(0.9);
+    s.p99 = quantile(0.99);
+    s.p999 = quantile(0.999);
+    return s;
+}
+
+void Histogram::reset() {
+    if (auto *buckets = m_buckets.load(std::memory_order_acquire)) {
+        for (size_t i = 0; i < kBuckets; ++i) buckets[i].store(0, std::memory_order_relaxed);
+    }
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+void Gauge::adjust(int64_t delta) {
+    raiseMax(m_value.fetch_add(delta, std::memory_order_relaxed) + delta);
+}
+
+void Gauge::store(int64_t value) {
+    m_value.store(value, std::memory_order_relaxed);
+    raiseMax(value);
+}
+
+void Gauge::raiseMax(int64_t value) {
+    int64_t max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+}
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Histogram>> histograms;
+    std::vector<std::unique_ptr<Counter>> counters;
+    std::vector<std::unique_ptr<Gauge>> gauges;
+};
+
+// Never destroyed: metrics are referenced from statics and from threads
+// that may still be running while the process exits.
+Registry &registry() {
+    static Registry *r = new Registry;
+    return *r;
+}
+
+template <typename Metric>
+Metric &lookup(std::vector<std::unique_ptr<Metric>> &list, const std::string &name) {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    for (auto &metric : list) {
+        if (metric->name() == name) return *metric;
+    }
+    list.push_back(std::make_unique<Metric>(name));
+    return *list.back();
+}
+
+template <typename Entry>
+void sortByName(std::vector<Entry> &entries) {
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.name < b.name; });
+}
+
+} // namespace
+
+Histogram &histogram(const std::string &name) { return lookup(registry().histograms, name); }
+Counter &counter(const std::string &name) { return lookup(registry().counters, name); }
+Gauge &gauge(const std::string &name) { return lookup(registry().gauges, name); }
+
+Report report() {
+    Report r;
+    r.enabled = enabled();
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto &h : reg.histograms) {
+        auto summary = h->summary();
+        if (summary.count > 0) r.latencies.push_back({h->name(), summary});
+    }
+    for (const auto &c : reg.counters) {
+        if (c->value() > 0) r.counters.push_back({c->name(), c->value()});
+    }
+    for (const auto &g : reg.gauges) {
+        if (g->max() > 0 || g->value() != 0) r.gauges.push_back({g->name(), g->value(), g->max()});
+    }
+    sortByName(r.latencies);
+    sortByName(r.counters);
+    sortByName(r.gauges);
+    return r;
+}
+
+void reset() {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto &h : reg.histograms) h->reset();
+    for (auto &c : reg.counters) c->reset();
+    for (auto &g : reg.gauges) g->reset();
+}
+
+} // namespace stats
@@ -0,0 +1,179 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Process-wide latency histograms, counters and gauges for the store, the
+// clipboard monitor, the daemon and the addon. Collection is off unless the
+// CLIPBOARD_STATS environment variable is set to something other than "0",
+// or setEnabled(true) is called; while off, a probe is one relaxed atomic
+// load and a branch, no clock is read and histograms hold no memory.
+//
+// Metrics are registered by name, "<module>.<what>", and live until the
+// process exits, so the code they measure keeps a reference:
+//
+//     static stats::Histogram &loadTime = stats::histogram("history.load");
+//     ...
+//     stats::Timer timer(loadTime);
+//
+// Recording is lock-free. report() reads while other threads record, so a
+// report taken under load may miss the operations in flight.
+namespace stats {
+
+extern std::atomic<bool> g_enabled;
+inline bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+void setEnabled(bool on);
+
+inline uint64_t nowNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// HDR-style histogram of nanoseconds. A value's bucket is given by its top
+// kSubBits + 1 significant bits, so a bucket is never wider than 1/16 of the
+// values in it (about 6% error) anywhere from 1 ns to the 64-bit limit. The
+// buckets are allocated on the first record().
+class Histogram {
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr size_t kBuckets = size_t(64 - kSubBits + 1) << kSubBits;
+
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t sumNanos = 0;
+        uint64_t maxNanos = 0;
+        // Upper bounds of the buckets holding these quantiles.
+        uint64_t p50 = 0, p90 = 0, p99 = 0, p999 = 0;
+    };
+
+    explicit Histogram(std::string name) : m_name(std::move(name)) {}
+    ~Histogram();
+    Histogram(const Histogram&) = delete;
+    Histogram &operator=(const Histogram&) = delete;
+
+    const std::string &name() const { return m_name; }
+    void record(uint64_t nanos);
+    Summary summary() const;
+    void reset();
+
+    static size_t bucketOf(uint64_t nanos);
+    static uint64_t highestIn(size_t bucket);   // largest value that maps to bucket
+
+private:
+    std::string m_name;
+    std::atomic<std::atomic<uint64_t>*> m_buckets{nullptr};
+    std::atomic<uint64_t> m_sum{0};
+    std::atomic<uint64_t> m_max{0};
+};
+
+class Counter {
+public:
+    explicit Counter(std::string name) : m_name(std::move(name)) {}
+    const std::string &name() const { return m_name; }
+    void add(uint64_t n = 1) {
+        if (enabled()) m_value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+    void reset() { m_value.store(0, std::memory_order_relaxed); }
+
+private:
+    std::string m_name;
+    std::atomic<uint64_t> m_value{0};
+};
+
+// A level such as a queue depth: the current value and the highest seen.
+class Gauge {
+public:
+    explicit Gauge(std::string name) : m_name(std::move(name)) {}
+    const std::string &name() const { return m_name; }
+    void set(int64_t value) {
+        if (enabled()) store(value);
+    }
+    void adjust(int64_t delta);   // unconditional, see Depth
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+    int64_t max() const { return m_max.load(std::memory_order_relaxed); }
+    void reset() { m_max.store(value(), std::memory_order_relaxed); }   // the level itself stays
+
+private:
+    std::string m_name;
+    std::atomic<int64_t> m_value{0};
+    std::atomic<int64_t> m_max{0};
+
+    void store(int64_t value);
+    void raiseMax(int64_t value);
+};
+
+// The same metric for the same name, created on first use.
+Histogram &histogram(const std::string &name);
+Counter &counter(const std::string &name);
+Gauge &gauge(const std::string &name);
+
+// Records the time from construction to destruction, if stats were enabled
+// at construction.
+class Timer {
+public:
+    explicit Timer(Histogram &histogram) : m_histogram(enabled() ? &histogram : nullptr) {
+        if (m_histogram) m_start = nowNanos();
+    }
+    ~Timer() {
+        if (m_histogram) m_histogram->record(nowNanos() - m_start);
+    }
+    Timer(const Timer&) = delete;
+    Timer &operator=(const Timer&) = delete;
+
+private:
+    Histogram *m_histogram;
+    uint64_t m_start = 0;
+};
+
+// Counts the caller into a queue gauge until leave() or destruction. Whether
+// it counts is decided once, so the gauge stays balanced when stats are
+// switched on or off meanwhile.
+class Depth {
+public:
+    explicit Depth(Gauge &gauge) : m_gauge(enabled() ? &gauge : nullptr) {
+        if (m_gauge) m_gauge->adjust(1);
+    }
+    ~Depth() { leave(); }
+    void leave() {
+        if (m_gauge) m_gauge->adjust(-1);
+        m_gauge = nullptr;
+    }
+    Depth(const Depth&) = delete;
+    Depth &operator=(const Depth&) = delete;
+
+private:
+    Gauge *m_gauge;
+};
+
+struct Report {
+    bool enabled = false;
+    struct Latency {
+        std::string name;
+        Histogram::Summary summary;
+    };
+    struct Count {
+        std::string name;
+        uint64_t value;
+    };
+    struct Level {
+        std::string name;
+        int64_t value;
+        int64_t max;
+    };
+    std::vector<Latency> latencies;   // each list sorted by name; metrics
+    std::vector<Count> counters;      // that never recorded anything are
+    std::vector<Level> gauges;        // left out
+};
+
+Report report();
+void reset();   // clears histograms, counters and gauge maxima
+
+} // namespace stats
+
+#endif // STATS_H
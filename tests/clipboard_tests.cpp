@@ -0,0 +1,987 @@
+// Unit tests for clipboard_core, run by ctest (see CMakeLists.txt).
+//
+//   clipboard_tests [name]
+//
+// Runs every test, or those whose name contains name. A failed check is
+// reported with its file and line and the run goes on; the exit status is
+// the number of failed tests. Tests that touch the disk get a fresh data
+// directory under the system's temp directory, removed afterwards.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cli/CLI.h"
+#include "daemon/Daemon.h"
+#include "history_manager/BlobStore.h"
+#include "history_manager/HistoryManager.h"
+#include "history_manager/Timestamp.h"
+#include "import_export/Exporter.h"
+#include "import_export/Importer.h"
+#include "search/FuzzyMatcher.h"
+#include "search/Regex.h"
+#include "search/SearchIndex.h"
+#include "search/TextFold.h"
+
+namespace fs = std::filesystem;
+
+static int g_checksFailed = 0;
+
+static void check(bool ok, const char *what, const char *file, int line) {
+    if (ok) return;
+    std::cerr << file << ":" << line << ": check failed: " << what << "\n";
+    g_checksFailed++;
+}
+
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) check((a) == (b), #a " == " #b, __FILE__, __LINE__)
+
+// A data directory of its own for one test.
+class TempDir {
+public:
+    TempDir() {
+        static std::atomic<uint64_t> counter{0};
+        m_path = fs::temp_directory_path() /
+                 ("clipboard_tests_" + std::to_string(timestamp::nowMicros()) + "_" + std::to_string(counter++));
+        fs::create_directories(m_path);
+    }
+    ~TempDir() {
+        std::error_code ec;
+        fs::remove_all(m_path, ec);
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir &operator=(const TempDir&) = delete;
+
+    std::string path() const { return m_path.string(); }
+    std::string file(const std::string &name) const { return (m_path / name).string(); }
+
+private:
+    fs::path m_path;
+};
+
+static void writeFile(const std::string &path, const std::string &bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+static std::string readFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream bytes;
+    bytes << in.rdbuf();
+    return bytes.str();
+}
+
+static std::vector<std::string> contents(const std::vector<HistoryItem> &items) {
+    std::vector<std::string> out;
+    for (const auto &it : items) out.push_back(it.content);
+    return out;
+}
+
+static std::vector<std::string> contents(const std::vector<SearchHit> &hits) {
+    std::vector<std::string> out;
+    for (const auto &hit : hits) out.push_back(hit.item.content);
+    return out;
+}
+
+// An item with a fixed time, for tests that filter or order by it.
+static HistoryItem dated(int64_t time, const std::string &content, bool pinned = false,
+                         const std::string &source = "") {
+    HistoryItem it;
+    it.time = time;
+    it.content = content;
+    it.pinned = pinned;
+    it.source = source;
+    return it;
+}
+
+// ---------- Regex ----------
+
+// Every pattern of the supported syntax against texts chosen to hit and miss
+// it, with std::regex (ECMAScript, ^ and $ at line boundaries) as the
+// reference. The texts are ASCII without \r, where the two agree on what
+// . and $ mean.
+static void testRegexMatchesStdRegex() {
+    const char *patterns[] = {
+        "abc", "a.c", "^abc", "abc$", "^$", "a*", "ab+c", "colou?r", "a{3}", "a{2,}", "x{1,3}y",
+        "[abc]+d", "[^0-9]", "[a-f0-9]{4}", "\\d+", "\\w+@\\w+\\.com", "\\s\\S", "\\D\\W", "(ab)+c",
+        "(?:foo|bar)baz", "cat|dog|bird", "^(a|b)*$", "https?://\\S+", "\\x41B", "a\\tb", "line\\nnext",
+        "a.*?b", "(x|y)+?z", "[.]", "\\.", "a\\*b", "^\\s*#", "end$", "[A-Z][a-z]+ [A-Z][a-z]+",
+        "(a|ab)(c|bcd)(d*)", "(((a)))", "a||b", "[-a]", "[a-]", "[\\d.]+"};
+    const char *texts[] = {
+        "", "abc", "xabcx", "ac", "abbbc", "aaa", "aa", "color", "colour", "colouur", "xxy", "xxxxy",
+        "aabbd", "123", "abc123", "deadbeef", "user@host.com", "user@host.org", "a b", "ab", "ababc",
+        "foobaz", "barbaz", "bazfoo", "hot dog", "birds", "abba", "abca", "see https://example.com/x",
+        "http:// nothing", "AB", "a\tb", "line\nnext", "axxxb", "xyxyz", "1.5", "a*b", "  # comment",
+        "code\n# comment", "the end", "the end\nmore", "Ada Lovelace", "ada lovelace", "abcd", "-", "x\ny\n"};
+    for (const char *pattern : patterns) {
+        Regex re(pattern);
+        CHECK(re.ok());
+        const std::regex reference(pattern, std::regex::ECMAScript | std::regex::multiline);
+        for (const char *text : texts) {
+            const bool expected = std::regex_search(text, reference);
+            if (re.search(text) != expected) {
+                std::cerr << "  /" << pattern << "/ on \"" << text << "\": expected " << expected << "\n";
+                CHECK(re.search(text) == expected);
+            }
+        }
+    }
+}
+
+static void testRegexCaseInsensitive() {
+    const char *patterns[] = {"hello", "[a-c]+x", "H[^E]LLO", "\\w+ WORLD"};
+    const char *texts[] = {"HELLO", "hello", "HeLLo there", "ABCX", "abcx", "HXLLO", "hello world", "HELL"};
+    for (const char *pattern : patterns) {
+        Regex re(pattern, true);
+        Regex inline_(std::string("(?i)") + pattern);
+        const std::regex reference(pattern, std::regex::ECMAScript | std::regex::icase);
+        for (const char *text : texts) {
+            const bool expected = std::regex_search(text, reference);
+            CHECK_EQ(re.search(text), expected);
+            CHECK_EQ(inline_.search(text), expected);
+        }
+    }
+}
+
+static void testRegexUtf8AndErrors() {
+    // . and classes take a whole UTF-8 character, not a byte.
+    CHECK(Regex("^a.b$").search("a\xC3\xA9" "b"));
+    CHECK(!Regex("^a..b$").search("a\xC3\xA9" "b"));
+    CHECK(Regex("^[\xC3\xA0-\xC3\xBF]+$").search("\xC3\xA9\xC3\xA8"));
+    CHECK_EQ(Regex("https?://\\S+").requiredLiteral(), std::string("http"));
+
+    const char *invalid[] = {"(abc", "abc)", "[abc", "a{2,1}", "*a", "\\1", "a\\"};
+    for (const char *pattern : invalid) {
+        Regex re(pattern);
+        CHECK(!re.ok());
+        CHECK(!re.error().empty());
+    }
+}
+
+// ---------- TextFold ----------
+
+static void testTextFoldCase() {
+    using text_fold::searchKey;
+    CHECK_EQ(searchKey("Hello World"), std::string("hello world"));
+    CHECK_EQ(searchKey("\xC3\x84PFEL"), std::string("\xC3\xA4pfel"));                     // ÄPFEL
+    CHECK_EQ(searchKey("\xCE\xA3\xCE\x9F\xCE\xA6\xCE\x99\xCE\x91"),                         // ΣΟΦΙΑ
+             std::string("\xCF\x83\xCE\xBF\xCF\x86\xCE\xB9\xCE\xB1"));
+    CHECK_EQ(searchKey("\xCF\x82"), std::string("\xCF\x83"));                               // final sigma
+    CHECK_EQ(searchKey("\xD0\x9C\xD0\x9E\xD0\xA1\xD0\x9A\xD0\x92\xD0\x90"),                 // МОСКВА
+             std::string("\xD0\xBC\xD0\xBE\xD1\x81\xD0\xBA\xD0\xB2\xD0\xB0"));
+
+    CHECK(text_fold::isOwnKey("plain text 123", 14));
+    CHECK(!text_fold::isOwnKey("Plain", 5));
+    CHECK(!text_fold::isOwnKey("caf\xC3\xA9", 5));
+    CHECK_EQ(searchKey("plain text 123"), std::string("plain text 123"));
+}
+
+static void testTextFoldNfkc() {
+    using text_fold::searchKey;
+    CHECK_EQ(searchKey("\xEF\xAC\x81" "le"), std::string("file"));                             // ﬁle
+    CHECK_EQ(searchKey("\xEF\xBC\xA1\xEF\xBC\xA2\xEF\xBC\xA3"), std::string("abc"));        // ＡＢＣ
+    CHECK_EQ(searchKey("x\xC2\xB2"), std::string("x2"));                                      // x²
+    CHECK_EQ(searchKey("\xF0\x9D\x90\x80"), std::string("a"));                                // 𝐀
+    CHECK_EQ(searchKey("Cafe\xCC\x81"), std::string("caf\xC3\xA9"));                          // e + ◌́
+    CHECK_EQ(searchKey("CAF\xC3\x89"), searchKey("cafe\xCC\x81"));
+    // Bytes that are not UTF-8 pass through unchanged.
+    CHECK_EQ(searchKey(std::string("a\xFF" "b\xC3", 4)), std::string("a\xFF" "b\xC3", 4));
+}
+
+// ---------- SearchIndex ----------
+
+static void testSearchIndexCandidates() {
+    const std::vector<std::string> docs = {"the quick brown fox", "lazy dog", "quick quick", "brown",
+                                           "", "xyz", "foxtrot quickly"};
+    SearchIndex index;
+    for (const auto &doc : docs) index.add(doc);
+    index.seal();
+    CHECK_EQ(index.size(), docs.size());
+
+    for (const char *needle : {"quick", "fox", "brown", "dog", "xyz", "zzz", "ick qu"}) {
+        std::vector<uint32_t> candidates;
+        index.candidates(needle, candidates);
+        CHECK(std::is_sorted(candidates.begin(), candidates.end()));
+        for (uint32_t id = 0; id < docs.size(); ++id) {
+            const bool listed = std::binary_search(candidates.begin(), candidates.end(), id);
+            if (docs[id].find(needle) != std::string::npos) CHECK(listed);
+        }
+    }
+    std::vector<uint32_t> candidates;
+    index.candidates("quick", candidates);
+    CHECK((candidates == std::vector<uint32_t>{0, 2, 6}));
+    index.candidates("zzz", candidates);
+    CHECK(candidates.empty());
+}
+
+// HistoryManager::search goes through a text index kept per snapshot and
+// extended as items are added; after every kind of change it must return
+// exactly the items a scan finds.
+static void testHistorySearchAfterChanges() {
+    TempDir dir;
+    HistoryManager history(dir.path());
+    auto expectSearch = [&](const std::string &keyword) {
+        std::vector<std::string> expected;
+        const std::string key = text_fold::searchKey(keyword);
+        for (const auto &it : history.readHistory()) {
+            if (text_fold::searchKey(it.content).find(key) != std::string::npos) expected.push_back(it.content);
+        }
+        const auto found = history.search(keyword);
+        CHECK(contents(found) == expected);
+        return found;
+    };
+
+    for (const char *text : {"alpha needle one", "beta", "gamma NEEDLE two", "delta", "needle three"})
+        history.addItem(text, "test");
+    expectSearch("needle");
+    expectSearch("needle");   // the second search builds the index
+
+    history.addItem("epsilon needle four", "test");
+    CHECK_EQ(expectSearch("needle").size(), size_t(4));
+    CHECK(expectSearch("epsilon").size() == 1);
+
+    CHECK(history.pinItem(3));   // "gamma NEEDLE two"
+    auto found = expectSearch("needle");
+    CHECK(std::count_if(found.begin(), found.end(), [](const HistoryItem &it) { return it.pinned; }) == 1);
+
+    CHECK(history.deleteItem(0));   // "epsilon needle four"
+    CHECK_EQ(expectSearch("needle").size(), size_t(3));
+    CHECK(expectSearch("epsilon").empty());
+
+    history.addItem("zeta needle five", "test");
+    CHECK_EQ(expectSearch("needle").size(), size_t(4));
+    expectSearch("ta");   // too short for the index: scanned
+}
+
+// ---------- Journal ----------
+
+static void testJournalUndoRedoAcrossReload() {
+    TempDir dir;
+    {
+        HistoryManager history(dir.path());
+        for (const char *text : {"first", "second", "third"}) history.addItem(text);
+        CHECK(history.deleteItem(1));   // "second"
+        CHECK(history.pinItem(0));      // "third"
+        CHECK(history.setSlot(3, "slot text"));
+    }
+    HistoryManager history(dir.path());
+    CHECK((contents(history.readHistory()) == std::vector<std::string>{"third", "first"}));
+
+    CHECK(history.undo());   // the slot write
+    CHECK(!history.getSlot(3));
+    CHECK(history.undo());   // the pin
+    CHECK(!history.readHistory()[0].pinned);
+    CHECK(history.undo());   // the delete: back in front
+    CHECK((contents(history.readHistory()) == std::vector<std::string>{"second", "third", "first"}));
+    CHECK(!history.undo());
+
+    HistoryManager reloaded(dir.path());
+    CHECK(reloaded.redo());   // the delete again
+    CHECK((contents(reloaded.readHistory()) == std::vector<std::string>{"third", "first"}));
+    CHECK(reloaded.redo());
+    CHECK(reloaded.readHistory()[0].pinned);
+    CHECK(reloaded.redo());
+    CHECK(reloaded.getSlot(3) == std::optional<std::string>("slot text"));
+    CHECK(!reloaded.redo());
+}
+
+// ---------- history.txt ----------
+
+static void testHistoryFileRoundTrip() {
+    TempDir dir;
+    std::vector<HistoryItem> items(4);
+    items[0].time = 1700000000000003;
+    items[0].content = "newest";
+    items[0].pinned = true;
+    items[0].source = "clipboard";
+    items[1].time = 1700000000000002;
+    items[1].content = "multi\nline\n\nEND_CONTENT\n=== ENTRY END ===\ntext";
+    items[2].time = 1700000000000001;
+    items[2].content = "crlf\r\nkept\r\n";
+    items[2].source = "cli";
+    items[3].time = 1700000000000000;
+    items[3].content = "<b>oldest</b>";
+    items[3].mime = "text/html";
+    {
+        HistoryManager history(dir.path());
+        CHECK(history.writeHistory(items));
+    }
+    HistoryManager history(dir.path());
+    const auto loaded = history.readHistory();
+    CHECK_EQ(loaded.size(), items.size());
+    for (size_t i = 0; i < std::min(loaded.size(), items.size()); ++i) {
+        CHECK_EQ(loaded[i].time, items[i].time);
+        CHECK_EQ(loaded[i].content, items[i].content);
+        CHECK_EQ(loaded[i].pinned, items[i].pinned);
+        CHECK_EQ(loaded[i].source, items[i].source);
+        CHECK_EQ(loaded[i].mime, items[i].mime);
+        CHECK_EQ(loaded[i].size, items[i].content.size());
+    }
+    CHECK(loaded.size() == 4 && loaded[3].type() == ItemType::Html);
+    // The line count is read back; the preview is taken from the content.
+    CHECK(loaded.size() == 4 && loaded[1].preview == "multi" && loaded[1].lineCount == 6);
+
+    // Appending keeps what is there; a fresh reader sees both.
+    std::vector<HistoryItem> more(1);
+    more[0].content = "appended";
+    CHECK(history.append(std::move(more)));
+    HistoryManager reader(dir.path());
+    const auto all = reader.readHistory();
+    CHECK(all.size() == 5 && all[0].content == "appended" && all[1].content == "newest");
+}
+
+// Files written before the order header and TIME_US: newest first, times as
+// local text, no CONTENT_LENGTH in the oldest ones, and \r\n line ends from
+// text-mode writes on Windows.
+static void testLegacyHistoryFile() {
+    const std::string legacy =
+        "=== ENTRY START ===\n"
+        "TIMESTAMP: 2024-03-02 10:00:00\n"
+        "PINNED: 1\n"
+        "CONTENT_LENGTH: 5\n"
+        "CONTENT:\nnewer\nEND_CONTENT\n"
+        "=== ENTRY END ===\n\n"
+        "=== ENTRY START ===\n"
+        "TIMESTAMP: 2024-03-01 09:30:00\n"
+        "PINNED: 0\n"
+        "CONTENT:\ntwo\nlines\nEND_CONTENT\n"
+        "=== ENTRY END ===\n\n";
+    int64_t newer = 0, older = 0;
+    CHECK(timestamp::parse("2024-03-02 10:00:00", newer));
+    CHECK(timestamp::parse("2024-03-01 09:30:00", older));
+
+    std::string crlf;
+    for (char c : legacy) {
+        if (c == '\n') crlf += '\r';
+        crlf += c;
+    }
+    for (const std::string &file : {legacy, crlf}) {
+        TempDir dir;
+        writeFile(dir.file("history.txt"), file);
+        HistoryManager history(dir.path());
+        auto items = history.readHistory();
+        CHECK((contents(items) == std::vector<std::string>{"newer", "two\nlines"}));
+        if (items.size() != 2) continue;
+        CHECK(items[0].pinned && !items[1].pinned);
+        CHECK_EQ(items[0].time, newer);
+        CHECK_EQ(items[1].time, older);
+
+        // The first write converts the file; its items survive.
+        CHECK(history.addItem("added"));
+        HistoryManager reloaded(dir.path());
+        CHECK((contents(reloaded.readHistory()) == std::vector<std::string>{"added", "newer", "two\nlines"}));
+    }
+}
+
+// ---------- Concurrency ----------
+
+// Readers never wait for the writer and never see a half-made snapshot:
+// whatever they get is the history as of some commit, whole.
+static void testReadersDuringWrites() {
+    TempDir dir;
+    HistoryManager history(dir.path());
+    const int kItems = 150;
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+    std::atomic<size_t> reads{0};
+    auto reader = [&] {
+        size_t seen = 0;
+        while (!done) {
+            const auto items = history.readHistory();
+            if (items.size() < seen) torn++;
+            seen = items.size();
+            for (size_t i = 0; i < items.size(); ++i) {
+                if (items[i].content != "item " + std::to_string(items.size() - 1 - i)) {
+                    torn++;
+                    break;
+                }
+            }
+            history.visitSearch("item 1", [](const ItemView &it) { return !it.content.empty(); });
+            reads++;
+        }
+    };
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) readers.emplace_back(reader);
+    for (int i = 0; i < kItems; ++i) CHECK(history.addItem("item " + std::to_string(i)));
+    done = true;
+    for (auto &t : readers) t.join();
+    CHECK_EQ(torn.load(), 0);
+    CHECK(reads > 0);
+    CHECK_EQ(history.readHistory().size(), size_t(kItems));
+    CHECK_EQ(HistoryManager(dir.path()).readHistory().size(), size_t(kItems));
+}
+
+// Two managers on one directory stand in for two processes: each has its
+// own file lock and snapshot. Writers exclude each other through the lock,
+// and a reader notices the other's commits through the generation counter,
+// whether they appended or rewrote history.txt.
+static void testTwoManagersShareDirectory() {
+    TempDir dir;
+    HistoryManager a(dir.path()), b(dir.path());
+    CHECK(a.addItem("from a"));
+    CHECK((contents(b.readHistory()) == std::vector<std::string>{"from a"}));
+    CHECK(b.addItem("from b"));
+    CHECK((contents(a.readHistory()) == std::vector<std::string>{"from b", "from a"}));
+    CHECK(a.deleteItem(1));   // rewrites the file
+    CHECK((contents(b.readHistory()) == std::vector<std::string>{"from b"}));
+    CHECK(b.pinItem(0));
+    CHECK(a.readHistory()[0].pinned);
+    CHECK(a.setSlot(2, "slot\ntext"));
+    CHECK(b.getSlot(2) == std::optional<std::string>("slot\ntext"));
+
+    const int kEach = 100;
+    auto writer = [](HistoryManager &h, const std::string &name) {
+        for (int i = 0; i < kEach; ++i) {
+            h.addItem(name + " " + std::to_string(i));
+            if (i % 25 == 24) h.deleteItem(0);   // a rewrite now and then
+        }
+    };
+    std::thread ta(writer, std::ref(a), "a"), tb(writer, std::ref(b), "b");
+    ta.join();
+    tb.join();
+
+    HistoryManager fresh(dir.path());
+    auto all = contents(fresh.readHistory());
+    CHECK_EQ(all.size(), size_t(1 + 2 * (kEach - kEach / 25)));
+    CHECK(contents(a.readHistory()) == all);
+    CHECK(contents(b.readHistory()) == all);
+    std::sort(all.begin(), all.end());
+    CHECK(std::adjacent_find(all.begin(), all.end()) == all.end());
+}
+
+// ---------- Batch ----------
+
+static void testBatchAllOrNothing() {
+    TempDir dir;
+    HistoryManager history(dir.path());
+    for (const char *text : {"one", "two", "three"}) history.addItem(text);
+    const std::string fileBefore = readFile(history.historyFilePath());
+    const std::string stateBefore = readFile(dir.file(".generation"));
+
+    // fn returns false: nothing is written or published.
+    CHECK(!history.batch([](HistoryManager::Batch &b) {
+        CHECK(b.addItem("four"));
+        CHECK(b.deleteItem(1));   // "three"
+        CHECK(b.pinItem(0));
+        CHECK_EQ(b.size(), size_t(3));
+        b.clear();
+        CHECK_EQ(b.size(), size_t(0));
+        return false;
+    }));
+    CHECK((contents(history.readHistory()) == std::vector<std::string>{"three", "two", "one"}));
+    CHECK(readFile(history.historyFilePath()) == fileBefore);
+    CHECK(readFile(dir.file(".generation")) == stateBefore);
+
+    // A script with one bad line applies none of its lines.
+    CLI cli(history);
+    std::ostringstream out;
+    std::istringstream bad("add four\npin 0\ndelete 99\n");
+    CHECK(cli.runBatch(bad, out) != 0);
+    CHECK((contents(history.readHistory()) == std::vector<std::string>{"three", "two", "one"}));
+    CHECK(readFile(history.historyFilePath()) == fileBefore);
+
+    // A good one applies all of them with one write; later lines see the
+    // changes of earlier ones.
+    std::istringstream good("# comment\nadd four\nadd tab\\there\n\ndelete 2\npin 0\n");
+    CHECK_EQ(cli.runBatch(good, out), 0);
+    const auto items = history.readHistory();
+    CHECK((contents(items) == std::vector<std::string>{"tab\there", "four", "two", "one"}));
+    CHECK(items.size() == 4 && items[0].pinned);
+    CHECK((contents(HistoryManager(dir.path()).readHistory()) == contents(items)));
+}
+
+// ---------- Daemon ----------
+
+static void testDaemonRoundTrip() {
+    const std::vector<std::string> args = {"search", "two words", ""};
+    CHECK(daemon_protocol::decodeRequest(daemon_protocol::encodeRequest(args)) == args);
+
+    TempDir dir;
+    HistoryManager history(dir.path());
+    for (const char *text : {"alpha", "beta", "gamma"}) history.addItem(text);
+    CLI cli(history);
+    const std::string socketPath = dir.file("clipboard.sock");
+    DaemonServer server(socketPath, cli);
+    bool served = false;
+    std::thread thread([&] { served = server.run(); });
+
+    std::string output;
+    int status = -1;
+    {
+        DaemonClient client(socketPath);
+        for (int i = 0; i < 500 && !client.connect(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        CHECK(client.request({"history"}, output, status));
+        CHECK_EQ(status, 0);
+        CHECK(output.find("0: [") == 0 && output.find("gamma") != std::string::npos);
+
+        // Commands apply to the daemon's resident history; one connection
+        // carries any number of requests.
+        CHECK(client.request({"pin", "2"}, output, status) && status == 0);
+        CHECK(client.request({"delete", "0"}, output, status) && status == 0);
+        CHECK((contents(history.readHistory()) == std::vector<std::string>{"beta", "alpha"}));
+        CHECK(history.readHistory()[1].pinned);
+        CHECK(client.request({"search", "BET"}, output, status) && status == 0);
+        CHECK(output.find("beta") != std::string::npos && output.find("alpha") == std::string::npos);
+        CHECK(client.request({"bogus"}, output, status));
+        CHECK_EQ(status, 1);
+        CHECK(output == "Unknown command: bogus\n");
+    }   // the daemon serves one connection at a time: let this one go
+
+    DaemonClient second(socketPath);
+    const bool stopped = second.request({"shutdown"}, output, status);
+    CHECK(stopped && status == 0);
+    if (!stopped) server.stop();   // rather than wait on a broken daemon forever
+    thread.join();
+    CHECK(served);
+    DaemonClient late(socketPath);
+    CHECK(!late.connect());
+}
+
+// ---------- Import and export ----------
+
+static std::vector<std::string> importInto(HistoryManager &history, const std::string &input, Importer::Format format) {
+    Importer importer(history);
+    std::istringstream in(input);
+    CHECK(importer.run(in, format));
+    CHECK(importer.error().empty());
+    return contents(history.readHistory());
+}
+
+// Records are taken oldest first, whatever the format: the last one read
+// becomes the newest item.
+static void testImportFormats() {
+    {
+        TempDir dir;
+        HistoryManager history(dir.path());
+        CHECK((importInto(history, "[\"a\", {\"content\": \"b\", \"pinned\": true}, {\"text\": \"c\", \"timestamp\": \"2024-01-02T03:04:05\"}]",
+                          Importer::Format::Json) == std::vector<std::string>{"c", "b", "a"}));
+        const auto items = history.readHistory();
+        int64_t given = 0;
+        CHECK(timestamp::parse("2024-01-02 03:04:05", given));
+        CHECK(items.size() == 3 && items[1].pinned && items[0].time == given);
+        CHECK(items.size() == 3 && items[2].time > given && items[2].preview == "a");
+    }
+    {
+        // The extension's clipboard_history.json; unknown keys are skipped.
+        TempDir dir;
+        HistoryManager history(dir.path());
+        const auto all = importInto(history, "{\"version\": 2, \"history\": [\"x\", {\"content\": \"y\", \"tags\": [\"t\"]}], \"pinned\": [\"p\"]}",
+                                    Importer::Format::Json);
+        CHECK((all == std::vector<std::string>{"p", "y", "x"}));
+        CHECK(history.readHistory()[0].pinned);
+    }
+    {
+        TempDir dir;
+        HistoryManager history(dir.path());
+        CHECK((importInto(history, "one\r\n\ntwo\nthree", Importer::Format::Lines) ==
+               std::vector<std::string>{"three", "two", "one"}));
+        CHECK((importInto(history, std::string("multi\nline\0last\0", 16), Importer::Format::Nul) ==
+               std::vector<std::string>{"last", "multi\nline", "three", "two", "one"}));
+        // Imports are appended; the history reads the same from a fresh manager.
+        CHECK(readFile(history.historyFilePath()).find("=== HISTORY OLDEST FIRST ===\n") == 0);
+        CHECK((contents(HistoryManager(dir.path()).readHistory()) == contents(history.readHistory())));
+    }
+    {
+        // A legacy newest-first file is converted once, then appended to.
+        TempDir dir;
+        {
+            std::ofstream out(dir.file("history.txt"));
+            for (const char *text : {"newer", "older"}) {
+                out << "=== ENTRY START ===\nTIMESTAMP: 2020-01-01T00:00:00\nPINNED: 0\nCONTENT:\n"
+                    << text << "\nEND_CONTENT\n=== ENTRY END ===\n\n";
+            }
+        }
+        HistoryManager history(dir.path());
+        CHECK((importInto(history, "[\"first\"]", Importer::Format::Json) ==
+               std::vector<std::string>{"first", "newer", "older"}));
+        CHECK((importInto(history, "[\"second\"]", Importer::Format::Json) ==
+               std::vector<std::string>{"second", "first", "newer", "older"}));
+        CHECK((contents(HistoryManager(dir.path()).readHistory()) == contents(history.readHistory())));
+    }
+    {
+        // Whatever parsed before an error is kept.
+        TempDir dir;
+        HistoryManager history(dir.path());
+        Importer importer(history);
+        std::istringstream in("[\"kept\", {\"content\": ");
+        CHECK(!importer.run(in, Importer::Format::Json));
+        CHECK(importer.error().find("JSON error") == 0);
+        CHECK((contents(history.readHistory()) == std::vector<std::string>{"kept"}));
+    }
+}
+
+// Whatever an export writes, the matching import reads back as the same
+// history, and exporting that gives the same bytes again.
+static void testImportExportRoundTrip() {
+    TempDir source;
+    HistoryManager history(source.path());
+    {
+        std::vector<HistoryItem> items;
+        items.push_back(dated(1700000000000004, "pinned \"quoted\"\ttext", true, "cli"));
+        items.push_back(dated(1700000000000003, "multi\nline\n\u00e9", false, "extension"));
+        items.push_back(dated(1700000000000002, "ctl \x01 char", false, "clipboard"));
+        HistoryItem image = dated(1700000000000001, std::string("\x89PNG\0\x01\xff", 8), false, "clipboard");
+        image.mime = "image/png";
+        items.push_back(image);
+        items.push_back(dated(1700000000000000, "oldest", false, "clipboard"));
+        CHECK(history.writeHistory(items));
+
+        // One for the blob store, whose base64 ends in a partial group.
+        HistoryItem blob;
+        blob.content.resize(HistoryManager::kBlobMinBytes + 1);
+        std::mt19937 rng(3);
+        for (char &c : blob.content) c = static_cast<char>(rng());
+        blob.mime = "application/octet-stream";
+        blob.source = "clipboard";
+        CHECK(history.batch([&](HistoryManager::Batch &b) { return b.addItem(std::move(blob)); }));
+    }
+    const auto original = history.readHistory();
+    CHECK(!original.empty() && !original[0].blob.empty());
+
+    const std::pair<Exporter::Format, Importer::Format> formats[] = {
+        {Exporter::Format::Json, Importer::Format::Json}, {Exporter::Format::Jsonl, Importer::Format::Jsonl}};
+    for (const auto &format : formats) {
+        std::ostringstream exported;
+        Exporter exporter(history);
+        CHECK(exporter.run(exported, format.first));
+        CHECK_EQ(exporter.exported(), original.size());
+
+        TempDir target;
+        HistoryManager copy(target.path());
+        Importer importer(copy);
+        std::istringstream in(exported.str());
+        CHECK(importer.run(in, format.second));
+        CHECK_EQ(importer.imported(), original.size());
+        const auto loaded = copy.readHistory();
+        CHECK_EQ(loaded.size(), original.size());
+        for (size_t i = 0; i < std::min(loaded.size(), original.size()); ++i) {
+            CHECK_EQ(loaded[i].time, original[i].time);
+            CHECK_EQ(loaded[i].pinned, original[i].pinned);
+            CHECK(loaded[i].source == original[i].source);
+            CHECK_EQ(loaded[i].mime, original[i].mime);
+            std::ostringstream a, b;
+            CHECK(copy.readPayload(i, a) && history.readPayload(i, b));
+            CHECK(a.str() == b.str());
+        }
+
+        std::ostringstream again;
+        Exporter second(copy);
+        CHECK(second.run(again, format.first));
+        CHECK(again.str() == exported.str());
+    }
+
+    // Bytes that aren't UTF-8 are exported as U+FFFD.
+    {
+        TempDir dir;
+        HistoryManager bad(dir.path());
+        bad.addItem("bad \xff byte");
+        std::ostringstream out;
+        Exporter exporter(bad);
+        CHECK(exporter.run(out, Exporter::Format::Jsonl));
+        CHECK(out.str().find("\"content\":\"bad \\ufffd byte\"}\n") != std::string::npos);
+    }
+
+    // Raw keeps the text items only, '\0' separated, and Nul reads it back;
+    // items without a source are marked as imported.
+    std::ostringstream raw;
+    Exporter exporter(history);
+    CHECK(exporter.run(raw, Exporter::Format::Raw));
+    TempDir target;
+    HistoryManager copy(target.path());
+    Importer importer(copy);
+    std::istringstream in(raw.str());
+    CHECK(importer.run(in, Importer::Format::Nul));
+    const auto items = copy.readHistory();
+    CHECK((contents(items) ==
+           std::vector<std::string>{original[1].content, original[2].content, original[3].content, original[5].content}));
+    CHECK(!items.empty() && items[0].source == "import");
+
+    // JSONL records may be separated by any whitespace, or none.
+    TempDir loose;
+    HistoryManager spaced(loose.path());
+    Importer lines(spaced);
+    std::istringstream records(" {\"content\": \"a\"}\r\n\n\"b\"{\"text\": \"c\", \"pinned\": true}\n");
+    CHECK(lines.run(records, Importer::Format::Jsonl));
+    CHECK((contents(spaced.readHistory()) == std::vector<std::string>{"c", "b", "a"}));
+    std::istringstream broken("{\"content\": \"d\"}\n{\"content\": ");
+    CHECK(!lines.run(broken, Importer::Format::Jsonl));
+    CHECK_EQ(spaced.readHistory().size(), size_t(4));   // what parsed is kept
+}
+
+// The export holds no lock while it hands out entries: writers, even ones
+// called from visit, go ahead, and what they append isn't part of it. A
+// damaged CONTENT_LENGTH doesn't stop it.
+static void testExportDoesNotBlockWriters() {
+    TempDir dir;
+    HistoryManager history(dir.path());
+    for (const char *text : {"one", "two", "three"}) history.addItem(text);
+    std::vector<std::string> seen;
+    CHECK(history.exportHistory([&](const HistoryItem &it) {
+        seen.push_back(it.content);
+        return history.addItem("added " + it.content);
+    }));
+    CHECK((seen == std::vector<std::string>{"one", "two", "three"}));
+    CHECK_EQ(history.readHistory().size(), size_t(6));
+
+    // A damaged length, or one past the end of the file, is not trusted:
+    // that content is read up to its END_CONTENT line.
+    std::string file = readFile(history.historyFilePath());
+    size_t at = file.find("CONTENT_LENGTH: 3");
+    CHECK(at != std::string::npos);
+    file.replace(at, 17, "CONTENT_LENGTH: x");
+    at = file.find("CONTENT_LENGTH: 3");
+    CHECK(at != std::string::npos);
+    file.replace(at, 17, "CONTENT_LENGTH: 99999999999");
+    std::ofstream(history.historyFilePath(), std::ios::binary | std::ios::trunc) << file;
+    std::ostringstream out;
+    Exporter exporter(history);
+    CHECK(exporter.run(out, Exporter::Format::Raw));
+    CHECK_EQ(exporter.exported(), size_t(6));
+    CHECK(out.str().compare(0, 8, std::string("one\0two\0", 8)) == 0);
+}
+
+// ---------- Fuzzy search ----------
+
+static void testFuzzyRankingAndTopK() {
+    int tight = 0, loose = 0, score = 0;
+    FuzzyMatcher matcher("fbar");
+    CHECK(matcher.match("foo_bar", tight));
+    CHECK(matcher.match("xfxxbxxaxxr", loose));
+    CHECK(tight > loose);
+    CHECK(!matcher.match("barf", score));
+    CHECK(FuzzyMatcher("FB").match("FooBar", score));
+    CHECK(!FuzzyMatcher("FB").match("foobar", score));   // smart case
+    CHECK(FuzzyMatcher("fb").match("FOOBAR", score));
+
+    TempDir dir;
+    HistoryManager history(dir.path());
+    for (const char *text : {"f x b x a x r", "nothing here", "fooBar", "foo_bar.cpp", "barf", "fbar",
+                             "the f and b are r", "unrelated", "far boar"}) {
+        CHECK(history.addItem(text));
+    }
+
+    const auto all = history.fuzzySearch("fbar", 100);
+    CHECK_EQ(all.size(), size_t(6));
+    for (size_t i = 1; i < all.size(); ++i) CHECK(all[i - 1].score >= all[i].score);
+    CHECK(!all.empty() && all[0].item.content == "fbar");
+    for (const auto &hit : all) CHECK(history.readHistory()[hit.index].content == hit.item.content);
+
+    // The top K kept while scanning are the first K of the full ranking.
+    for (size_t k = 1; k <= all.size(); ++k) {
+        const auto top = history.fuzzySearch("fbar", k);
+        CHECK_EQ(top.size(), k);
+        for (size_t i = 0; i < std::min(k, top.size()); ++i) CHECK_EQ(top[i].score, all[i].score);
+    }
+    CHECK(history.fuzzySearch("fbar", 0).empty());
+    CHECK(history.fuzzySearch("zzz", 10).empty());
+
+    // Pinning boosts an item over an equal one.
+    const auto before = history.fuzzySearch("foo", 100);
+    CHECK_EQ(before.size(), size_t(2));
+    if (before.size() == 2) {
+        CHECK(history.pinItem(before[1].index));
+        CHECK(history.fuzzySearch("foo", 1)[0].item.content == before[1].item.content);
+    }
+}
+
+// ---------- Archive ----------
+
+// Each archive() seals a segment with a Bloom filter; a search reads only
+// the segments whose filter admits the keyword. Other files in the archive
+// directory are left alone.
+static void testArchiveSkipsSegments() {
+    TempDir dir;
+    HistoryManager history(dir.path());
+    fs::create_directories(dir.file("archive"));
+    std::ofstream(dir.file("archive/segment_abc.txt")) << "not a segment\n";
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 20; ++i)
+            history.addItem("round " + std::to_string(round) + " word" + std::string(1, char('a' + round)) + " " +
+                            std::to_string(i));
+        CHECK(history.archive(0));
+    }
+    history.addItem("still live wordb");
+    CHECK(history.pinItem(0));
+    CHECK(history.archive(0));   // pinned items stay: nothing to archive
+    CHECK((contents(history.readHistory()) == std::vector<std::string>{"still live wordb"}));
+
+    size_t read = 0, total = 0;
+    auto found = history.searchArchive("WORDB", &read, &total);
+    CHECK_EQ(total, size_t(3));
+    CHECK_EQ(read, size_t(1));
+    CHECK_EQ(found.size(), size_t(20));
+    CHECK(!found.empty() && found[0].content == "round 1 wordb 19" && found.back().content == "round 1 wordb 0");
+
+    found = history.searchArchive("round", &read, &total);
+    CHECK_EQ(read, size_t(3));
+    CHECK_EQ(found.size(), size_t(60));
+    CHECK(history.searchArchive("not archived", &read, &total).empty());
+    CHECK_EQ(read, size_t(0));
+
+    CLI cli(history);
+    std::ostringstream out;
+    CHECK_EQ(cli.handleCommand({"search", "--archived", "worda 7"}, out), 0);
+    CHECK(out.str().find("round 0 worda 7") != std::string::npos);
+    CHECK(out.str().find("Read 1 of 3 archived segment(s).") != std::string::npos);
+}
+
+// ---------- Query ----------
+
+static void testQueryFilters() {
+    TempDir dir;
+    HistoryManager history(dir.path());
+    const int64_t t0 = 1700000000000000;
+    std::vector<HistoryItem> items = {
+        dated(t0 + 50, "newest", false, "cli"),
+        dated(t0 + 40, std::string(1000, 'x'), true, "clipboard"),
+        dated(t0 + 30, "middle", false, "clipboard"),
+        dated(t0 + 20, "pinned old", true, "cli"),
+        dated(t0 + 10, "oldest", false, ""),
+    };
+    CHECK(history.writeHistory(items));
+    auto run = [&](HistoryQuery q) { return history.query(q); };
+
+    CHECK_EQ(run({}).size(), size_t(5));
+    HistoryQuery q;
+    q.since = t0 + 20;
+    q.until = t0 + 40;
+    auto hits = run(q);
+    CHECK((contents(hits) == std::vector<std::string>{"middle", "pinned old"}));
+    CHECK(hits.size() == 2 && hits[0].index == 2 && hits[1].index == 3);
+
+    q = {};
+    q.pinned = true;
+    CHECK_EQ(run(q).size(), size_t(2));
+    q.maxSize = 100;
+    CHECK((contents(run(q)) == std::vector<std::string>{"pinned old"}));
+    q = {};
+    q.pinned = false;
+    q.source = "clipboard";
+    CHECK((contents(run(q)) == std::vector<std::string>{"middle"}));
+    q = {};
+    q.source = "";
+    CHECK((contents(run(q)) == std::vector<std::string>{"oldest"}));
+    q = {};
+    q.minSize = 7;
+    CHECK((contents(run(q)) == std::vector<std::string>{std::string(1000, 'x'), "pinned old"}));
+    q = {};
+    q.source = "nowhere";
+    CHECK(run(q).empty());
+    q = {};
+    q.since = t0;
+    q.limit = 2;
+    CHECK((contents(run(q)) == std::vector<std::string>{"newest", std::string(1000, 'x')}));
+
+    // The index follows changes.
+    CHECK(history.unpinItem(1));
+    q = {};
+    q.pinned = true;
+    CHECK((contents(run(q)) == std::vector<std::string>{"pinned old"}));
+    CHECK(history.addItem("added", "cli"));
+    q = {};
+    q.source = "cli";
+    CHECK((contents(run(q)) == std::vector<std::string>{"added", "newest", "pinned old"}));
+
+    CLI cli(history);
+    std::ostringstream out;
+    CHECK_EQ(cli.handleCommand({"query", "--pinned"}, out), 0);
+    CHECK(out.str().find("4: [") == 0 && out.str().find("[PINNED] pinned old") != std::string::npos);
+    CHECK_EQ(cli.handleCommand({"query", "--bogus"}, out), 1);
+}
+
+// ---------- BlobStore ----------
+
+static void testBlobStorePutGet() {
+    TempDir dir;
+    BlobStore blobs(dir.file("blobs"));
+    std::string payload(300000, '\0');
+    std::mt19937 rng(7);
+    for (char &c : payload) c = static_cast<char>(rng());
+
+    std::string name;
+    CHECK(blobs.put(payload.data(), payload.size(), name));
+    CHECK_EQ(name.size(), BlobStore::kNameLength);
+    CHECK_EQ(name, BlobStore::nameOf(payload.data(), payload.size()));
+    std::ostringstream out;
+    CHECK(blobs.get(name, out));
+    CHECK(out.str() == payload);
+
+    // The same bytes streamed in get the same name and one file.
+    std::istringstream in(payload);
+    std::string streamed;
+    uint64_t size = 0;
+    CHECK(blobs.put(in, streamed, size));
+    CHECK_EQ(streamed, name);
+    CHECK_EQ(size, payload.size());
+    size_t files = 0;
+    for (const auto &entry : fs::directory_iterator(dir.file("blobs"))) files += entry.is_regular_file();
+    CHECK_EQ(files, size_t(1));
+
+    // A different payload under the hash's name is not mistaken for it.
+    writeFile(blobs.path(name), "something else");
+    std::string other;
+    CHECK(blobs.put(payload.data(), payload.size(), other));
+    CHECK(other != name);
+    std::ostringstream again;
+    CHECK(blobs.get(other, again));
+    CHECK(again.str() == payload);
+
+    std::ostringstream missing;
+    CHECK(!blobs.get("0000000000000000", missing));
+    std::string empty;
+    CHECK(blobs.put("", 0, empty));
+    std::ostringstream none;
+    CHECK(blobs.get(empty, none) && none.str().empty());
+}
+
+static const struct {
+    const char *name;
+    void (*run)();
+} kTests[] = {
+    {"regex.std_regex", testRegexMatchesStdRegex},
+    {"regex.case_insensitive", testRegexCaseInsensitive},
+    {"regex.utf8_and_errors", testRegexUtf8AndErrors},
+    {"text_fold.case", testTextFoldCase},
+    {"text_fold.nfkc", testTextFoldNfkc},
+    {"search_index.candidates", testSearchIndexCandidates},
+    {"search_index.history_changes", testHistorySearchAfterChanges},
+    {"journal.undo_redo_reload", testJournalUndoRedoAcrossReload},
+    {"history_file.round_trip", testHistoryFileRoundTrip},
+    {"history_file.legacy", testLegacyHistoryFile},
+    {"blob_store.put_get", testBlobStorePutGet},
+    {"concurrency.readers_during_writes", testReadersDuringWrites},
+    {"concurrency.two_managers", testTwoManagersShareDirectory},
+    {"batch.all_or_nothing", testBatchAllOrNothing},
+    {"daemon.round_trip", testDaemonRoundTrip},
+    {"import.formats", testImportFormats},
+    {"import_export.round_trip", testImportExportRoundTrip},
+    {"import_export.export_does_not_block_writers", testExportDoesNotBlockWriters},
+    {"fuzzy.ranking_top_k", testFuzzyRankingAndTopK},
+    {"archive.bloom_skip", testArchiveSkipsSegments},
+    {"query.filters", testQueryFilters},
+};
+
+int main(int argc, char *argv[]) {
+    const std::string only = argc > 1 ? argv[1] : "";
+    int failed = 0, run = 0;
+    for (const auto &test : kTests) {
+        if (std::string(test.name).find(only) == std::string::npos) continue;
+        const int before = g_checksFailed;
+        test.run();
+        run++;
+        const bool ok = g_checksFailed == before;
+        if (!ok) failed++;
+        std::cout << (ok ? "ok      " : "FAILED  ") << test.name << "\n";
+    }
+    std::cout << run - failed << " of " << run << " tests passed\n";
+    return failed;
+}